@@ -31,6 +31,20 @@ static inline void dhara_w16(uint8_t *data, uint16_t v)
     data[1] = v >> 8;
 }
 
+static inline uint32_t dhara_r24(const uint8_t *data)
+{
+    return ((uint32_t)data[0]) |
+           (((uint32_t)data[1]) << 8) |
+           (((uint32_t)data[2]) << 16);
+}
+
+static inline void dhara_w24(uint8_t *data, uint32_t v)
+{
+    data[0] = v;
+    data[1] = v >> 8;
+    data[2] = v >> 16;
+}
+
 static inline uint32_t dhara_r32(const uint8_t *data)
 {
     return ((uint32_t)data[0]) |
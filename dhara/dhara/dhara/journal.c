@@ -22,19 +22,28 @@
  * Metapage binary format
  */
 
+/* Journals written with compact metadata have their own magic, so that
+ * neither format mistakes the other's checkpoints for its own.
+ */
+#if DHARA_COMPACT_META
+#define HDR_MAGIC_FORMAT    'c'
+#else
+#define HDR_MAGIC_FORMAT    'a'
+#endif
+
 /* Does the page buffer contain a valid checkpoint page? */
 static inline int hdr_has_magic(const uint8_t *buf)
 {
     return (buf[0] == 'D') &&
            (buf[1] == 'h') &&
-           (buf[2] == 'a');
+           (buf[2] == HDR_MAGIC_FORMAT);
 }
 
 static inline void hdr_put_magic(uint8_t *buf)
 {
     buf[0] = 'D';
     buf[1] = 'h';
-    buf[2] = 'a';
+    buf[2] = HDR_MAGIC_FORMAT;
 }
 
 /* What epoch is this page? */
@@ -473,6 +482,62 @@ int dhara_journal_resume(struct dhara_journal *j, dhara_error_t *err)
     return 0;
 }
 
+int dhara_journal_resume_at(struct dhara_journal *j, dhara_page_t root,
+                            uint8_t epoch, dhara_error_t *err)
+{
+    const dhara_page_t cp = root + 1;
+    const dhara_page_t ppc_mask = (1 << j->log2_ppc) - 1;
+
+    /* A checkpointed root is the last user page of its group */
+    if ((root == DHARA_PAGE_NONE) ||
+            (cp >= (j->nand->num_blocks << j->nand->log2_ppb)) ||
+            ((cp & ppc_mask) != ppc_mask)) {
+        dhara_set_error(err, DHARA_E_TOO_BAD);
+        return -1;
+    }
+
+    if (dhara_nand_read(j->nand, cp, 0, 1 << j->nand->log2_page_size,
+                        j->page_buf, err) < 0) {
+        reset_journal(j);
+        return -1;
+    }
+
+    if (!hdr_has_magic(j->page_buf) ||
+            (hdr_get_epoch(j->page_buf) != epoch)) {
+        reset_journal(j);
+        dhara_set_error(err, DHARA_E_TOO_BAD);
+        return -1;
+    }
+
+    j->epoch = epoch;
+    j->root = root;
+    j->tail = hdr_get_tail(j->page_buf);
+    j->bb_current = hdr_get_bb_current(j->page_buf);
+    j->bb_last = hdr_get_bb_last(j->page_buf);
+    hdr_clear_user(j->page_buf, j->nand->log2_page_size);
+
+    if (find_head(j, cp & ~ppc_mask, err) < 0) {
+        reset_journal(j);
+        return -1;
+    }
+
+    /* If anything was written after this checkpoint in the same block,
+     * the next group isn't blank, find_head() skips over it, and the
+     * root we were given is stale.
+     */
+    if (j->head != ((cp + 1) % (j->nand->num_blocks << j->nand->log2_ppb))) {
+        reset_journal(j);
+        dhara_set_error(err, DHARA_E_TOO_BAD);
+        return -1;
+    }
+
+    j->flags = 0;
+    j->tail_sync = j->tail;
+
+    clear_recovery(j);
+    return 0;
+}
+
 /**************************************************************************
  * Public interface
  */
@@ -29,10 +29,29 @@
  */
 #define DHARA_COOKIE_SIZE       4
 
+/* Compact metadata: sector IDs and page pointers are stored in 3 bytes
+ * instead of 4, and the radix tree of the map is only 20 levels deep,
+ * so sector IDs must be below 2**20 and page numbers below 2**24 - 1.
+ * The metadata slice shrinks from 132 to 63 bytes, and twice as many
+ * user pages share a checkpoint page. This changes the on-flash format.
+ */
+#ifndef DHARA_COMPACT_META
+#define DHARA_COMPACT_META      0
+#endif
+
+#if DHARA_COMPACT_META
+#define DHARA_META_WORD_SIZE    3
+#define DHARA_RADIX_DEPTH       20
+#else
+#define DHARA_META_WORD_SIZE    4
+#define DHARA_RADIX_DEPTH       32
+#endif
+
 /* This is the size of the metadata slice which accompanies each written
- * page. This is independent of the underlying page/OOB size.
+ * page (the sector ID, and one alt-pointer per level of the radix tree).
+ * This is independent of the underlying page/OOB size.
  */
-#define DHARA_META_SIZE         132
+#define DHARA_META_SIZE         (DHARA_META_WORD_SIZE * (DHARA_RADIX_DEPTH + 1))
 
 /* When a block fails, or garbage is encountered, we try again on the
  * next block/checkpoint. We can do this up to the given number of
@@ -140,6 +159,18 @@ void dhara_journal_init(struct dhara_journal *j,
  */
 int dhara_journal_resume(struct dhara_journal *j, dhara_error_t *err);
 
+/* Start up the journal from a known root, such as one saved by the
+ * application after a clean shutdown (a checkpointed journal, see
+ * dhara_journal_is_clean()), along with the epoch at that time.
+ *
+ * Only the checkpoint page following the root and the checkpoint group
+ * after it are read, so this is O(1). Returns -1 if the NAND contents
+ * don't match the given root, in which case the journal is reset and
+ * dhara_journal_resume() should be used instead.
+ */
+int dhara_journal_resume_at(struct dhara_journal *j, dhara_page_t root,
+                            uint8_t epoch, dhara_error_t *err);
+
 /* Obtain an upper bound on the number of user pages storable in the
  * journal.
  */
@@ -18,8 +18,6 @@
 #include "bytes.h"
 #include "map.h"
 
-#define DHARA_RADIX_DEPTH   (sizeof(dhara_sector_t) << 3)
-
 static inline dhara_sector_t d_bit(int depth)
 {
     return ((dhara_sector_t)1) << (DHARA_RADIX_DEPTH - depth - 1);
@@ -44,24 +42,157 @@ static inline void meta_clear(uint8_t *meta)
     memset(meta, 0xff, DHARA_META_SIZE);
 }
 
+#if DHARA_COMPACT_META
+/* 3-byte fields, with all-ones standing for SECTOR_NONE/PAGE_NONE */
+static inline uint32_t meta_r(const uint8_t *field)
+{
+    const uint32_t v = dhara_r24(field);
+
+    return v == 0xffffff ? 0xffffffff : v;
+}
+
+static inline void meta_w(uint8_t *field, uint32_t v)
+{
+    dhara_w24(field, v);
+}
+#else
+static inline uint32_t meta_r(const uint8_t *field)
+{
+    return dhara_r32(field);
+}
+
+static inline void meta_w(uint8_t *field, uint32_t v)
+{
+    dhara_w32(field, v);
+}
+#endif
+
 static inline dhara_sector_t meta_get_id(const uint8_t *meta)
 {
-    return dhara_r32(meta);
+    return meta_r(meta);
 }
 
 static inline void meta_set_id(uint8_t *meta, dhara_sector_t id)
 {
-    dhara_w32(meta, id);
+    meta_w(meta, id);
 }
 
 static inline dhara_page_t meta_get_alt(const uint8_t *meta, int level)
 {
-    return dhara_r32(meta + 4 + (level << 2));
+    return meta_r(meta + DHARA_META_WORD_SIZE * (level + 1));
 }
 
 static inline void meta_set_alt(uint8_t *meta, int level, dhara_page_t alt)
 {
-    dhara_w32(meta + 4 + (level << 2), alt);
+    meta_w(meta + DHARA_META_WORD_SIZE * (level + 1), alt);
+}
+
+/* Can the radix tree hold this sector? */
+static inline int sector_in_range(dhara_sector_t s)
+{
+#if DHARA_RADIX_DEPTH < 32
+    return !(s >> DHARA_RADIX_DEPTH);
+#else
+    (void)s;
+    return 1;
+#endif
+}
+
+/************************************************************************
+ * Lookup cache
+ *
+ * An entry is only ever filled in by a successful lookup, and must be
+ * dropped whenever the page holding that sector is relocated (write,
+ * trim, GC, recovery). As a last line of defence, entries which have
+ * fallen out of the live region of the journal are ignored.
+ */
+
+#if DHARA_MAP_CACHE_SIZE > 0
+static inline struct dhara_map_cache_entry *
+cache_slot(struct dhara_map *m, dhara_sector_t s)
+{
+    return &m->cache[s % DHARA_MAP_CACHE_SIZE];
+}
+
+static int cache_page_is_live(const struct dhara_map *m, dhara_page_t p)
+{
+    const struct dhara_journal *j = &m->journal;
+    const dhara_page_t chip_size = j->nand->num_blocks << j->nand->log2_ppb;
+    const dhara_page_t raw_size = (j->head + chip_size - j->tail) % chip_size;
+    const dhara_page_t offset = (j->head + chip_size - p) % chip_size;
+
+    return offset && offset <= raw_size;
+}
+#endif
+
+static void cache_flush(struct dhara_map *m)
+{
+#if DHARA_MAP_CACHE_SIZE > 0
+    int i;
+
+    for (i = 0; i < DHARA_MAP_CACHE_SIZE; i++) {
+        m->cache[i].sector = DHARA_SECTOR_NONE;
+    }
+#else
+    (void)m;
+#endif
+}
+
+static void cache_forget(struct dhara_map *m, dhara_sector_t s)
+{
+#if DHARA_MAP_CACHE_SIZE > 0
+    struct dhara_map_cache_entry *e = cache_slot(m, s);
+
+    if (e->sector == s) {
+        e->sector = DHARA_SECTOR_NONE;
+    }
+#else
+    (void)m;
+    (void)s;
+#endif
+}
+
+static void cache_store(struct dhara_map *m, dhara_sector_t s, dhara_page_t p)
+{
+#if DHARA_MAP_CACHE_SIZE > 0
+    struct dhara_map_cache_entry *e = cache_slot(m, s);
+
+    if (s != DHARA_SECTOR_NONE) {
+        e->sector = s;
+        e->page = p;
+    }
+#else
+    (void)m;
+    (void)s;
+    (void)p;
+#endif
+}
+
+static int cache_lookup(struct dhara_map *m, dhara_sector_t s,
+                        dhara_page_t *loc)
+{
+#if DHARA_MAP_CACHE_SIZE > 0
+    struct dhara_map_cache_entry *e = cache_slot(m, s);
+
+    if ((s != DHARA_SECTOR_NONE) && (e->sector == s)) {
+        if (cache_page_is_live(m, e->page)) {
+            m->cache_hits++;
+            if (loc) {
+                *loc = e->page;
+            }
+            return 0;
+        }
+
+        e->sector = DHARA_SECTOR_NONE;
+    }
+
+    m->cache_misses++;
+#else
+    (void)m;
+    (void)s;
+    (void)loc;
+#endif
+    return -1;
 }
 
 /************************************************************************
@@ -77,10 +208,18 @@ void dhara_map_init(struct dhara_map *m, const struct dhara_nand *n,
 
     dhara_journal_init(&m->journal, n, page_buf);
     m->gc_ratio = gc_ratio;
+
+    cache_flush(m);
+#if DHARA_MAP_CACHE_SIZE > 0
+    m->cache_hits = 0;
+    m->cache_misses = 0;
+#endif
 }
 
 int dhara_map_resume(struct dhara_map *m, dhara_error_t *err)
 {
+    cache_flush(m);
+
     if (dhara_journal_resume(&m->journal, err) < 0) {
         m->count = 0;
         return -1;
@@ -90,11 +229,26 @@ int dhara_map_resume(struct dhara_map *m, dhara_error_t *err)
     return 0;
 }
 
+int dhara_map_resume_at(struct dhara_map *m, dhara_page_t root,
+                        uint8_t epoch, dhara_error_t *err)
+{
+    cache_flush(m);
+
+    if (dhara_journal_resume_at(&m->journal, root, epoch, err) < 0) {
+        m->count = 0;
+        return -1;
+    }
+
+    m->count = ck_get_count(dhara_journal_cookie(&m->journal));
+    return 0;
+}
+
 void dhara_map_clear(struct dhara_map *m)
 {
     if (m->count) {
         m->count = 0;
         dhara_journal_clear(&m->journal);
+        cache_flush(m);
     }
 }
 
@@ -133,7 +287,7 @@ static int trace_path(struct dhara_map *m, dhara_sector_t target,
         meta_set_id(new_meta, target);
     }
 
-    if (p == DHARA_PAGE_NONE) {
+    if (p == DHARA_PAGE_NONE || !sector_in_range(target)) {
         goto not_found;
     }
 
@@ -192,7 +346,50 @@ not_found:
 int dhara_map_find(struct dhara_map *m, dhara_sector_t target,
                    dhara_page_t *loc, dhara_error_t *err)
 {
-    return trace_path(m, target, loc, NULL, err);
+    dhara_page_t p;
+
+    if (!cache_lookup(m, target, &p)) {
+        if (loc) {
+            *loc = p;
+        }
+
+        return 0;
+    }
+
+    if (trace_path(m, target, &p, NULL, err) < 0) {
+        return -1;
+    }
+
+    cache_store(m, target, p);
+    if (loc) {
+        *loc = p;
+    }
+
+    return 0;
+}
+
+void dhara_map_cache_stats(const struct dhara_map *m,
+                           uint32_t *hits, uint32_t *misses)
+{
+#if DHARA_MAP_CACHE_SIZE > 0
+    if (hits) {
+        *hits = m->cache_hits;
+    }
+
+    if (misses) {
+        *misses = m->cache_misses;
+    }
+#else
+    (void)m;
+
+    if (hits) {
+        *hits = 0;
+    }
+
+    if (misses) {
+        *misses = 0;
+    }
+#endif
 }
 
 int dhara_map_read(struct dhara_map *m, dhara_sector_t s,
@@ -227,7 +424,16 @@ static int raw_gc(struct dhara_map *m, dhara_page_t src,
     dhara_error_t my_err;
     uint8_t meta[DHARA_META_SIZE];
 
-    if (dhara_journal_read_meta(&m->journal, src, meta, err) < 0) {
+    if (dhara_journal_read_meta(&m->journal, src, meta, &my_err) < 0) {
+        /* An uncorrectable checkpoint is one whose program was
+         * interrupted by a power loss. Its group was never
+         * committed, so nothing refers to the page.
+         */
+        if (my_err == DHARA_E_ECC) {
+            return 0;
+        }
+
+        dhara_set_error(err, my_err);
         return -1;
     }
 
@@ -257,6 +463,7 @@ static int raw_gc(struct dhara_map *m, dhara_page_t src,
     }
 
     /* Rewrite it at the front of the journal with updated metadata */
+    cache_forget(m, target);
     ck_set_count(dhara_journal_cookie(&m->journal), m->count);
     if (dhara_journal_copy(&m->journal, src, meta, err) < 0) {
         return -1;
@@ -280,6 +487,7 @@ static int pad_queue(struct dhara_map *m, dhara_error_t *err)
         return -1;
     }
 
+    cache_forget(m, meta_get_id(root_meta));
     return dhara_journal_copy(&m->journal, p, root_meta, err);
 }
 
@@ -294,6 +502,11 @@ static int try_recover(struct dhara_map *m, dhara_error_t cause,
         return -1;
     }
 
+    /* Recovery may restart and abandon pages it has already
+     * relocated. Don't try to track that.
+     */
+    cache_flush(m);
+
     while (dhara_journal_in_recovery(&m->journal)) {
         dhara_page_t p = dhara_journal_next_recoverable(&m->journal);
         dhara_error_t my_err;
@@ -323,7 +536,14 @@ static int try_recover(struct dhara_map *m, dhara_error_t cause,
     return 0;
 }
 
-static int auto_gc(struct dhara_map *m, dhara_error_t *err)
+static int gc_range(struct dhara_map *m, dhara_sector_t lo,
+                    dhara_sector_t n, dhara_error_t *err);
+
+/* Sectors in [lo, lo + n) met by garbage collection are deleted rather
+ * than copied, see raw_trim_gc(). n is 0 outside of a ranged trim.
+ */
+static int auto_gc(struct dhara_map *m, dhara_sector_t lo,
+                   dhara_sector_t n, dhara_error_t *err)
 {
     int i;
 
@@ -332,7 +552,7 @@ static int auto_gc(struct dhara_map *m, dhara_error_t *err)
     }
 
     for (i = 0; i <= m->gc_ratio; i++)
-        if (dhara_map_gc(m, err) < 0) {
+        if (gc_range(m, lo, n, err) < 0) {
             return -1;
         }
 
@@ -344,10 +564,17 @@ static int prepare_write(struct dhara_map *m, dhara_sector_t dst,
 {
     dhara_error_t my_err;
 
-    if (auto_gc(m, err) < 0) {
+    if (!sector_in_range(dst)) {
+        dhara_set_error(err, DHARA_E_SECTOR_RANGE);
+        return -1;
+    }
+
+    if (auto_gc(m, 0, 0, err) < 0) {
         return -1;
     }
 
+    cache_forget(m, dst);
+
     if (trace_path(m, dst, NULL, meta, &my_err) < 0) {
         if (my_err != DHARA_E_NOT_FOUND) {
             dhara_set_error(err, my_err);
@@ -446,6 +673,8 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
     int level = DHARA_RADIX_DEPTH - 1;
     int i;
 
+    cache_forget(m, s);
+
     if (trace_path(m, s, NULL, meta, &my_err) < 0) {
         if (my_err == DHARA_E_NOT_FOUND) {
             return 0;
@@ -470,6 +699,7 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
     if (level < 0) {
         m->count = 0;
         dhara_journal_clear(&m->journal);
+        cache_flush(m);
         return 0;
     }
 
@@ -489,6 +719,7 @@ static int try_delete(struct dhara_map *m, dhara_sector_t s,
 
     meta_set_alt(meta, level, DHARA_PAGE_NONE);
 
+    cache_forget(m, meta_get_id(alt_meta));
     ck_set_count(dhara_journal_cookie(&m->journal), m->count - 1);
     if (dhara_journal_copy(&m->journal, alt_page, meta, err) < 0) {
         return -1;
@@ -503,7 +734,7 @@ int dhara_map_trim(struct dhara_map *m, dhara_sector_t s, dhara_error_t *err)
     for (;;) {
         dhara_error_t my_err;
 
-        if (auto_gc(m, err) < 0) {
+        if (auto_gc(m, 0, 0, err) < 0) {
             return -1;
         }
 
@@ -519,6 +750,93 @@ int dhara_map_trim(struct dhara_map *m, dhara_sector_t s, dhara_error_t *err)
     return 0;
 }
 
+/* Garbage collection step: the tail page is checked as by raw_gc(), but
+ * if it's the current page of a sector which is still to be trimmed by
+ * dhara_map_trim_range() (in [lo, lo + n)), the sector is deleted instead
+ * of copying the page to the front of the journal only to delete it later.
+ * With n == 0, this is raw_gc().
+ */
+static int raw_trim_gc(struct dhara_map *m, dhara_page_t src,
+                       dhara_sector_t lo, dhara_sector_t n,
+                       dhara_error_t *err)
+{
+    dhara_sector_t target;
+    dhara_page_t current;
+    dhara_error_t my_err;
+    uint8_t meta[DHARA_META_SIZE];
+
+    if (!n) {
+        return raw_gc(m, src, err);
+    }
+
+    if (dhara_journal_read_meta(&m->journal, src, meta, &my_err) < 0) {
+        /* A torn checkpoint is garbage, as in raw_gc() */
+        if (my_err == DHARA_E_ECC) {
+            return 0;
+        }
+
+        dhara_set_error(err, my_err);
+        return -1;
+    }
+
+    target = meta_get_id(meta);
+    if (target == DHARA_SECTOR_NONE || target - lo >= n) {
+        return raw_gc(m, src, err);
+    }
+
+    if (trace_path(m, target, &current, NULL, &my_err) < 0) {
+        if (my_err == DHARA_E_NOT_FOUND) {
+            return 0;
+        }
+
+        dhara_set_error(err, my_err);
+        return -1;
+    }
+
+    if (current != src) {
+        return 0;
+    }
+
+    return try_delete(m, target, err);
+}
+
+int dhara_map_trim_range(struct dhara_map *m, dhara_sector_t start,
+                         dhara_sector_t count, dhara_error_t *err)
+{
+    dhara_sector_t i;
+
+    for (i = 0; i < count && m->count; i++) {
+        const dhara_sector_t s = start + i;
+        dhara_error_t my_err;
+
+        /* Unmapped sectors cost a lookup, but no garbage collection */
+        if (dhara_map_find(m, s, NULL, &my_err) < 0) {
+            if (my_err == DHARA_E_NOT_FOUND) {
+                continue;
+            }
+
+            dhara_set_error(err, my_err);
+            return -1;
+        }
+
+        for (;;) {
+            if (auto_gc(m, s, count - i, err) < 0) {
+                return -1;
+            }
+
+            if (!try_delete(m, s, &my_err)) {
+                break;
+            }
+
+            if (try_recover(m, my_err, err) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 int dhara_map_sync(struct dhara_map *m, dhara_error_t *err)
 {
     while (!dhara_journal_is_clean(&m->journal)) {
@@ -544,6 +862,12 @@ int dhara_map_sync(struct dhara_map *m, dhara_error_t *err)
 }
 
 int dhara_map_gc(struct dhara_map *m, dhara_error_t *err)
+{
+    return gc_range(m, 0, 0, err);
+}
+
+static int gc_range(struct dhara_map *m, dhara_sector_t lo,
+                    dhara_sector_t n, dhara_error_t *err)
 {
     if (!m->count) {
         return 0;
@@ -557,8 +881,11 @@ int dhara_map_gc(struct dhara_map *m, dhara_error_t *err)
             break;
         }
 
-        if (!raw_gc(m, tail, &my_err)) {
-            dhara_journal_dequeue(&m->journal);
+        if (!raw_trim_gc(m, tail, lo, n, &my_err)) {
+            /* Deleting the last sector clears the journal */
+            if (m->count) {
+                dhara_journal_dequeue(&m->journal);
+            }
             break;
         }
 
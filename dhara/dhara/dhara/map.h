@@ -27,11 +27,32 @@ typedef uint32_t dhara_sector_t;
 /* This sector value is reserved */
 #define DHARA_SECTOR_NONE   0xffffffff
 
+/* Number of entries in the sector->page lookup cache. Every lookup
+ * otherwise walks the radix tree from the root, costing up to one
+ * metadata read per bit of the sector number. The cache is
+ * direct-mapped and holds only the results of completed lookups, so it
+ * never affects what is written to flash. Set to 0 to disable it.
+ */
+#ifndef DHARA_MAP_CACHE_SIZE
+#define DHARA_MAP_CACHE_SIZE    0
+#endif
+
+struct dhara_map_cache_entry {
+    dhara_sector_t      sector;
+    dhara_page_t        page;
+};
+
 struct dhara_map {
     struct dhara_journal    journal;
 
     uint8_t         gc_ratio;
     dhara_sector_t      count;
+
+#if DHARA_MAP_CACHE_SIZE > 0
+    struct dhara_map_cache_entry    cache[DHARA_MAP_CACHE_SIZE];
+    uint32_t        cache_hits;
+    uint32_t        cache_misses;
+#endif
 };
 
 /* Initialize a map. You need to supply a buffer for page metadata, and
@@ -50,6 +71,13 @@ void dhara_map_init(struct dhara_map *m, const struct dhara_nand *n,
  */
 int dhara_map_resume(struct dhara_map *m, dhara_error_t *err);
 
+/* Recover stored state from a known journal root and epoch, saved after
+ * dhara_map_sync(). See dhara_journal_resume_at(). If -1 is returned,
+ * the map is empty and dhara_map_resume() should be called instead.
+ */
+int dhara_map_resume_at(struct dhara_map *m, dhara_page_t root,
+                        uint8_t epoch, dhara_error_t *err);
+
 /* Clear the map (delete all sectors). */
 void dhara_map_clear(struct dhara_map *m);
 
@@ -69,6 +97,14 @@ static inline dhara_sector_t dhara_map_size(const struct dhara_map *m)
 int dhara_map_find(struct dhara_map *m, dhara_sector_t s,
                    dhara_page_t *loc, dhara_error_t *err);
 
+/* Obtain lookup cache statistics: the number of dhara_map_find() calls
+ * (including those made on behalf of reads and copies) answered from the
+ * cache, and the number which required a walk of the tree. Both are zero
+ * if the cache is disabled.
+ */
+void dhara_map_cache_stats(const struct dhara_map *m,
+                           uint32_t *hits, uint32_t *misses);
+
 /* Read from the given logical sector. If the sector is unmapped, a
  * blank page (0xff) will be returned.
  */
@@ -99,6 +135,15 @@ int dhara_map_copy_sector(struct dhara_map *m, dhara_sector_t src,
 int dhara_map_trim(struct dhara_map *m, dhara_sector_t s,
                    dhara_error_t *err);
 
+/* Delete count consecutive logical sectors, starting at start. Same as
+ * calling dhara_map_trim() on each of them, except that unmapped sectors
+ * don't trigger garbage collection, and garbage collection deletes the
+ * sectors of the range it finds at the tail of the journal rather than
+ * copying them first.
+ */
+int dhara_map_trim_range(struct dhara_map *m, dhara_sector_t start,
+                         dhara_sector_t count, dhara_error_t *err);
+
 /* Synchronize the map. Once this returns successfully, all changes to
  * date are persistent and durable. Conversely, there is no guarantee
  * that unsynchronized changes will be persistent.
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -30,6 +32,13 @@ typedef enum {
 typedef enum {
     JPEG_IMAGE_FORMAT_RGB888 = 0,   /*!< Format RGB888 */
     JPEG_IMAGE_FORMAT_RGB565,       /*!< Format RGB565 */
+    JPEG_IMAGE_FORMAT_BGR888,       /*!< Format BGR888: RGB888 with the first and last color bytes swapped */
+    JPEG_IMAGE_FORMAT_RGB565_BE,    /*!< Format RGB565 big-endian, the byte order of most SPI LCDs: RGB565 with swapped bytes */
+    JPEG_IMAGE_FORMAT_GRAY,         /*!< Format Y8 (luma only). Not supported with the ROM decoder */
+    JPEG_IMAGE_FORMAT_YUV422P,      /*!< Format YUV 4:2:2 planar: Y plane, then U and V planes of ((width + 1) / 2) x height.
+                                         Not supported with the ROM decoder or esp_jpeg_decode_stream() */
+    JPEG_IMAGE_FORMAT_YUV420P,      /*!< Format YUV 4:2:0 planar (I420): Y plane, then U and V planes of ((width + 1) / 2) x
+                                         ((height + 1) / 2). Not supported with the ROM decoder or esp_jpeg_decode_stream() */
 } esp_jpeg_image_format_t;
 
 /**
@@ -48,11 +57,25 @@ typedef struct esp_jpeg_image_cfg_s {
         uint8_t swap_color_bytes: 1; /*!< Swap first and last color bytes */
     } flags;
 
+    struct {
+        uint16_t left;      /*!< Left edge of the region, in pixels of the output (scaled) image */
+        uint16_t top;       /*!< Top edge of the region, in pixels of the output (scaled) image */
+        uint16_t width;     /*!< Width of the region, 0 for the whole image. Clipped at the right edge of the image */
+        uint16_t height;    /*!< Height of the region, 0 for the whole image. Clipped at the bottom edge of the image */
+    } roi;                  /*!< Region of interest: only this part of the image is decoded, as an image of its own
+                                 size in outbuf. MCUs left and right of it are not transformed, and decoding stops
+                                 after its last line */
+
     struct {
         void *working_buffer;       /*!< If set to NULL, a working buffer will be allocated in esp_jpeg_decode().
                                          Tjpgd does not use dynamic allocation, se we pass this buffer to Tjpgd that uses it as scratchpad */
         size_t working_buffer_size; /*!< Size of the working buffer. Must be set it working_buffer != NULL.
                                          Default size is 3.1kB or 65kB if JD_FASTDECODE == 2 */
+        uint8_t num_tasks;          /*!< Number of tasks decoding the image, including the calling task (0 and 1 decode in
+                                         the calling task only). Only images with restart markers (DRI) are split between
+                                         tasks, others are decoded in the calling task. Each additional task needs
+                                         CONFIG_JD_TASK_STACK_SIZE bytes of stack and 2kB of working memory. Not supported with the ROM decoder
+                                         or with JD_FASTDECODE == 0 */
     } advanced;
 
     struct {
@@ -64,23 +87,26 @@ typedef struct esp_jpeg_image_cfg_s {
  * @brief JPEG output info
  */
 typedef struct esp_jpeg_image_output_s {
-    uint16_t width;    /*!< Width of the output image */
-    uint16_t height;   /*!< Height of the output image */
+    uint16_t width;    /*!< Width of the output image (of the region of interest, if set) */
+    uint16_t height;   /*!< Height of the output image (of the region of interest, if set) */
     size_t output_len; /*!< Length of the output image in bytes */
 } esp_jpeg_image_output_t;
 
 /**
  * @brief Decode JPEG image
  *
- * @note This function is blocking.
+ * @note This function is blocking. With cfg->advanced.num_tasks > 1, parts of the image are decoded by temporary
+ *       tasks created with the priority of the calling task, and the function returns once all of them are done.
  *
  * @param[in]  cfg: Configuration structure
  * @param[out] img: Output image info
  *
  * @return
- *      - ESP_OK            on success
- *      - ESP_ERR_NO_MEM    if there is no memory for allocating main structure
- *      - ESP_FAIL          if there is an error in decoding JPEG
+ *      - ESP_OK                on success
+ *      - ESP_ERR_INVALID_ARG   if the region of interest is outside of the image
+ *      - ESP_ERR_NO_MEM        if there is no memory for allocating main structure
+ *      - ESP_ERR_NOT_SUPPORTED if the output format is not supported in this configuration
+ *      - ESP_FAIL              if there is an error in decoding JPEG
  */
 esp_err_t esp_jpeg_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img);
 
@@ -96,11 +122,151 @@ esp_err_t esp_jpeg_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *im
  *
  * @return
  *      - ESP_OK              on success
- *      - ESP_ERR_INVALID_ARG if cfg or img is NULL
+ *      - ESP_ERR_INVALID_ARG if cfg or img is NULL, or the region of interest is outside of the image
  *      - ESP_FAIL            if there is an error in decoding JPEG
  */
 esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img);
 
+/**
+ * @brief Input callback of the streaming decoder
+ *
+ * @param[in]  user_data: User data from the stream configuration
+ * @param[out] buf: Buffer to store the read data in, or NULL to skip len bytes of the stream
+ * @param[in]  len: Number of bytes to read or skip
+ *
+ * @return Number of bytes read or skipped, 0 at the end of the stream or on a read error. The callback is called
+ *         again for the rest if less than len is returned.
+ */
+typedef size_t (*esp_jpeg_stream_read_cb_t)(void *user_data, uint8_t *buf, size_t len);
+
+/**
+ * @brief Output callback of the streaming decoder
+ *
+ * Called for each band of decoded lines, from the top of the image to the bottom. A band is one row of MCUs:
+ * 8 or 16 lines depending on the chroma subsampling of the image, divided by the output scale (the last band may be
+ * shorter). The lines are img->width pixels long in the output format, without padding.
+ *
+ * The band buffer is overwritten with the next band once the callback returns.
+ *
+ * @param[in] user_data: User data from the stream configuration
+ * @param[in] band: Decoded pixels of the band
+ * @param[in] top: Index of the first line of the band in the output image
+ * @param[in] lines: Number of lines in the band
+ * @param[in] img: Output image info
+ *
+ * @return true to continue decoding, false to stop it
+ */
+typedef bool (*esp_jpeg_stream_band_cb_t)(void *user_data, const uint8_t *band, uint16_t top, uint16_t lines, const esp_jpeg_image_output_t *img);
+
+/**
+ * @brief JPEG streaming decoder configuration
+ *
+ */
+typedef struct esp_jpeg_stream_cfg_s {
+    esp_jpeg_stream_read_cb_t read_cb;  /*!< Reads the JPEG stream */
+    esp_jpeg_stream_band_cb_t band_cb;  /*!< Receives the decoded image, a band of lines at a time */
+    void *user_data;                    /*!< User data passed to the callbacks */
+    esp_jpeg_image_format_t out_format; /*!< Output image format */
+    esp_jpeg_image_scale_t  out_scale;  /*!< Output scale */
+
+    struct {
+        uint8_t swap_color_bytes: 1; /*!< Swap first and last color bytes */
+    } flags;
+
+    struct {
+        void *working_buffer;       /*!< Same as in esp_jpeg_image_cfg_t */
+        size_t working_buffer_size; /*!< Same as in esp_jpeg_image_cfg_t */
+        void *band_buffer;          /*!< If set to NULL, a band buffer will be allocated in esp_jpeg_decode_stream().
+                                         Pass a DMA-capable buffer to send the bands to a display without a copy. */
+        size_t band_buffer_size;    /*!< Size of the band buffer. Must be set if band_buffer != NULL, and hold at least
+                                         width x 16 lines of the output image (width x 8 lines for images without
+                                         vertical chroma subsampling) */
+    } advanced;
+} esp_jpeg_stream_cfg_t;
+
+/**
+ * @brief Decode JPEG stream band by band
+ *
+ * The image is read through cfg->read_cb and passed to cfg->band_cb a band of lines at a time, so neither the input
+ * image nor the output image needs to be held in memory at once. Besides the working buffer, the decoder only
+ * needs one band: for example 800 x 16 x 2 bytes for an 800 pixels wide image in RGB565.
+ *
+ * @note This function is blocking. The callbacks are called from the calling task.
+ *
+ * @param[in]  cfg: Stream configuration
+ * @param[out] img: Output image info
+ *
+ * @return
+ *      - ESP_OK                on success
+ *      - ESP_ERR_INVALID_ARG   if a callback is missing, or the band buffer size is not set
+ *      - ESP_ERR_NO_MEM        if the working buffer or the band buffer cannot be allocated or is too small
+ *      - ESP_ERR_NOT_SUPPORTED if the output format is not supported in this configuration
+ *      - ESP_ERR_NOT_FINISHED  if the band callback stopped decoding
+ *      - ESP_FAIL              if there is an error in decoding JPEG
+ */
+esp_err_t esp_jpeg_decode_stream(const esp_jpeg_stream_cfg_t *cfg, esp_jpeg_image_output_t *img);
+
+/**
+ * @brief Handle of a decoder for a sequence of images, such as MJPEG frames from a camera
+ */
+typedef struct esp_jpeg_decoder_s *esp_jpeg_decoder_handle_t;
+
+/**
+ * @brief JPEG decoder handle configuration
+ */
+typedef struct {
+    void *working_buffer;       /*!< If set to NULL, a working buffer is allocated by esp_jpeg_decoder_new() and kept
+                                     until esp_jpeg_decoder_del() */
+    size_t working_buffer_size; /*!< Size of the working buffer. Must be set if working_buffer != NULL */
+} esp_jpeg_decoder_config_t;
+
+/**
+ * @brief Create a decoder handle
+ *
+ * @param[in]  config: Decoder configuration
+ * @param[out] ret_decoder: Created decoder handle
+ *
+ * @return
+ *      - ESP_OK                on success
+ *      - ESP_ERR_INVALID_ARG   if an argument is NULL, or the working buffer size is not set
+ *      - ESP_ERR_NO_MEM        if the handle or the working buffer cannot be allocated
+ */
+esp_err_t esp_jpeg_decoder_new(const esp_jpeg_decoder_config_t *config, esp_jpeg_decoder_handle_t *ret_decoder);
+
+/**
+ * @brief Decode a JPEG image with a decoder handle
+ *
+ * Same as esp_jpeg_decode(), with the working buffer of the handle (cfg->advanced.working_buffer is ignored).
+ * The Huffman tables built for the previous image are kept when the image defines the same tables in the same
+ * order, or uses the default tables, as consecutive frames of an MJPEG stream usually do.
+ *
+ * @note This function is blocking. A handle must not be used by several tasks at the same time.
+ *
+ * @param[in]  decoder: Decoder handle
+ * @param[in]  cfg: Configuration structure
+ * @param[out] img: Output image info
+ *
+ * @return
+ *      - ESP_OK                on success
+ *      - ESP_ERR_INVALID_ARG   if an argument is NULL, or the region of interest is outside of the image
+ *      - ESP_ERR_NO_MEM        if the output buffer is too small
+ *      - ESP_ERR_NOT_SUPPORTED if the output format is not supported in this configuration
+ *      - ESP_FAIL              if there is an error in decoding JPEG
+ */
+esp_err_t esp_jpeg_decoder_decode_frame(esp_jpeg_decoder_handle_t decoder, esp_jpeg_image_cfg_t *cfg,
+                                        esp_jpeg_image_output_t *img);
+
+/**
+ * @brief Delete a decoder handle
+ *
+ * @param[in] decoder: Decoder handle
+ *
+ * @return
+ *      - ESP_OK                on success
+ *      - ESP_ERR_INVALID_ARG   if decoder is NULL
+ */
+esp_err_t esp_jpeg_decoder_del(esp_jpeg_decoder_handle_t decoder);
+
 #ifdef __cplusplus
 }
 #endif
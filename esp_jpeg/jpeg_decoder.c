@@ -5,7 +5,10 @@
  */
 
 #include <string.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_rom_caps.h"
 #include "esp_log.h"
@@ -36,6 +39,9 @@ static const char *TAG = "JPEG";
 #define LOBYTE(u16)     ((uint8_t)(((uint16_t)(u16)) & 0xff))
 #define HIBYTE(u16)     ((uint8_t)((((uint16_t)(u16))>>8) & 0xff))
 
+/* RGB888 pixel to RGB565 value */
+#define RGB565(p)       ((uint16_t)((((p)[0] & 0xF8) << 8) | (((p)[1] & 0xFC) << 3) | ((p)[2] >> 3)))
+
 #if defined(JD_FASTDECODE) && (JD_FASTDECODE == 2)
 #define JPEG_WORK_BUF_SIZE  65472
 #else
@@ -57,70 +63,182 @@ static const char *TAG = "JPEG";
 #define ESP_JPEG_COLOR_BYTES    1
 #endif
 
+#if !CONFIG_JD_USE_ROM
+/* Working memory of a task decoding a part of the image: input buffer, IDCT/output buffer and MCU buffer for the largest
+ * MCU (4 Y blocks), as allocated by jd_clone(), plus alignment */
+#define JPEG_TASK_BUF_SIZE      (JD_SZBUF + (4 * 64 * 2 + 64) + (6 * 64 * sizeof(jd_yuv_t)) + 16)
+#define JPEG_TASK_STACK_SIZE    CONFIG_JD_TASK_STACK_SIZE
+#endif
+
+/* Converts a row of n pixels from the TJPGD output format to the output format */
+typedef void (*jpeg_row_fn_t)(uint8_t *dst, const uint8_t *src, unsigned int n);
+
+/* Decoder kept across frames */
+struct esp_jpeg_decoder_s {
+    uint8_t *workbuf;
+    size_t workbuf_size;
+    bool own_workbuf;                   /* workbuf was allocated by esp_jpeg_decoder_new() */
+    bool prepared;                      /* jdec and the tables in workbuf are those of the previous frame */
+    JDEC jdec;
+};
+
+/* Decoding session, passed to the TJPGD callbacks as the I/O device */
+typedef struct {
+    esp_jpeg_image_cfg_t *cfg;          /* In-memory input, or NULL when reading through read_cb */
+    esp_jpeg_stream_read_cb_t read_cb;
+    esp_jpeg_stream_band_cb_t band_cb;  /* Band output, or NULL when decoding to a frame buffer */
+    void *user_data;
+    uint8_t *outbuf;                    /* Frame buffer or band buffer */
+    uint16_t band_top;                  /* First line of the image in outbuf */
+    esp_jpeg_image_format_t out_format;
+    esp_jpeg_image_scale_t out_scale;
+    bool swap_color_bytes;
+    jpeg_row_fn_t row_fn;               /* Output conversion, picked for the format at the start of decoding */
+    uint8_t out_color_bytes;            /* Bytes per pixel of outbuf, of the Y plane for planar formats */
+    uint8_t in_color_bytes;             /* Bytes per pixel of the TJPGD output */
+    bool ycbcr;                         /* TJPGD outputs Y, Cb, Cr instead of RGB */
+    bool planar;                        /* Output is written by jpeg_write_planar() instead of row_fn */
+    esp_jpeg_image_output_t *img;
+    uint16_t roi_left, roi_top;         /* Region of the output image in outbuf, its size is in img */
+    uint8_t num_tasks;                  /* Number of tasks decoding an in-memory image */
+    esp_jpeg_decoder_handle_t decoder;  /* Decoder holding the working buffer and decompressor, or NULL */
+} esp_jpeg_session_t;
+
+#if !CONFIG_JD_USE_ROM
+/* A range of restart intervals decoded by another task */
+typedef struct {
+    JDEC jdec;
+    unsigned int first;                 /* First restart interval */
+    unsigned int count;                 /* Number of restart intervals */
+    uint8_t scale;
+    JRESULT res;
+    SemaphoreHandle_t done;
+    uint32_t pool[JPEG_TASK_BUF_SIZE / sizeof(uint32_t)];
+} jpeg_task_part_t;
+#endif
+
 /*******************************************************************************
 * Function definitions
 *******************************************************************************/
 static uint8_t jpeg_get_div_by_scale(esp_jpeg_image_scale_t scale);
 static uint8_t jpeg_get_color_bytes(esp_jpeg_image_format_t format);
-
+static uint32_t jpeg_get_output_len(esp_jpeg_image_format_t format, uint16_t width, uint16_t height);
+static jpeg_row_fn_t jpeg_get_row_fn(esp_jpeg_image_format_t format, bool swap_color_bytes);
+static bool jpeg_get_roi(const esp_jpeg_image_cfg_t *cfg, uint16_t *left, uint16_t *top, uint16_t *width,
+                         uint16_t *height);
+
+static esp_err_t jpeg_decode_session(esp_jpeg_session_t *session, void *working_buffer, size_t working_buffer_size,
+                                     size_t outbuf_size);
+#if !CONFIG_JD_USE_ROM
+static esp_err_t jpeg_decode_parallel(esp_jpeg_session_t *session, JDEC *jdec);
+#endif
 static unsigned int jpeg_decode_in_cb(JDEC *jd, uint8_t *buff, unsigned int nbyte);
 static jpeg_decode_out_t jpeg_decode_out_cb(JDEC *jd, void *bitmap, JRECT *rect);
+static void jpeg_write_planar(esp_jpeg_session_t *session, const uint8_t *in, size_t in_stride, unsigned int x,
+                              unsigned int y, unsigned int w, unsigned int h);
 static inline uint16_t ldb_word(const void *ptr);
+static inline uint16_t swap16(uint16_t v);
 /*******************************************************************************
 * Public API functions
 *******************************************************************************/
 
 esp_err_t esp_jpeg_decode(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
 {
-    esp_err_t ret = ESP_OK;
-    uint8_t *workbuf = NULL;
-    JRESULT res;
-    JDEC JDEC;
-
     assert(cfg != NULL);
     assert(img != NULL);
 
-    const bool allocate_buffer = (cfg->advanced.working_buffer == NULL);
-    const size_t workbuf_size = allocate_buffer ? JPEG_WORK_BUF_SIZE : cfg->advanced.working_buffer_size;
-    if (allocate_buffer) {
-        workbuf = heap_caps_malloc(JPEG_WORK_BUF_SIZE, MALLOC_CAP_DEFAULT);
-        ESP_GOTO_ON_FALSE(workbuf, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG work buffer");
-    } else {
-        workbuf = cfg->advanced.working_buffer;
-        ESP_RETURN_ON_FALSE(workbuf_size != 0, ESP_ERR_INVALID_ARG, TAG, "Working buffer size not defined!");
-    }
-
-
+    esp_jpeg_session_t session = {
+        .cfg = cfg,
+        .outbuf = cfg->outbuf,
+        .out_format = cfg->out_format,
+        .out_scale = cfg->out_scale,
+        .swap_color_bytes = cfg->flags.swap_color_bytes,
+        .img = img,
+        .num_tasks = cfg->advanced.num_tasks,
+    };
     cfg->priv.read = 0;
 
-    /* Prepare image */
-    res = jd_prepare(&JDEC, jpeg_decode_in_cb, workbuf, workbuf_size, cfg);
-    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in preparing JPEG image! %d", res);
+    return jpeg_decode_session(&session, cfg->advanced.working_buffer, cfg->advanced.working_buffer_size, cfg->outbuf_size);
+}
 
-    const uint8_t scale_div       = jpeg_get_div_by_scale(cfg->out_scale);
-    const uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
+esp_err_t esp_jpeg_decode_stream(const esp_jpeg_stream_cfg_t *cfg, esp_jpeg_image_output_t *img)
+{
+    ESP_RETURN_ON_FALSE(cfg && img, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(cfg->read_cb && cfg->band_cb, ESP_ERR_INVALID_ARG, TAG, "read_cb and band_cb must be set");
+    ESP_RETURN_ON_FALSE(!cfg->advanced.band_buffer || cfg->advanced.band_buffer_size, ESP_ERR_INVALID_ARG, TAG, "Band buffer size not defined!");
+
+    esp_jpeg_session_t session = {
+        .read_cb = cfg->read_cb,
+        .band_cb = cfg->band_cb,
+        .user_data = cfg->user_data,
+        .outbuf = cfg->advanced.band_buffer,
+        .out_format = cfg->out_format,
+        .out_scale = cfg->out_scale,
+        .swap_color_bytes = cfg->flags.swap_color_bytes,
+        .img = img,
+    };
+
+    return jpeg_decode_session(&session, cfg->advanced.working_buffer, cfg->advanced.working_buffer_size,
+                               cfg->advanced.band_buffer_size);
+}
 
-    /* Size of output image */
-    const uint32_t outsize = (JDEC.height / scale_div) * (JDEC.width / scale_div) * out_color_bytes;
-    ESP_GOTO_ON_FALSE((outsize <= cfg->outbuf_size), ESP_ERR_NO_MEM, err, TAG, "Not enough size in output buffer!");
+esp_err_t esp_jpeg_decoder_new(const esp_jpeg_decoder_config_t *config, esp_jpeg_decoder_handle_t *ret_decoder)
+{
+    ESP_RETURN_ON_FALSE(config && ret_decoder, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(!config->working_buffer || config->working_buffer_size, ESP_ERR_INVALID_ARG, TAG, "Working buffer size not defined!");
 
-    /* Size of output image */
-    img->height = JDEC.height / scale_div;
-    img->width = JDEC.width / scale_div;
-    img->output_len = outsize;
+    esp_err_t ret = ESP_OK;
+    esp_jpeg_decoder_handle_t decoder = heap_caps_calloc(1, sizeof(struct esp_jpeg_decoder_s), MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(decoder, ESP_ERR_NO_MEM, TAG, "no mem for JPEG decoder");
+    if (config->working_buffer) {
+        decoder->workbuf = config->working_buffer;
+        decoder->workbuf_size = config->working_buffer_size;
+    } else {
+        decoder->workbuf = heap_caps_malloc(JPEG_WORK_BUF_SIZE, MALLOC_CAP_DEFAULT);
+        ESP_GOTO_ON_FALSE(decoder->workbuf, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG work buffer");
+        decoder->workbuf_size = JPEG_WORK_BUF_SIZE;
+        decoder->own_workbuf = true;
+    }
 
-    /* Decode JPEG */
-    res = jd_decomp(&JDEC, jpeg_decode_out_cb, cfg->out_scale);
-    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in decoding JPEG image! %d", res);
+    *ret_decoder = decoder;
+    return ESP_OK;
 
 err:
-    if (workbuf && allocate_buffer) {
-        free(workbuf);
-    }
-
+    free(decoder);
     return ret;
 }
 
+esp_err_t esp_jpeg_decoder_decode_frame(esp_jpeg_decoder_handle_t decoder, esp_jpeg_image_cfg_t *cfg,
+                                        esp_jpeg_image_output_t *img)
+{
+    ESP_RETURN_ON_FALSE(decoder && cfg && img, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    esp_jpeg_session_t session = {
+        .cfg = cfg,
+        .outbuf = cfg->outbuf,
+        .out_format = cfg->out_format,
+        .out_scale = cfg->out_scale,
+        .swap_color_bytes = cfg->flags.swap_color_bytes,
+        .img = img,
+        .num_tasks = cfg->advanced.num_tasks,
+        .decoder = decoder,
+    };
+    cfg->priv.read = 0;
+
+    return jpeg_decode_session(&session, decoder->workbuf, decoder->workbuf_size, cfg->outbuf_size);
+}
+
+esp_err_t esp_jpeg_decoder_del(esp_jpeg_decoder_handle_t decoder)
+{
+    ESP_RETURN_ON_FALSE(decoder, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    if (decoder->own_workbuf) {
+        free(decoder->workbuf);
+    }
+    free(decoder);
+    return ESP_OK;
+}
+
 esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
 {
     if (cfg == NULL || img == NULL) {
@@ -155,8 +273,11 @@ esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_outp
             img->height = ldb_word(seg + 1);
             img->width = ldb_word(seg + 3);
             const uint8_t scale_div       = jpeg_get_div_by_scale(cfg->out_scale);
-            const uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
-            img->output_len = (img->height / scale_div) * (img->width / scale_div) * out_color_bytes;
+            uint16_t left, top, width = img->width / scale_div, height = img->height / scale_div;
+            if (!jpeg_get_roi(cfg, &left, &top, &width, &height)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            img->output_len = jpeg_get_output_len(cfg->out_format, width, height);
             ret = ESP_OK;
             break;
         }
@@ -168,14 +289,253 @@ esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_outp
 * Private API functions
 *******************************************************************************/
 
+static esp_err_t jpeg_decode_session(esp_jpeg_session_t *session, void *working_buffer, size_t working_buffer_size,
+                                     size_t outbuf_size)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t *workbuf = NULL;
+    uint8_t *bandbuf = NULL;
+    JRESULT res;
+    JDEC jdec_local;
+    JDEC *jdec = session->decoder ? &session->decoder->jdec : &jdec_local;
+#if !CONFIG_JD_USE_ROM
+    bool in_place = false;  /* Input is read in place from cfg->indata */
+#endif
+
+    session->row_fn = jpeg_get_row_fn(session->out_format, session->swap_color_bytes);
+#if !CONFIG_JD_USE_ROM
+    session->planar = (session->out_format == JPEG_IMAGE_FORMAT_YUV422P ||
+                       session->out_format == JPEG_IMAGE_FORMAT_YUV420P);
+    session->ycbcr = session->planar || session->out_format == JPEG_IMAGE_FORMAT_GRAY;
+#endif
+    ESP_RETURN_ON_FALSE(session->row_fn || session->planar, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Selected output format is not supported!");
+    ESP_RETURN_ON_FALSE(!session->planar || !session->band_cb, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Planar output formats are not supported in streaming decode!");
+    session->out_color_bytes = jpeg_get_color_bytes(session->out_format);
+    session->in_color_bytes = session->ycbcr ? 3 : ESP_JPEG_COLOR_BYTES;
+
+    const bool allocate_buffer = (working_buffer == NULL);
+    const size_t workbuf_size = allocate_buffer ? JPEG_WORK_BUF_SIZE : working_buffer_size;
+    if (allocate_buffer) {
+        workbuf = heap_caps_malloc(JPEG_WORK_BUF_SIZE, MALLOC_CAP_DEFAULT);
+        ESP_GOTO_ON_FALSE(workbuf, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG work buffer");
+    } else {
+        workbuf = working_buffer;
+        ESP_RETURN_ON_FALSE(workbuf_size != 0, ESP_ERR_INVALID_ARG, TAG, "Working buffer size not defined!");
+    }
+
+    /* Prepare image */
+#if !CONFIG_JD_USE_ROM
+    if (session->decoder && session->decoder->prepared) {
+        /* Keep the Huffman tables of the previous frame that did not change */
+        res = jd_prepare_next(jdec, jpeg_decode_in_cb, workbuf, workbuf_size, session);
+    } else
+#endif
+    {
+        res = jd_prepare(jdec, jpeg_decode_in_cb, workbuf, workbuf_size, session);
+    }
+    if (session->decoder) {
+        session->decoder->prepared = (res == JDR_OK);
+    }
+    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in preparing JPEG image! %d", res);
+
+#if !CONFIG_JD_USE_ROM
+    jdec->ycbcr = session->ycbcr;
+
+    if (session->cfg) {
+        /* The image is in memory: let the bit reader consume it in place instead of copying it to the input buffer */
+        esp_jpeg_image_cfg_t *cfg = session->cfg;
+        if (jd_input_mem(jdec, cfg->indata + cfg->priv.read, cfg->indata_size - cfg->priv.read) == JDR_OK) {
+            cfg->priv.read = cfg->indata_size;
+            in_place = true;
+        }
+    }
+#endif
+
+    const uint8_t scale_div       = jpeg_get_div_by_scale(session->out_scale);
+    const uint8_t out_color_bytes = session->out_color_bytes;
+
+    /* Size of output image */
+    uint16_t width = jdec->width / scale_div, height = jdec->height / scale_div;
+    if (session->cfg) {
+        ESP_GOTO_ON_FALSE(jpeg_get_roi(session->cfg, &session->roi_left, &session->roi_top, &width, &height),
+                          ESP_ERR_INVALID_ARG, err, TAG, "Region of interest outside of the image!");
+#if !CONFIG_JD_USE_ROM
+        /* Skip the MCUs around the region (in input image pixels) */
+        const uint8_t shift = session->out_scale;
+        jdec->roi.left = session->roi_left << shift;
+        jdec->roi.top = session->roi_top << shift;
+        jdec->roi.right = MIN(((session->roi_left + width) << shift) - 1, jdec->width - 1);
+        jdec->roi.bottom = MIN(((session->roi_top + height) << shift) - 1, jdec->height - 1);
+#endif
+    }
+    const uint32_t outsize = jpeg_get_output_len(session->out_format, width, height);
+    session->img->height = height;
+    session->img->width = width;
+    session->img->output_len = outsize;
+
+    if (session->band_cb) {
+        /* One row of MCUs */
+        uint16_t band_lines = (jdec->msy * 8) / scale_div;
+        const uint32_t bandsize = session->img->width * (band_lines ? band_lines : 1) * out_color_bytes;
+        if (session->outbuf == NULL) {
+            bandbuf = heap_caps_malloc(bandsize, MALLOC_CAP_DEFAULT);
+            ESP_GOTO_ON_FALSE(bandbuf, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG band buffer");
+            session->outbuf = bandbuf;
+        } else {
+            ESP_GOTO_ON_FALSE((bandsize <= outbuf_size), ESP_ERR_NO_MEM, err, TAG, "Not enough size in band buffer!");
+        }
+    } else {
+        ESP_GOTO_ON_FALSE((outsize <= outbuf_size), ESP_ERR_NO_MEM, err, TAG, "Not enough size in output buffer!");
+    }
+
+#if !CONFIG_JD_USE_ROM
+    if (in_place && session->num_tasks > 1) {
+        ret = jpeg_decode_parallel(session, jdec);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            goto err;
+        }
+        ret = ESP_OK;   /* The image cannot be split, decode it in this task */
+    }
+#endif
+
+    /* Decode JPEG */
+    res = jd_decomp(jdec, jpeg_decode_out_cb, session->out_scale);
+    ESP_GOTO_ON_FALSE((res != JDR_INTR), ESP_ERR_NOT_FINISHED, err, TAG, "Decoding stopped by the band callback");
+    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in decoding JPEG image! %d", res);
+
+err:
+    if (workbuf && allocate_buffer) {
+        free(workbuf);
+    }
+    free(bandbuf);
+
+    return ret;
+}
+
+#if !CONFIG_JD_USE_ROM
+static void jpeg_decode_task(void *arg)
+{
+    jpeg_task_part_t *part = (jpeg_task_part_t *)arg;
+
+    part->res = jd_decomp_rst(&part->jdec, jpeg_decode_out_cb, part->scale, part->first, part->count);
+    xSemaphoreGive(part->done);
+    vTaskDelete(NULL);
+}
+
+/*
+ * Splits the restart intervals of an in-memory image between session->num_tasks tasks. The entropy-coded data is
+ * scanned for the restart markers first, so that each task can start decoding right after the marker preceding its
+ * first interval. The calling task decodes the first part with jdec.
+ *
+ * Returns ESP_ERR_NOT_SUPPORTED, before anything is decoded, if the image has no restart intervals or its markers are
+ * not where expected; the caller then decodes the image in one go.
+ */
+static esp_err_t jpeg_decode_parallel(esp_jpeg_session_t *session, JDEC *jdec)
+{
+    esp_err_t ret = ESP_OK;
+    const unsigned int mx = jdec->msx * 8, my = jdec->msy * 8;
+    const unsigned int mcus = ((jdec->width + mx - 1) / mx) * (jdec->roi.bottom / my + 1);    /* Up to the last row output */
+    if (!jdec->nrst) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    const unsigned int intervals = (mcus + jdec->nrst - 1) / jdec->nrst;
+    const unsigned int num_tasks = MIN(session->num_tasks, intervals);
+    if (num_tasks < 2) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    jpeg_task_part_t *parts = heap_caps_calloc(num_tasks - 1, sizeof(jpeg_task_part_t), MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(parts, ESP_ERR_NO_MEM, TAG, "no mem for JPEG decoding tasks");
+    for (unsigned int i = 0; i < num_tasks - 1; i++) {
+        parts[i].first = (i + 1) * intervals / num_tasks;
+        parts[i].count = (i + 2) * intervals / num_tasks - parts[i].first;
+        parts[i].scale = session->out_scale;
+    }
+
+    /* Find the restart marker preceding each part. RSTn markers cannot occur in entropy-coded data otherwise. */
+    const uint8_t *end = session->cfg->indata + session->cfg->indata_size;
+    const uint8_t *p = jdec->dptr;
+    unsigned int rst = 0, i = 0;
+    while (i < num_tasks - 1 && end - p >= 2 && (p = memchr(p, 0xFF, end - p - 1)) != NULL) {
+        if ((p[1] & 0xF8) != 0xD0) {
+            p++;
+            continue;
+        }
+        if ((p[1] & 7) != (rst & 7)) {
+            break;  /* Missing marker */
+        }
+        p += 2;
+        if (++rst == parts[i].first) {
+            JRESULT res = jd_clone(&parts[i].jdec, jdec, parts[i].pool, sizeof(parts[i].pool));
+            ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in preparing JPEG decoding task! %d", res);
+            res = jd_input_mem(&parts[i].jdec, p, end - p);
+            ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in preparing JPEG decoding task! %d", res);
+            i++;
+        }
+    }
+    if (i < num_tasks - 1) {
+        ESP_LOGD(TAG, "Restart markers not found, decoding in one task");
+        ret = ESP_ERR_NOT_SUPPORTED;
+        goto err;
+    }
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(num_tasks - 1, 0);
+    ESP_GOTO_ON_FALSE(done, ESP_ERR_NO_MEM, err, TAG, "no mem for JPEG decoding tasks");
+    unsigned int started = 0;
+    for (i = 0; i < num_tasks - 1; i++) {
+        parts[i].done = done;
+        if (xTaskCreate(jpeg_decode_task, "jpeg_dec", JPEG_TASK_STACK_SIZE, &parts[i], uxTaskPriorityGet(NULL),
+                        NULL) != pdPASS) {
+            break;
+        }
+        started++;
+    }
+
+    /* Decode the first part here, and the parts no task could be created for */
+    JRESULT res = jd_decomp_rst(jdec, jpeg_decode_out_cb, session->out_scale, 0, parts[0].first);
+    for (i = started; i < num_tasks - 1; i++) {
+        parts[i].res = jd_decomp_rst(&parts[i].jdec, jpeg_decode_out_cb, parts[i].scale, parts[i].first, parts[i].count);
+    }
+    for (i = 0; i < started; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(done);
+
+    for (i = 0; i < num_tasks - 1 && res == JDR_OK; i++) {
+        res = parts[i].res;
+    }
+    ESP_GOTO_ON_FALSE((res == JDR_OK), ESP_FAIL, err, TAG, "Error in decoding JPEG image! %d", res);
+
+err:
+    free(parts);
+    return ret;
+}
+#endif
+
 static unsigned int jpeg_decode_in_cb(JDEC *dec, uint8_t *buff, unsigned int nbyte)
 {
     assert(dec != NULL);
 
     uint32_t to_read = nbyte;
-    esp_jpeg_image_cfg_t *cfg = (esp_jpeg_image_cfg_t *)dec->device;
-    assert(cfg != NULL);
+    esp_jpeg_session_t *session = (esp_jpeg_session_t *)dec->device;
+    assert(session != NULL);
+
+    if (session->read_cb) {
+        /* TJPGD treats a short read as the end of the stream, collect partial reads */
+        unsigned int done = 0;
+        while (done < nbyte) {
+            size_t n = session->read_cb(session->user_data, buff ? buff + done : NULL, nbyte - done);
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
 
+    esp_jpeg_image_cfg_t *cfg = session->cfg;
     if (buff) {
         if (cfg->priv.read + to_read > cfg->indata_size) {
             to_read = cfg->indata_size - cfg->priv.read;
@@ -194,58 +554,224 @@ static unsigned int jpeg_decode_in_cb(JDEC *dec, uint8_t *buff, unsigned int nby
 
 static jpeg_decode_out_t jpeg_decode_out_cb(JDEC *dec, void *bitmap, JRECT *rect)
 {
-    uint16_t color = 0;
     assert(dec != NULL);
 
-    esp_jpeg_image_cfg_t *cfg = (esp_jpeg_image_cfg_t *)dec->device;
-    assert(cfg != NULL);
+    esp_jpeg_session_t *session = (esp_jpeg_session_t *)dec->device;
+    assert(session != NULL);
     assert(bitmap != NULL);
     assert(rect != NULL);
 
-    uint8_t scale_div = jpeg_get_div_by_scale(cfg->out_scale);
-    uint8_t out_color_bytes = jpeg_get_color_bytes(cfg->out_format);
-
-    /* Copy decoded image data to output buffer */
-    uint8_t *in = (uint8_t *)bitmap;
-    uint32_t line = dec->width / scale_div;
-    uint8_t *dst = (uint8_t *)cfg->outbuf;
-    for (int y = rect->top; y <= rect->bottom; y++) {
-        for (int x = rect->left; x <= rect->right; x++) {
-            if ( (JD_FORMAT == 0 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB888) ||
-                    (JD_FORMAT == 1 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB565) ) {
-                /* Output image format is same as set in TJPGD */
-                for (int b = 0; b < ESP_JPEG_COLOR_BYTES; b++) {
-                    if (cfg->flags.swap_color_bytes) {
-                        dst[(y * line * out_color_bytes) + x * out_color_bytes + b] = in[out_color_bytes - b - 1];
-                    } else {
-                        dst[(y * line * out_color_bytes) + x * out_color_bytes + b] = in[b];
-                    }
-                }
-            } else if (JD_FORMAT == 0 && cfg->out_format == JPEG_IMAGE_FORMAT_RGB565) {
-                /* Output image format is not same as set in TJPGD */
-                /* We need to convert the 3 bytes in `in` to a rgb565 value */
-                color = ((in[0] & 0xF8) << 8);
-                color |= ((in[1] & 0xFC) << 3);
-                color |= (in[2] >> 3);
-
-                if (cfg->flags.swap_color_bytes) {
-                    dst[(y * line * out_color_bytes) + (x * out_color_bytes)] = HIBYTE(color);
-                    dst[(y * line * out_color_bytes) + (x * out_color_bytes) + 1] = LOBYTE(color);
-                } else {
-                    dst[(y * line * out_color_bytes) + (x * out_color_bytes) + 1] = HIBYTE(color);
-                    dst[(y * line * out_color_bytes) + (x * out_color_bytes)] = LOBYTE(color);
-                }
-            } else {
-                ESP_LOGE(TAG, "Selected output format is not supported!");
-                assert(0);
+    /* Copy the part of the rectangle inside the region of interest to the output buffer, a row at a time */
+    const unsigned int rect_width = rect->right - rect->left + 1;
+    const uint32_t line = session->img->width;
+    const size_t stride = line * session->out_color_bytes;
+    const unsigned int left = MAX(rect->left, session->roi_left);
+    const unsigned int right = MIN(rect->right, session->roi_left + line - 1);
+    const unsigned int top = MAX(rect->top, session->roi_top);
+    const unsigned int bottom = MIN(rect->bottom, session->roi_top + session->img->height - 1);
+    if (left <= right && top <= bottom) {
+        const uint8_t in_color_bytes = session->in_color_bytes;
+        const uint8_t *in = (const uint8_t *)bitmap + ((top - rect->top) * rect_width + (left - rect->left)) * in_color_bytes;
+        if (session->planar) {
+            jpeg_write_planar(session, in, rect_width * in_color_bytes, left - session->roi_left,
+                              top - session->roi_top, right - left + 1, bottom - top + 1);
+        } else {
+            uint8_t *dst = session->outbuf + (top - session->roi_top - session->band_top) * stride +
+                           (left - session->roi_left) * session->out_color_bytes;
+            for (unsigned int y = top; y <= bottom; y++) {
+                session->row_fn(dst, in, right - left + 1);
+                in += rect_width * in_color_bytes;
+                dst += stride;
             }
-            in += ESP_JPEG_COLOR_BYTES;
         }
     }
 
+    /* The last MCU of a row completes the band */
+    if (session->band_cb && rect->right + 1 >= line) {
+        if (!session->band_cb(session->user_data, session->outbuf, session->band_top,
+                              rect->bottom - session->band_top + 1, session->img)) {
+            return 0;
+        }
+        session->band_top = rect->bottom + 1;
+    }
+
     return 1;
 }
 
+/* Writes w x h pixels of TJPGD YCbCr output at x, y of the planar output image. Chroma is taken from the even
+ * columns (and the even lines for 4:2:0), which hold the chroma sample shared with the next pixel. */
+static void jpeg_write_planar(esp_jpeg_session_t *session, const uint8_t *in, size_t in_stride, unsigned int x,
+                              unsigned int y, unsigned int w, unsigned int h)
+{
+    const unsigned int width = session->img->width;
+    const unsigned int height = session->img->height;
+    const bool yuv420 = (session->out_format == JPEG_IMAGE_FORMAT_YUV420P);
+    const unsigned int chroma_width = (width + 1) / 2;
+    const unsigned int chroma_height = yuv420 ? (height + 1) / 2 : height;
+    uint8_t *out_y = session->outbuf + y * width + x;
+    uint8_t *out_u = session->outbuf + width * height;
+    uint8_t *out_v = out_u + chroma_width * chroma_height;
+
+    for (unsigned int j = 0; j < h; j++, in += in_stride, out_y += width) {
+        for (unsigned int i = 0; i < w; i++) {
+            out_y[i] = in[i * 3];
+        }
+        if (yuv420 && ((y + j) & 1)) {
+            continue;
+        }
+        const unsigned int ofs = (yuv420 ? (y + j) / 2 : y + j) * chroma_width;
+        for (unsigned int i = x & 1; i < w; i += 2) {
+            out_u[ofs + (x + i) / 2] = in[i * 3 + 1];
+            out_v[ofs + (x + i) / 2] = in[i * 3 + 2];
+        }
+    }
+}
+
+/*
+ * Row kernels. The output buffer has no alignment requirement, so 16-bit pixels are written a pair at a time
+ * with 32-bit stores only where the destination is word-aligned (the targets are little-endian).
+ */
+#if (JD_FORMAT == 0)
+static void jpeg_row_rgb888(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    memcpy(dst, src, n * 3);
+}
+
+static void jpeg_row_rgb888_swap(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    for (; n; n--, src += 3, dst += 3) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+    }
+}
+
+static void jpeg_row_rgb888_to_rgb565(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    if (((uintptr_t)dst & 3) == 2 && n) {
+        *(uint16_t *)dst = RGB565(src);
+        dst += 2; src += 3; n--;
+    }
+    if (((uintptr_t)dst & 3) == 0) {
+        uint32_t *d = (uint32_t *)dst;
+        for (; n >= 2; n -= 2, src += 6) {
+            *d++ = RGB565(src) | ((uint32_t)RGB565(src + 3) << 16);
+        }
+        dst = (uint8_t *)d;
+    }
+    for (; n; n--, src += 3, dst += 2) {
+        const uint16_t color = RGB565(src);
+        dst[0] = LOBYTE(color);
+        dst[1] = HIBYTE(color);
+    }
+}
+
+static void jpeg_row_rgb888_to_rgb565_swap(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    if (((uintptr_t)dst & 3) == 2 && n) {
+        *(uint16_t *)dst = swap16(RGB565(src));
+        dst += 2; src += 3; n--;
+    }
+    if (((uintptr_t)dst & 3) == 0) {
+        uint32_t *d = (uint32_t *)dst;
+        for (; n >= 2; n -= 2, src += 6) {
+            *d++ = swap16(RGB565(src)) | ((uint32_t)swap16(RGB565(src + 3)) << 16);
+        }
+        dst = (uint8_t *)d;
+    }
+    for (; n; n--, src += 3, dst += 2) {
+        const uint16_t color = RGB565(src);
+        dst[0] = HIBYTE(color);
+        dst[1] = LOBYTE(color);
+    }
+}
+#elif (JD_FORMAT == 1)
+static void jpeg_row_rgb565(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    memcpy(dst, src, n * 2);
+}
+
+static void jpeg_row_rgb565_swap(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    /* TJPGD output is 16-bit aligned */
+    const uint16_t *s = (const uint16_t *)src;
+    if (((uintptr_t)dst & 1) == 0) {
+        if (((uintptr_t)dst & 3) == 2 && n) {
+            *(uint16_t *)dst = swap16(*s++);
+            dst += 2; n--;
+        }
+        if (((uintptr_t)s & 3) == 0) {
+            const uint32_t *s32 = (const uint32_t *)s;
+            uint32_t *d = (uint32_t *)dst;
+            for (; n >= 2; n -= 2) {
+                const uint32_t w = *s32++;
+                *d++ = ((w >> 8) & 0x00FF00FF) | ((w << 8) & 0xFF00FF00);
+            }
+            s = (const uint16_t *)s32;
+            dst = (uint8_t *)d;
+        }
+    }
+    for (; n; n--, dst += 2) {
+        const uint16_t color = *s++;
+        dst[0] = HIBYTE(color);
+        dst[1] = LOBYTE(color);
+    }
+}
+#endif
+
+#if !CONFIG_JD_USE_ROM
+static void jpeg_row_ycbcr_to_gray(uint8_t *dst, const uint8_t *src, unsigned int n)
+{
+    for (; n; n--, src += 3) {
+        *dst++ = src[0];
+    }
+}
+#endif
+
+static jpeg_row_fn_t jpeg_get_row_fn(esp_jpeg_image_format_t format, bool swap_color_bytes)
+{
+    /* BGR888 and big-endian RGB565 are RGB888 and RGB565 with the color bytes swapped */
+    if (format == JPEG_IMAGE_FORMAT_BGR888) {
+        format = JPEG_IMAGE_FORMAT_RGB888;
+        swap_color_bytes = !swap_color_bytes;
+    } else if (format == JPEG_IMAGE_FORMAT_RGB565_BE) {
+        format = JPEG_IMAGE_FORMAT_RGB565;
+        swap_color_bytes = !swap_color_bytes;
+    }
+
+    switch (format) {
+#if !CONFIG_JD_USE_ROM
+    case JPEG_IMAGE_FORMAT_GRAY:
+        return jpeg_row_ycbcr_to_gray;
+#endif
+#if (JD_FORMAT == 0)
+    case JPEG_IMAGE_FORMAT_RGB888:
+        return swap_color_bytes ? jpeg_row_rgb888_swap : jpeg_row_rgb888;
+    case JPEG_IMAGE_FORMAT_RGB565:
+        return swap_color_bytes ? jpeg_row_rgb888_to_rgb565_swap : jpeg_row_rgb888_to_rgb565;
+#elif (JD_FORMAT == 1)
+    case JPEG_IMAGE_FORMAT_RGB565:
+        return swap_color_bytes ? jpeg_row_rgb565_swap : jpeg_row_rgb565;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+static bool jpeg_get_roi(const esp_jpeg_image_cfg_t *cfg, uint16_t *left, uint16_t *top, uint16_t *width,
+                         uint16_t *height)
+{
+    /* width and height are the size of the output image, clip the region to it */
+    *left = cfg->roi.left;
+    *top = cfg->roi.top;
+    if (*left >= *width || *top >= *height) {
+        return false;
+    }
+    *width = cfg->roi.width ? MIN(cfg->roi.width, *width - *left) : *width - *left;
+    *height = cfg->roi.height ? MIN(cfg->roi.height, *height - *top) : *height - *top;
+    return true;
+}
+
 static uint8_t jpeg_get_div_by_scale(esp_jpeg_image_scale_t scale)
 {
     switch (scale) {
@@ -271,13 +797,32 @@ static uint8_t jpeg_get_color_bytes(esp_jpeg_image_format_t format)
     switch (format) {
     /* RGB888 (24-bit/pix) */
     case JPEG_IMAGE_FORMAT_RGB888:
+    case JPEG_IMAGE_FORMAT_BGR888:
         return 3;
     /* RGB565 (16-bit/pix) */
     case JPEG_IMAGE_FORMAT_RGB565:
+    case JPEG_IMAGE_FORMAT_RGB565_BE:
         return 2;
+    /* Grayscale and Y plane of planar YUV (8-bit/pix) */
+    default:
+        return 1;
     }
+}
 
-    return 1;
+static uint32_t jpeg_get_output_len(esp_jpeg_image_format_t format, uint16_t width, uint16_t height)
+{
+    const uint32_t luma_len = (uint32_t)width * height;
+
+    switch (format) {
+    /* Y plane, then U and V planes of half width */
+    case JPEG_IMAGE_FORMAT_YUV422P:
+        return luma_len + 2 * ((width + 1) / 2) * (uint32_t)height;
+    /* Y plane, then U and V planes of half width and half height */
+    case JPEG_IMAGE_FORMAT_YUV420P:
+        return luma_len + 2 * ((width + 1) / 2) * (uint32_t)((height + 1) / 2);
+    default:
+        return luma_len * jpeg_get_color_bytes(format);
+    }
 }
 
 static inline uint16_t ldb_word(const void *ptr)
@@ -285,3 +830,8 @@ static inline uint16_t ldb_word(const void *ptr)
     const uint8_t *p = (const uint8_t *)ptr;
     return ((uint16_t)p[0] << 8) | p[1];
 }
+
+static inline uint16_t swap16(uint16_t v)
+{
+    return (uint16_t)((v << 8) | (v >> 8));
+}
@@ -7,8 +7,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/param.h>
 #include "sdkconfig.h"
 #include "unity.h"
+#include "esp_timer.h"
 
 
 #include "jpeg_decoder.h"
@@ -326,3 +328,639 @@ TEST_CASE("Test JPEG invalid marker 0xFFFF", "[esp_jpeg]")
     free(decoded);
 }
 
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t read;
+    uint8_t *frame;
+    uint16_t next_line;
+    uint16_t bands;
+    uint16_t stop_after;
+} test_stream_t;
+
+static size_t test_stream_read(void *user_data, uint8_t *buf, size_t len)
+{
+    test_stream_t *stream = user_data;
+    /* Hand out short chunks, like a file or socket would */
+    if (len > 100) {
+        len = 100;
+    }
+    if (len > stream->size - stream->read) {
+        len = stream->size - stream->read;
+    }
+    if (buf) {
+        memcpy(buf, stream->data + stream->read, len);
+    }
+    stream->read += len;
+    return len;
+}
+
+static bool test_stream_band(void *user_data, const uint8_t *band, uint16_t top, uint16_t lines, const esp_jpeg_image_output_t *img)
+{
+    test_stream_t *stream = user_data;
+    TEST_ASSERT_EQUAL(stream->next_line, top);
+    TEST_ASSERT_LESS_OR_EQUAL(16, lines);
+    TEST_ASSERT_LESS_OR_EQUAL(img->height, top + lines);
+    memcpy(stream->frame + top * img->width * 3, band, lines * img->width * 3);
+    stream->next_line = top + lines;
+    stream->bands++;
+    return stream->bands != stream->stop_after;
+}
+
+/**
+ * @brief Streaming decode test
+ *
+ * Reads the JPEG image through a callback in short chunks and assembles the bands of lines passed to the band
+ * callback into a frame, which must match the reference image.
+ */
+TEST_CASE("Test JPEG streaming decode", "[esp_jpeg]")
+{
+    test_stream_t stream = {
+        .data = logo_jpg,
+        .size = logo_jpg_len,
+        .frame = malloc(TESTW * TESTH * 3),
+    };
+    TEST_ASSERT_NOT_NULL(stream.frame);
+
+    esp_jpeg_stream_cfg_t stream_cfg = {
+        .read_cb = test_stream_read,
+        .band_cb = test_stream_band,
+        .user_data = &stream,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+        .out_scale = JPEG_IMAGE_SCALE_0,
+    };
+    esp_jpeg_image_output_t outimg;
+    esp_err_t err = esp_jpeg_decode_stream(&stream_cfg, &outimg);
+    TEST_ASSERT_EQUAL(ESP_OK, err);
+
+    TEST_ASSERT_EQUAL(TESTW, outimg.width);
+    TEST_ASSERT_EQUAL(TESTH, outimg.height);
+    TEST_ASSERT_EQUAL(TESTH, stream.next_line);
+    TEST_ASSERT_GREATER_THAN(1, stream.bands);
+
+    const unsigned char *p = stream.frame;
+    const unsigned char *o = logo_rgb888;
+    for (int x = 0; x < outimg.width * outimg.height; x++) {
+        /* The color can be +- 2 */
+        TEST_ASSERT_UINT8_WITHIN(2, o[0], p[0]);
+        TEST_ASSERT_UINT8_WITHIN(2, o[1], p[1]);
+        TEST_ASSERT_UINT8_WITHIN(2, o[2], p[2]);
+
+        p += 3;
+        o += 3;
+    }
+    free(stream.frame);
+}
+
+TEST_CASE("Test JPEG streaming decode: stop and band buffer size", "[esp_jpeg]")
+{
+    test_stream_t stream = {
+        .data = logo_jpg,
+        .size = logo_jpg_len,
+        .frame = malloc(TESTW * TESTH * 3),
+        .stop_after = 2,
+    };
+    TEST_ASSERT_NOT_NULL(stream.frame);
+
+    esp_jpeg_stream_cfg_t stream_cfg = {
+        .read_cb = test_stream_read,
+        .band_cb = test_stream_band,
+        .user_data = &stream,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    esp_jpeg_image_output_t outimg;
+
+    /* The band callback stops decoding */
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, esp_jpeg_decode_stream(&stream_cfg, &outimg));
+    TEST_ASSERT_EQUAL(2, stream.bands);
+
+    /* A user band buffer shorter than one row of MCUs is rejected */
+    uint8_t band[TESTW * 3 * 4];
+    stream_cfg.advanced.band_buffer = band;
+    stream_cfg.advanced.band_buffer_size = sizeof(band);
+    stream.read = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, esp_jpeg_decode_stream(&stream_cfg, &outimg));
+
+    /* Missing callbacks */
+    stream_cfg.band_cb = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_jpeg_decode_stream(&stream_cfg, &outimg));
+
+    free(stream.frame);
+}
+
+/**
+ * @brief Output conversion test
+ *
+ * Decodes the image in every output format and byte order, into buffers of every alignment, and compares the result
+ * with the RGB888 output converted in the test.
+ */
+TEST_CASE("Test JPEG output formats", "[esp_jpeg]")
+{
+    const int pixels = TESTW * TESTH;
+    uint8_t *rgb888 = malloc(pixels * 3);
+    uint8_t *decoded = malloc(pixels * 3 + 4);
+    TEST_ASSERT_NOT_NULL(rgb888);
+    TEST_ASSERT_NOT_NULL(decoded);
+
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)logo_jpg,
+        .indata_size = logo_jpg_len,
+        .outbuf = rgb888,
+        .outbuf_size = pixels * 3,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    esp_jpeg_image_output_t outimg;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+
+    for (int align = 0; align < 4; align++) {
+        uint8_t *out = decoded + align;
+        jpeg_cfg.outbuf = out;
+
+        for (int swap = 0; swap < 2; swap++) {
+            jpeg_cfg.flags.swap_color_bytes = swap;
+
+            jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_RGB888;
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+            for (int i = 0; i < pixels; i++) {
+                for (int b = 0; b < 3; b++) {
+                    TEST_ASSERT_EQUAL(rgb888[i * 3 + (swap ? 2 - b : b)], out[i * 3 + b]);
+                }
+            }
+
+            jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_RGB565;
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+            TEST_ASSERT_EQUAL(pixels * 2, outimg.output_len);
+            for (int i = 0; i < pixels; i++) {
+                const uint8_t *p = &rgb888[i * 3];
+                uint16_t color = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+                TEST_ASSERT_EQUAL(swap ? color >> 8 : color & 0xFF, out[i * 2]);
+                TEST_ASSERT_EQUAL(swap ? color & 0xFF : color >> 8, out[i * 2 + 1]);
+            }
+
+            /* BGR888 and RGB565_BE are the other byte order of RGB888 and RGB565 */
+            jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_BGR888;
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+            for (int i = 0; i < pixels; i++) {
+                for (int b = 0; b < 3; b++) {
+                    TEST_ASSERT_EQUAL(rgb888[i * 3 + (swap ? b : 2 - b)], out[i * 3 + b]);
+                }
+            }
+
+            jpeg_cfg.out_format = JPEG_IMAGE_FORMAT_RGB565_BE;
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+            TEST_ASSERT_EQUAL(pixels * 2, outimg.output_len);
+            for (int i = 0; i < pixels; i++) {
+                const uint8_t *p = &rgb888[i * 3];
+                uint16_t color = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+                TEST_ASSERT_EQUAL(swap ? color & 0xFF : color >> 8, out[i * 2]);
+                TEST_ASSERT_EQUAL(swap ? color >> 8 : color & 0xFF, out[i * 2 + 1]);
+            }
+        }
+    }
+
+    free(decoded);
+    free(rgb888);
+}
+
+/**
+ * @brief In-memory input test
+ *
+ * An image in memory is decoded in place (without copying it to the input buffer of the decoder, unless
+ * JD_FASTDECODE_BASIC is used). The result must match the decoding of the same image read through a callback,
+ * and the input must not be modified.
+ */
+TEST_CASE("Test JPEG in-memory and streamed input", "[esp_jpeg]")
+{
+    const int outsize = 160 * 120 * 3;
+    uint8_t *jpg = malloc(camera_2_jpg_len);
+    uint8_t *decoded = malloc(outsize);
+    test_stream_t stream = {
+        .data = camera_2_jpg,
+        .size = camera_2_jpg_len,
+        .frame = malloc(outsize),
+    };
+    TEST_ASSERT_NOT_NULL(jpg);
+    TEST_ASSERT_NOT_NULL(decoded);
+    TEST_ASSERT_NOT_NULL(stream.frame);
+    memcpy(jpg, camera_2_jpg, camera_2_jpg_len);
+
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = jpg,
+        .indata_size = camera_2_jpg_len,
+        .outbuf = decoded,
+        .outbuf_size = outsize,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    esp_jpeg_image_output_t outimg;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+    TEST_ASSERT_EQUAL_MEMORY(camera_2_jpg, jpg, camera_2_jpg_len);
+
+    esp_jpeg_stream_cfg_t stream_cfg = {
+        .read_cb = test_stream_read,
+        .band_cb = test_stream_band,
+        .user_data = &stream,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode_stream(&stream_cfg, &outimg));
+    TEST_ASSERT_EQUAL_MEMORY(stream.frame, decoded, outsize);
+
+    /* A truncated image fails instead of reading past its end */
+    jpeg_cfg.indata_size = camera_2_jpg_len / 2;
+    TEST_ASSERT_EQUAL(ESP_FAIL, esp_jpeg_decode(&jpeg_cfg, &outimg));
+
+    free(stream.frame);
+    free(decoded);
+    free(jpg);
+}
+
+#if CONFIG_JD_DEFAULT_HUFFMAN
+static esp_err_t test_decode_tasks(const uint8_t *jpg, size_t jpg_len, uint8_t *out, size_t out_len,
+                                   esp_jpeg_image_scale_t scale, uint8_t num_tasks)
+{
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)jpg,
+        .indata_size = jpg_len,
+        .outbuf = out,
+        .outbuf_size = out_len,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+        .out_scale = scale,
+        .advanced = {
+            .num_tasks = num_tasks,
+        },
+    };
+    esp_jpeg_image_output_t outimg;
+    return esp_jpeg_decode(&jpeg_cfg, &outimg);
+}
+
+/**
+ * @brief Parallel decoding test
+ *
+ * The USB camera frame has a restart interval of one MCU row, so it is split between tasks. The result must be
+ * identical to decoding it in one task, for every scale and number of tasks (including more tasks than intervals).
+ * The logo has no restart markers and is decoded in the calling task.
+ */
+TEST_CASE("Test JPEG parallel decode", "[esp_jpeg]")
+{
+    const int outsize = 160 * 120 * 3;
+    uint8_t *serial = malloc(outsize);
+    uint8_t *parallel = malloc(outsize);
+    TEST_ASSERT_NOT_NULL(serial);
+    TEST_ASSERT_NOT_NULL(parallel);
+
+    const uint8_t tasks[] = {2, 3, 4, 16};
+    for (int scale = JPEG_IMAGE_SCALE_0; scale <= JPEG_IMAGE_SCALE_1_8; scale++) {
+        memset(serial, 0, outsize);
+        TEST_ASSERT_EQUAL(ESP_OK, test_decode_tasks(jpeg_no_huffman, jpeg_no_huffman_len, serial, outsize, scale, 1));
+        for (int i = 0; i < sizeof(tasks); i++) {
+            memset(parallel, 0xA5, outsize);
+            TEST_ASSERT_EQUAL(ESP_OK, test_decode_tasks(jpeg_no_huffman, jpeg_no_huffman_len, parallel, outsize, scale, tasks[i]));
+            TEST_ASSERT_EQUAL_MEMORY(serial, parallel, (160 >> scale) * (120 >> scale) * 3);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, test_decode_tasks(logo_jpg, logo_jpg_len, serial, outsize, JPEG_IMAGE_SCALE_0, 1));
+    TEST_ASSERT_EQUAL(ESP_OK, test_decode_tasks(logo_jpg, logo_jpg_len, parallel, outsize, JPEG_IMAGE_SCALE_0, 4));
+    TEST_ASSERT_EQUAL_MEMORY(serial, parallel, TESTW * TESTH * 3);
+
+    /* A restart marker out of sequence is reported as an error, whether it is found before splitting the image
+     * (first marker) or while decoding a part (last marker) */
+    uint8_t *jpg = malloc(jpeg_no_huffman_len);
+    TEST_ASSERT_NOT_NULL(jpg);
+    memcpy(jpg, jpeg_no_huffman, jpeg_no_huffman_len);
+    uint8_t *m = jpg;
+    while (!(m[0] == 0xFF && m[1] == 0xD0)) {
+        m++;
+    }
+    m[1] = 0xD1;
+    TEST_ASSERT_EQUAL(ESP_FAIL, test_decode_tasks(jpg, jpeg_no_huffman_len, parallel, outsize, JPEG_IMAGE_SCALE_0, 4));
+
+    memcpy(jpg, jpeg_no_huffman, jpeg_no_huffman_len);
+    m = jpg + jpeg_no_huffman_len - 2;
+    while (!(m[0] == 0xFF && m[1] == 0xD5)) {
+        m--;
+    }
+    m[1] = 0xD6;
+    TEST_ASSERT_EQUAL(ESP_FAIL, test_decode_tasks(jpg, jpeg_no_huffman_len, parallel, outsize, JPEG_IMAGE_SCALE_0, 4));
+
+    free(jpg);
+    free(parallel);
+    free(serial);
+}
+
+#if !CONFIG_FREERTOS_UNICORE
+/**
+ * @brief Parallel decoding speedup
+ *
+ * With two cores, the USB camera frame (which has restart markers) must decode faster in two tasks than in one.
+ */
+TEST_CASE("Test JPEG parallel decode speedup", "[esp_jpeg]")
+{
+    const int outsize = 160 * 120 * 3;
+    const int iterations = 20;
+    uint8_t *decoded = malloc(outsize);
+    TEST_ASSERT_NOT_NULL(decoded);
+
+    int64_t us[2];
+    for (int num_tasks = 1; num_tasks <= 2; num_tasks++) {
+        int64_t start = esp_timer_get_time();
+        for (int n = 0; n < iterations; n++) {
+            TEST_ASSERT_EQUAL(ESP_OK, test_decode_tasks(jpeg_no_huffman, jpeg_no_huffman_len, decoded, outsize,
+                                                        JPEG_IMAGE_SCALE_0, num_tasks));
+        }
+        us[num_tasks - 1] = esp_timer_get_time() - start;
+    }
+    /* Creating the task and looking for the restart markers take part of what the second core gains */
+    TEST_ASSERT_LESS_THAN(us[0] * 9 / 10, us[1]);
+
+    free(decoded);
+}
+#endif
+#endif
+
+static void test_decode_frame(esp_jpeg_decoder_handle_t decoder, const uint8_t *jpg, size_t jpg_len, uint8_t *out,
+                              uint8_t *ref, size_t out_len)
+{
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)jpg,
+        .indata_size = jpg_len,
+        .outbuf = ref,
+        .outbuf_size = out_len,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    esp_jpeg_image_output_t outimg;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+
+    memset(out, 0, out_len);
+    jpeg_cfg.outbuf = out;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decoder_decode_frame(decoder, &jpeg_cfg, &outimg));
+    TEST_ASSERT_EQUAL_MEMORY(ref, out, outimg.output_len);
+}
+
+/**
+ * @brief Decoder handle test
+ *
+ * A sequence of frames, with the same or different tables as the previous one and after a decoding error, must decode
+ * as with esp_jpeg_decode().
+ */
+TEST_CASE("Test JPEG decoder handle", "[esp_jpeg]")
+{
+    const int outsize = 160 * 120 * 3;
+    uint8_t *decoded = malloc(outsize);
+    uint8_t *ref = malloc(outsize);
+    TEST_ASSERT_NOT_NULL(decoded);
+    TEST_ASSERT_NOT_NULL(ref);
+
+    esp_jpeg_decoder_config_t config = {0};
+    esp_jpeg_decoder_handle_t decoder = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_jpeg_decoder_new(NULL, &decoder));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decoder_new(&config, &decoder));
+
+    test_decode_frame(decoder, camera_2_jpg, camera_2_jpg_len, decoded, ref, outsize);
+    test_decode_frame(decoder, camera_2_jpg, camera_2_jpg_len, decoded, ref, outsize);
+    test_decode_frame(decoder, logo_jpg, logo_jpg_len, decoded, ref, outsize);
+    test_decode_frame(decoder, camera_2_jpg, camera_2_jpg_len, decoded, ref, outsize);
+#if CONFIG_JD_DEFAULT_HUFFMAN
+    test_decode_frame(decoder, jpeg_no_huffman, jpeg_no_huffman_len, decoded, ref, outsize);
+    test_decode_frame(decoder, jpeg_no_huffman, jpeg_no_huffman_len, decoded, ref, outsize);
+#endif
+
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)camera_2_jpg,
+        .indata_size = camera_2_jpg_len / 2,
+        .outbuf = decoded,
+        .outbuf_size = outsize,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+    };
+    esp_jpeg_image_output_t outimg;
+    TEST_ASSERT_EQUAL(ESP_FAIL, esp_jpeg_decoder_decode_frame(decoder, &jpeg_cfg, &outimg));
+    test_decode_frame(decoder, camera_2_jpg, camera_2_jpg_len, decoded, ref, outsize);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decoder_del(decoder));
+
+    /* User working buffer */
+    config.working_buffer = malloc(8192);
+    config.working_buffer_size = 8192;
+    TEST_ASSERT_NOT_NULL(config.working_buffer);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decoder_new(&config, &decoder));
+    test_decode_frame(decoder, logo_jpg, logo_jpg_len, decoded, ref, outsize);
+    test_decode_frame(decoder, logo_jpg, logo_jpg_len, decoded, ref, outsize);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decoder_del(decoder));
+    free(config.working_buffer);
+
+    free(ref);
+    free(decoded);
+}
+
+static void test_roi(const uint8_t *jpg, size_t jpg_len, esp_jpeg_image_scale_t scale, uint8_t num_tasks)
+{
+    const int outsize = 160 * 120 * 3;
+    uint8_t *full = malloc(outsize);
+    uint8_t *roi = malloc(outsize);
+    TEST_ASSERT_NOT_NULL(full);
+    TEST_ASSERT_NOT_NULL(roi);
+
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)jpg,
+        .indata_size = jpg_len,
+        .outbuf = full,
+        .outbuf_size = outsize,
+        .out_format = JPEG_IMAGE_FORMAT_RGB888,
+        .out_scale = scale,
+    };
+    esp_jpeg_image_output_t outimg, fullimg;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &fullimg));
+
+    /* Aligned and unaligned to MCUs, clipped at the right and bottom edges */
+    const struct {
+        uint16_t left, top, width, height;
+    } rois[] = {
+        {0, 0, 16, 8}, {5, 3, 1, 1}, {17, 9, 30, 21}, {100 >> scale, 60 >> scale, 0, 0}, {150 >> scale, 110 >> scale, 40, 40},
+        {0, 119 >> scale, 160, 1}, {159 >> scale, 0, 1, 120}, {33 >> scale, 7, 24, 0}, {9, 50 >> scale, 0, 17},
+    };
+    for (int i = 0; i < sizeof(rois) / sizeof(rois[0]); i++) {
+        if (rois[i].left >= fullimg.width || rois[i].top >= fullimg.height) {
+            continue;
+        }
+        jpeg_cfg.outbuf = roi;
+        jpeg_cfg.roi.left = rois[i].left;
+        jpeg_cfg.roi.top = rois[i].top;
+        jpeg_cfg.roi.width = rois[i].width;
+        jpeg_cfg.roi.height = rois[i].height;
+        jpeg_cfg.advanced.num_tasks = num_tasks;
+        memset(roi, 0xA5, outsize);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+
+        const uint16_t width = rois[i].width ? MIN(rois[i].width, fullimg.width - rois[i].left) : fullimg.width - rois[i].left;
+        const uint16_t height = rois[i].height ? MIN(rois[i].height, fullimg.height - rois[i].top) : fullimg.height - rois[i].top;
+        TEST_ASSERT_EQUAL(width, outimg.width);
+        TEST_ASSERT_EQUAL(height, outimg.height);
+        TEST_ASSERT_EQUAL(width * height * 3, outimg.output_len);
+        for (int y = 0; y < height; y++) {
+            TEST_ASSERT_EQUAL_MEMORY(full + ((rois[i].top + y) * fullimg.width + rois[i].left) * 3, roi + y * width * 3, width * 3);
+        }
+        TEST_ASSERT_EQUAL_HEX8(0xA5, roi[outimg.output_len]);
+
+        esp_jpeg_image_output_t info;
+        TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_get_image_info(&jpeg_cfg, &info));
+        TEST_ASSERT_EQUAL(outimg.output_len, info.output_len);
+    }
+
+    /* Region outside of the image */
+    jpeg_cfg.roi.left = fullimg.width;
+    jpeg_cfg.roi.top = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_jpeg_decode(&jpeg_cfg, &outimg));
+
+    free(roi);
+    free(full);
+}
+
+/**
+ * @brief Region of interest test
+ *
+ * Regions decoded at every scale must be the same as the corresponding part of the whole image.
+ */
+TEST_CASE("Test JPEG region of interest", "[esp_jpeg]")
+{
+    for (int scale = JPEG_IMAGE_SCALE_0; scale <= JPEG_IMAGE_SCALE_1_8; scale++) {
+        test_roi(camera_2_jpg, camera_2_jpg_len, scale, 0);
+#if CONFIG_JD_DEFAULT_HUFFMAN
+        test_roi(jpeg_no_huffman, jpeg_no_huffman_len, scale, 3);
+#endif
+    }
+}
+
+/**
+ * @brief Thumbnail and region of interest decoding time
+ *
+ * A 1/8 thumbnail only computes the DC coefficients, and a region skips the transform of the MCUs around it and stops
+ * after its last line: each takes less than half the time of decoding the whole image.
+ */
+TEST_CASE("Test JPEG thumbnail and region of interest decoding time", "[esp_jpeg]")
+{
+    const int outsize = 160 * 120 * 3;
+    const int iterations = 20;
+    uint8_t *decoded = malloc(outsize);
+    TEST_ASSERT_NOT_NULL(decoded);
+
+    const struct {
+        esp_jpeg_image_scale_t scale;
+        uint16_t left, top, width, height;
+    } modes[] = {
+        {JPEG_IMAGE_SCALE_0, 0, 0, 0, 0},         /* Whole image */
+        {JPEG_IMAGE_SCALE_1_8, 0, 0, 0, 0},       /* 1/8 thumbnail */
+        {JPEG_IMAGE_SCALE_0, 64, 0, 32, 32},      /* 32x32 region at the top */
+        {JPEG_IMAGE_SCALE_0, 64, 88, 32, 32},     /* 32x32 region at the bottom */
+    };
+    int64_t us[sizeof(modes) / sizeof(modes[0])];
+    for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        esp_jpeg_image_cfg_t jpeg_cfg = {
+            .indata = (uint8_t *)camera_2_jpg,
+            .indata_size = camera_2_jpg_len,
+            .outbuf = decoded,
+            .outbuf_size = outsize,
+            .out_format = JPEG_IMAGE_FORMAT_RGB888,
+            .out_scale = modes[i].scale,
+            .roi = {
+                .left = modes[i].left,
+                .top = modes[i].top,
+                .width = modes[i].width,
+                .height = modes[i].height,
+            },
+        };
+        esp_jpeg_image_output_t outimg;
+        int64_t start = esp_timer_get_time();
+        for (int n = 0; n < iterations; n++) {
+            TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        }
+        us[i] = esp_timer_get_time() - start;
+    }
+    for (int i = 1; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        TEST_ASSERT_LESS_THAN(us[0] / 2, us[i]);
+    }
+
+    free(decoded);
+}
+
+#if !CONFIG_JD_USE_ROM
+/**
+ * @brief Grayscale and YUV output formats test
+ *
+ * The Y plane must be the same in every format, the 4:2:0 chroma planes must be the even lines of the 4:2:2 ones,
+ * and the pixels converted back to RGB must match the RGB888 output.
+ */
+TEST_CASE("Test JPEG grayscale and YUV output formats", "[esp_jpeg]")
+{
+    const int width = 160, height = 120, pixels = width * height;
+    const int cw = (width + 1) / 2, chroma = cw * height;
+    uint8_t *rgb888 = malloc(pixels * 3);
+    uint8_t *gray = malloc(pixels);
+    uint8_t *yuv422 = malloc(pixels + 2 * chroma);
+    uint8_t *yuv420 = malloc(pixels + chroma);
+    TEST_ASSERT_NOT_NULL(rgb888);
+    TEST_ASSERT_NOT_NULL(gray);
+    TEST_ASSERT_NOT_NULL(yuv422);
+    TEST_ASSERT_NOT_NULL(yuv420);
+
+    const struct {
+        esp_jpeg_image_format_t format;
+        uint8_t *outbuf;
+        uint32_t output_len;
+    } formats[] = {
+        {JPEG_IMAGE_FORMAT_RGB888, rgb888, pixels * 3},
+        {JPEG_IMAGE_FORMAT_GRAY, gray, pixels},
+        {JPEG_IMAGE_FORMAT_YUV422P, yuv422, pixels + 2 * chroma},
+        {JPEG_IMAGE_FORMAT_YUV420P, yuv420, pixels + chroma},
+    };
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = (uint8_t *)camera_2_jpg,
+        .indata_size = camera_2_jpg_len,
+    };
+    esp_jpeg_image_output_t outimg;
+    for (int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        jpeg_cfg.out_format = formats[i].format;
+        jpeg_cfg.outbuf = formats[i].outbuf;
+        jpeg_cfg.outbuf_size = formats[i].output_len;
+        TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_decode(&jpeg_cfg, &outimg));
+        TEST_ASSERT_EQUAL(formats[i].output_len, outimg.output_len);
+
+        esp_jpeg_image_output_t info;
+        TEST_ASSERT_EQUAL(ESP_OK, esp_jpeg_get_image_info(&jpeg_cfg, &info));
+        TEST_ASSERT_EQUAL(formats[i].output_len, info.output_len);
+    }
+
+    TEST_ASSERT_EQUAL_MEMORY(gray, yuv422, pixels);
+    TEST_ASSERT_EQUAL_MEMORY(gray, yuv420, pixels);
+    for (int y = 0; y < height; y += 2) {
+        TEST_ASSERT_EQUAL_MEMORY(yuv422 + pixels + y * cw, yuv420 + pixels + y / 2 * cw, cw);
+        TEST_ASSERT_EQUAL_MEMORY(yuv422 + pixels + chroma + y * cw, yuv420 + pixels + chroma / 2 + y / 2 * cw, cw);
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x += 2) {
+            const int yy = gray[y * width + x];
+            if (yy == 0 || yy == 255) {
+                continue;   /* RGB is converted from the Y value before clipping */
+            }
+            const int cb = yuv422[pixels + y * cw + x / 2] - 128;
+            const int cr = yuv422[pixels + chroma + y * cw + x / 2] - 128;
+            const int rgb[3] = {yy + 1.402 * cr, yy - 0.344 * cb - 0.714 * cr, yy + 1.772 * cb};
+            for (int c = 0; c < 3; c++) {
+                TEST_ASSERT_INT_WITHIN(2, MAX(0, MIN(255, rgb[c])), rgb888[(y * width + x) * 3 + c]);
+            }
+        }
+    }
+
+    /* Planar formats need the whole frame */
+    esp_jpeg_stream_cfg_t stream_cfg = {
+        .read_cb = test_stream_read,
+        .band_cb = test_stream_band,
+        .out_format = JPEG_IMAGE_FORMAT_YUV420P,
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, esp_jpeg_decode_stream(&stream_cfg, &outimg));
+
+    free(yuv420);
+    free(yuv422);
+    free(gray);
+    free(rgb888);
+}
+#endif
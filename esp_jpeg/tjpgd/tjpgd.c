@@ -154,6 +154,68 @@ static void *alloc_pool (   /* Pointer to allocated memory block (NULL:no memory
 
 
 
+#if JD_FASTDECODE == 2
+/*-----------------------------------------------------------------------*/
+/* Create fast huffman decode table for the short codes                  */
+/*-----------------------------------------------------------------------*/
+
+static JRESULT create_huffman_lut ( /* 0:OK, !0:Failed */
+    JDEC *jd,                   /* Pointer to the decompressor object with the huffman table loaded */
+    unsigned int num,           /* Table number */
+    unsigned int cls,           /* Table class */
+    const JDEC *prev            /* Object of the previous image holding the same table (0:create the table) */
+)
+{
+    unsigned int i, j, b, span, td, ti;
+    const uint8_t *pb = jd->huffbits[num][cls], *pd = jd->huffdata[num][cls];
+    const uint16_t *ph = jd->huffcode[num][cls];
+    uint16_t *tbl_ac = 0;
+    uint8_t *tbl_dc = 0;
+
+
+    if (cls) {
+        tbl_ac = alloc_pool(jd, HUFF_LEN * sizeof (uint16_t));  /* LUT for AC elements */
+        if (!tbl_ac) {
+            return JDR_MEM1;    /* Err: not enough memory */
+        }
+        jd->hufflut_ac[num] = tbl_ac;
+        if (prev && prev->hufflut_ac[num] == tbl_ac) {          /* The LUT of the previous image is still there */
+            jd->longofs[num][cls] = prev->longofs[num][cls];
+            return JDR_OK;
+        }
+        memset(tbl_ac, 0xFF, HUFF_LEN * sizeof (uint16_t));     /* Default value (0xFFFF: may be long code) */
+    } else {
+        tbl_dc = alloc_pool(jd, HUFF_LEN * sizeof (uint8_t));   /* LUT for AC elements */
+        if (!tbl_dc) {
+            return JDR_MEM1;    /* Err: not enough memory */
+        }
+        jd->hufflut_dc[num] = tbl_dc;
+        if (prev && prev->hufflut_dc[num] == tbl_dc) {
+            jd->longofs[num][cls] = prev->longofs[num][cls];
+            return JDR_OK;
+        }
+        memset(tbl_dc, 0xFF, HUFF_LEN * sizeof (uint8_t));      /* Default value (0xFF: may be long code) */
+    }
+    for (i = b = 0; b < HUFF_BIT; b++) {    /* Create LUT */
+        for (j = pb[b]; j; j--) {
+            ti = ph[i] << (HUFF_BIT - 1 - b) & HUFF_MASK;   /* Index of input pattern for the code */
+            if (cls) {
+                td = pd[i++] | ((b + 1) << 8);  /* b15..b8: code length, b7..b0: zero run and data length */
+                for (span = 1 << (HUFF_BIT - 1 - b); span; span--, tbl_ac[ti++] = (uint16_t)td) ;
+            } else {
+                td = pd[i++] | ((b + 1) << 4);  /* b7..b4: code length, b3..b0: data length */
+                for (span = 1 << (HUFF_BIT - 1 - b); span; span--, tbl_dc[ti++] = (uint8_t)td) ;
+            }
+        }
+    }
+    jd->longofs[num][cls] = i;  /* Code table offset for long code */
+
+    return JDR_OK;
+}
+#endif
+
+
+
 #if JD_DEFAULT_HUFFMAN
 /*-----------------------------------------------------------------------*/
 /* Load default Huffman table                                            */
@@ -164,12 +226,15 @@ extern unsigned char esp_jpeg_chrom_dc_num_bits[], esp_jpeg_chrom_dc_values[];
 extern unsigned char esp_jpeg_lum_ac_num_bits[], esp_jpeg_lum_ac_values[];
 extern unsigned char esp_jpeg_chrom_ac_num_bits[], esp_jpeg_chrom_ac_values[];
 extern unsigned esp_jpeg_lum_dc_codes_total, esp_jpeg_lum_ac_codes_total, esp_jpeg_chrom_dc_codes_total, esp_jpeg_chrom_ac_codes_total;
-JRESULT jd_load_default_huffman (JDEC *jd)
+JRESULT jd_load_default_huffman (JDEC *jd, const JDEC *prev)
 {
     // Variable declarations to keep a similar structure to create_huffman_tbl()
-    unsigned int i, j, b;
+    unsigned int i, j, b, reuse;
     uint8_t *pb;
     uint16_t hc, *ph;
+#if JD_FASTDECODE == 2
+    JRESULT rc;
+#endif
 
     // Group default tables for Y/CbCr channels and DC/AC components to access them in loops
     // These arrays store predefined Huffman bit lengths and values for JPEG decoding
@@ -208,16 +273,28 @@ JRESULT jd_load_default_huffman (JDEC *jd)
                 return JDR_MEM1;    // Error: Memory allocation failed
             }
             jd->huffcode[ycbcr][dcac] = ph; // Store allocated memory address for code table
-            hc = 0; // Initialize Huffman code
 
-            // Generate Huffman codes based on the bit lengths in pb
-            for (j = i = 0; i < 16; i++) { // Iterate over 16 possible code lengths
-                b = pb[i]; // Number of codes with length (i+1) bits
-                while (b--) {
-                    ph[j++] = hc++; // Assign code and increment index
+            // The previous image in the same memory pool left the codes (and LUT) of the default table here
+            reuse = prev && prev->huffbits[ycbcr][dcac] == pb && prev->huffcode[ycbcr][dcac] == ph;
+            if (!reuse) {
+                hc = 0; // Initialize Huffman code
+
+                // Generate Huffman codes based on the bit lengths in pb
+                for (j = i = 0; i < 16; i++) { // Iterate over 16 possible code lengths
+                    b = pb[i]; // Number of codes with length (i+1) bits
+                    while (b--) {
+                        ph[j++] = hc++; // Assign code and increment index
+                    }
+                    hc <<= 1; // Left shift code to increase bit length
                 }
-                hc <<= 1; // Left shift code to increase bit length
             }
+#if JD_FASTDECODE == 2
+            // Create the fast decode table, as for the tables loaded from the image
+            rc = create_huffman_lut(jd, ycbcr, dcac, reuse ? prev : 0);
+            if (rc) {
+                return rc;
+            }
+#endif
         }
     }
     return JDR_OK; // Return success status
@@ -273,13 +350,17 @@ static JRESULT create_qt_tbl (  /* 0:OK, !0:Failed */
 static JRESULT create_huffman_tbl ( /* 0:OK, !0:Failed */
     JDEC *jd,                   /* Pointer to the decompressor object */
     const uint8_t *data,        /* Pointer to the packed huffman tables */
-    size_t ndata                /* Size of input data */
+    size_t ndata,               /* Size of input data */
+    const JDEC *prev            /* Object of the previous image in the same memory pool (0:none) */
 )
 {
-    unsigned int i, j, b, cls, num;
+    unsigned int i, j, b, cls, num, reuse;
     size_t np;
     uint8_t d, *pb, *pd;
     uint16_t hc, *ph;
+#if JD_FASTDECODE == 2
+    JRESULT rc;
+#endif
 
 
     while (ndata) { /* Process all tables in the segment */
@@ -296,6 +377,8 @@ static JRESULT create_huffman_tbl ( /* 0:OK, !0:Failed */
         if (!pb) {
             return JDR_MEM1;    /* Err: not enough memory */
         }
+        /* The tables built for the previous image can be kept if they were built at the same place from the same data */
+        reuse = prev && prev->huffbits[num][cls] == pb && !memcmp(pb, data, 16);
         jd->huffbits[num][cls] = pb;
         for (np = i = 0; i < 16; i++) {     /* Load number of patterns for 1 to 16-bit code */
             np += (pb[i] = *data++);        /* Get sum of code words for each code */
@@ -304,14 +387,17 @@ static JRESULT create_huffman_tbl ( /* 0:OK, !0:Failed */
         if (!ph) {
             return JDR_MEM1;    /* Err: not enough memory */
         }
+        reuse = reuse && prev->huffcode[num][cls] == ph;
         jd->huffcode[num][cls] = ph;
-        hc = 0;
-        for (j = i = 0; i < 16; i++) {      /* Re-build huffman code word table */
-            b = pb[i];
-            while (b--) {
-                ph[j++] = hc++;
+        if (!reuse) {
+            hc = 0;
+            for (j = i = 0; i < 16; i++) {  /* Re-build huffman code word table */
+                b = pb[i];
+                while (b--) {
+                    ph[j++] = hc++;
+                }
+                hc <<= 1;
             }
-            hc <<= 1;
         }
 
         if (ndata < np) {
@@ -322,6 +408,7 @@ static JRESULT create_huffman_tbl ( /* 0:OK, !0:Failed */
         if (!pd) {
             return JDR_MEM1;    /* Err: not enough memory */
         }
+        reuse = reuse && prev->huffdata[num][cls] == pd && !memcmp(pd, data, np);
         jd->huffdata[num][cls] = pd;
         for (i = 0; i < np; i++) {          /* Load decoded data corresponds to each code word */
             d = *data++;
@@ -331,39 +418,9 @@ static JRESULT create_huffman_tbl ( /* 0:OK, !0:Failed */
             pd[i] = d;
         }
 #if JD_FASTDECODE == 2
-        { /* Create fast huffman decode table */
-            unsigned int span, td, ti;
-            uint16_t *tbl_ac = 0;
-            uint8_t *tbl_dc = 0;
-
-            if (cls) {
-                tbl_ac = alloc_pool(jd, HUFF_LEN * sizeof (uint16_t));  /* LUT for AC elements */
-                if (!tbl_ac) {
-                    return JDR_MEM1;    /* Err: not enough memory */
-                }
-                jd->hufflut_ac[num] = tbl_ac;
-                memset(tbl_ac, 0xFF, HUFF_LEN * sizeof (uint16_t));     /* Default value (0xFFFF: may be long code) */
-            } else {
-                tbl_dc = alloc_pool(jd, HUFF_LEN * sizeof (uint8_t));   /* LUT for AC elements */
-                if (!tbl_dc) {
-                    return JDR_MEM1;    /* Err: not enough memory */
-                }
-                jd->hufflut_dc[num] = tbl_dc;
-                memset(tbl_dc, 0xFF, HUFF_LEN * sizeof (uint8_t));      /* Default value (0xFF: may be long code) */
-            }
-            for (i = b = 0; b < HUFF_BIT; b++) {    /* Create LUT */
-                for (j = pb[b]; j; j--) {
-                    ti = ph[i] << (HUFF_BIT - 1 - b) & HUFF_MASK;   /* Index of input pattern for the code */
-                    if (cls) {
-                        td = pd[i++] | ((b + 1) << 8);  /* b15..b8: code length, b7..b0: zero run and data length */
-                        for (span = 1 << (HUFF_BIT - 1 - b); span; span--, tbl_ac[ti++] = (uint16_t)td) ;
-                    } else {
-                        td = pd[i++] | ((b + 1) << 4);  /* b7..b4: code length, b3..b0: data length */
-                        for (span = 1 << (HUFF_BIT - 1 - b); span; span--, tbl_dc[ti++] = (uint8_t)td) ;
-                    }
-                }
-            }
-            jd->longofs[num][cls] = i;  /* Code table offset for long code */
+        rc = create_huffman_lut(jd, num, cls, reuse ? prev : 0);   /* Create fast huffman decode table */
+        if (rc) {
+            return rc;
         }
 #endif
     }
@@ -823,18 +880,20 @@ static void block_idct (
 /*-----------------------------------------------------------------------*/
 
 static JRESULT mcu_load (
-    JDEC *jd        /* Pointer to the decompressor object */
+    JDEC *jd,       /* Pointer to the decompressor object */
+    int out         /* 0:Only skip the MCU in the input stream (it is not output) */
 )
 {
     int32_t *tmp = (int32_t *)jd->workbuf;  /* Block working buffer for de-quantize and IDCT */
     int d, e;
-    unsigned int blk, nby, i, bc, z, id, cmp;
+    unsigned int blk, nby, i, bc, z, id, cmp, dconly;
     jd_yuv_t *bp;
     const int32_t *dqf;
 
 
     nby = jd->msx * jd->msy;    /* Number of Y blocks (1, 2 or 4) */
     bp = jd->mcubuf;            /* Pointer to the first block of MCU */
+    dconly = !out || (JD_USE_SCALE && jd->scale == 3);  /* AC elements are only skipped if the block is not output or its DC value is the 1/8 scaled pixel */
 
     for (blk = 0; blk < nby + 2; blk++) {   /* Get nby Y blocks and two C blocks */
         cmp = (blk < nby) ? 0 : blk - nby + 1;  /* Component number 0:Y, 1:Cb, 2:Cr */
@@ -868,7 +927,9 @@ static JRESULT mcu_load (
             tmp[0] = d * dqf[0] >> 8;               /* De-quantize, apply scale factor of Arai algorithm and descale 8 bits */
 
             /* Extract following 63 AC elements from input stream */
-            memset(&tmp[1], 0, 63 * sizeof (int32_t));  /* Initialize all AC elements */
+            if (!dconly) {
+                memset(&tmp[1], 0, 63 * sizeof (int32_t));  /* Initialize all AC elements */
+            }
             z = 1;      /* Top of the AC elements (in zigzag-order) */
             do {
                 d = huffext(jd, id, 1);             /* Extract a huffman coded value (zero runs and bit length) */
@@ -888,17 +949,21 @@ static JRESULT mcu_load (
                     if (d < 0) {
                         return (JRESULT)(0 - d);    /* Err: input device */
                     }
-                    bc = 1 << (bc - 1);             /* MSB position */
-                    if (!(d & bc)) {
-                        d -= (bc << 1) - 1;    /* Restore negative value if needed */
+                    if (!dconly) {
+                        bc = 1 << (bc - 1);         /* MSB position */
+                        if (!(d & bc)) {
+                            d -= (bc << 1) - 1;    /* Restore negative value if needed */
+                        }
+                        i = Zig[z];                 /* Get raster-order index */
+                        tmp[i] = d * dqf[i] >> 8;   /* De-quantize, apply scale factor of Arai algorithm and descale 8 bits */
                     }
-                    i = Zig[z];                     /* Get raster-order index */
-                    tmp[i] = d * dqf[i] >> 8;       /* De-quantize, apply scale factor of Arai algorithm and descale 8 bits */
                 }
             } while (++z < 64);     /* Next AC element */
 
-            if (JD_FORMAT != 2 || !cmp) {   /* C components may not be processed if in grayscale output */
-                if (z == 1 || (JD_USE_SCALE && jd->scale == 3)) {   /* If no AC element or scale ratio is 1/8, IDCT can be omitted and the block is filled with DC value */
+            if (out && (JD_FORMAT != 2 || !cmp)) {  /* C components may not be processed if in grayscale output */
+                if (dconly) {                       /* Scale ratio is 1/8: only the left-top element of the block is used */
+                    bp[0] = (jd_yuv_t)((*tmp / 256) + 128);
+                } else if (z == 1) {                /* If no AC element, IDCT can be omitted and the block is filled with DC value */
                     d = (jd_yuv_t)((*tmp / 256) + 128);
                     if (JD_FASTDECODE >= 1) {
                         for (i = 0; i < 64; bp[i++] = d) ;
@@ -983,9 +1048,15 @@ static JRESULT mcu_output (
                         pc++;                       /* Step forward chroma pointer every pixel */
                     }
                     yy = *py++;         /* Get Y component */
-                    *pix++ = /*R*/ BYTECLIP(yy + ((int)(1.402 * CVACC) * cr) / CVACC);
-                    *pix++ = /*G*/ BYTECLIP(yy - ((int)(0.344 * CVACC) * cb + (int)(0.714 * CVACC) * cr) / CVACC);
-                    *pix++ = /*B*/ BYTECLIP(yy + ((int)(1.772 * CVACC) * cb) / CVACC);
+                    if (jd->ycbcr) {    /* YCbCr output (Espressif extension) */
+                        *pix++ = BYTECLIP(yy);
+                        *pix++ = BYTECLIP(cb + 128);
+                        *pix++ = BYTECLIP(cr + 128);
+                    } else {
+                        *pix++ = /*R*/ BYTECLIP(yy + ((int)(1.402 * CVACC) * cr) / CVACC);
+                        *pix++ = /*G*/ BYTECLIP(yy - ((int)(0.344 * CVACC) * cb + (int)(0.714 * CVACC) * cr) / CVACC);
+                        *pix++ = /*B*/ BYTECLIP(yy + ((int)(1.772 * CVACC) * cb) / CVACC);
+                    }
                 }
             }
         } else {    /* Monochrome output (build a grayscale MCU from Y component) */
@@ -1055,7 +1126,11 @@ static JRESULT mcu_output (
             for (ix = 0; ix < mx; ix += 8) {
                 yy = *py;   /* Get Y component */
                 py += 64;
-                if (JD_FORMAT != 2) {
+                if (JD_FORMAT != 2 && jd->ycbcr) {  /* YCbCr output (Espressif extension) */
+                    *pix++ = BYTECLIP(yy);
+                    *pix++ = BYTECLIP(cb + 128);
+                    *pix++ = BYTECLIP(cr + 128);
+                } else if (JD_FORMAT != 2) {
                     *pix++ = /*R*/ BYTECLIP(yy + ((int)(1.402 * CVACC) * cr / CVACC));
                     *pix++ = /*G*/ BYTECLIP(yy - ((int)(0.344 * CVACC) * cb + (int)(0.714 * CVACC) * cr) / CVACC);
                     *pix++ = /*B*/ BYTECLIP(yy + ((int)(1.772 * CVACC) * cb / CVACC));
@@ -1086,7 +1161,7 @@ static JRESULT mcu_output (
     }
 
     /* Convert RGB888 to RGB565 if needed */
-    if (JD_FORMAT == 1) {
+    if (JD_FORMAT == 1 && !jd->ycbcr) {
         uint8_t *s = (uint8_t *)jd->workbuf;
         uint16_t w, *d = (uint16_t *)s;
         unsigned int n = rx * ry;
@@ -1106,6 +1181,38 @@ static JRESULT mcu_output (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Allocate working buffers for MCU and pixel output                     */
+/*-----------------------------------------------------------------------*/
+
+static JRESULT alloc_mcu_buf (
+    JDEC *jd        /* Pointer to the decompressor object */
+)
+{
+    unsigned int n;
+    size_t len;
+
+
+    n = jd->msy * jd->msx;                      /* Number of Y blocks in the MCU */
+    len = n * 64 * 2 + 64;                      /* Allocate buffer for IDCT and RGB output */
+    if (len < 256) {
+        len = 256;    /* but at least 256 byte is required for IDCT */
+    }
+    jd->workbuf = alloc_pool(jd, len);          /* and it may occupy a part of following MCU working buffer for RGB output */
+    if (!jd->workbuf) {
+        return JDR_MEM1;    /* Err: not enough memory */
+    }
+    jd->mcubuf = alloc_pool(jd, (n + 2) * 64 * sizeof (jd_yuv_t));  /* Allocate MCU working buffer */
+    if (!jd->mcubuf) {
+        return JDR_MEM1;    /* Err: not enough memory */
+    }
+
+    return JDR_OK;
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Analyze the JPEG image and Initialize decompressor object             */
 /*-----------------------------------------------------------------------*/
@@ -1113,12 +1220,13 @@ static JRESULT mcu_output (
 #define LDB_WORD(ptr)       (uint16_t)(((uint16_t)*((uint8_t*)(ptr))<<8)|(uint16_t)*(uint8_t*)((ptr)+1))
 
 
-JRESULT jd_prepare (
+static JRESULT prepare (
     JDEC *jd,               /* Blank decompressor object */
     size_t (*infunc)(JDEC *, uint8_t *, size_t), /* JPEG stream input function */
     void *pool,             /* Working buffer for the decompression session */
     size_t sz_pool,         /* Size of working buffer */
-    void *dev               /* I/O device identifier for the session */
+    void *dev,              /* I/O device identifier for the session */
+    const JDEC *prev        /* Object of the previous image in the same memory pool (0:none) */
 )
 {
     uint8_t *seg, b;
@@ -1235,7 +1343,7 @@ JRESULT jd_prepare (
                 return JDR_INP;    /* Load segment data */
             }
 
-            rc = create_huffman_tbl(jd, seg, len);  /* Create huffman tables */
+            rc = create_huffman_tbl(jd, seg, len, prev);    /* Create huffman tables */
             if (rc) {
                 return rc;
             }
@@ -1279,7 +1387,10 @@ JRESULT jd_prepare (
                 n = i ? 1 : 0;                          /* Component class */
                 if (!jd->huffbits[n][0] || !jd->huffbits[n][1]) {   /* Check huffman table for this component */
 #if JD_DEFAULT_HUFFMAN
-                    jd_load_default_huffman(jd); // Always returns OK
+                    rc = jd_load_default_huffman(jd, prev);
+                    if (rc) {
+                        return rc;
+                    }
 #else
                     return JDR_FMT1;                    /* Err: Nnot loaded */
 #endif
@@ -1294,17 +1405,9 @@ JRESULT jd_prepare (
             if (!n) {
                 return JDR_FMT1;    /* Err: SOF0 has not been loaded */
             }
-            len = n * 64 * 2 + 64;                      /* Allocate buffer for IDCT and RGB output */
-            if (len < 256) {
-                len = 256;    /* but at least 256 byte is required for IDCT */
-            }
-            jd->workbuf = alloc_pool(jd, len);          /* and it may occupy a part of following MCU working buffer for RGB output */
-            if (!jd->workbuf) {
-                return JDR_MEM1;    /* Err: not enough memory */
-            }
-            jd->mcubuf = alloc_pool(jd, (n + 2) * 64 * sizeof (jd_yuv_t));  /* Allocate MCU working buffer */
-            if (!jd->mcubuf) {
-                return JDR_MEM1;    /* Err: not enough memory */
+            rc = alloc_mcu_buf(jd);
+            if (rc) {
+                return rc;
             }
 
             /* Align stream read offset to JD_SZBUF */
@@ -1313,6 +1416,9 @@ JRESULT jd_prepare (
             }
             jd->dptr = seg + ofs - (JD_FASTDECODE ? 0 : 1);
 
+            jd->roi.left = 0; jd->roi.right = jd->width - 1;   /* Output the whole image */
+            jd->roi.top = 0; jd->roi.bottom = jd->height - 1;
+
             return JDR_OK;      /* Initialization succeeded. Ready to decompress the JPEG image. */
 
         case 0xC1:  /* SOF1 */
@@ -1342,6 +1448,67 @@ JRESULT jd_prepare (
 
 
 
+JRESULT jd_prepare (
+    JDEC *jd,               /* Blank decompressor object */
+    size_t (*infunc)(JDEC *, uint8_t *, size_t), /* JPEG stream input function */
+    void *pool,             /* Working buffer for the decompression session */
+    size_t sz_pool,         /* Size of working buffer */
+    void *dev               /* I/O device identifier for the session */
+)
+{
+    return prepare(jd, infunc, pool, sz_pool, dev, 0);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Initialize decompressor object for the next image of a sequence,      */
+/* keeping the huffman tables that did not change (Espressif extension)  */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_prepare_next (
+    JDEC *jd,               /* Object successfully prepared for the previous image with the same pool */
+    size_t (*infunc)(JDEC *, uint8_t *, size_t), /* JPEG stream input function */
+    void *pool,             /* Working buffer for the decompression session, not modified since the previous image */
+    size_t sz_pool,         /* Size of working buffer */
+    void *dev               /* I/O device identifier for the session */
+)
+{
+    JDEC prev = *jd;
+
+
+    return prepare(jd, infunc, pool, sz_pool, dev, prev.inbuf == pool ? &prev : 0);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read the rest of the stream in place (Espressif extension)            */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_input_mem (
+    JDEC *jd,               /* Decompression object initialized by jd_prepare() */
+    const uint8_t *data,    /* Stream data following the last byte returned by the input function */
+    size_t ndata            /* Number of bytes available at data */
+)
+{
+#if JD_FASTDECODE >= 1
+    /* The bytes left in the input buffer are the ones just before data in the stream,
+       so the bit reader can continue from memory and only calls the input function once it is exhausted */
+    jd->dptr = (uint8_t *)data - jd->dctr;
+    jd->dctr += ndata;
+    return JDR_OK;
+#else
+    (void)jd; (void)data; (void)ndata;
+    return JDR_PAR;     /* The basic bit reader un-stuffs 0xFF bytes in the input buffer */
+#endif
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Start to decompress the JPEG picture                                  */
 /*-----------------------------------------------------------------------*/
@@ -1352,7 +1519,25 @@ JRESULT jd_decomp (
     uint8_t scale                           /* Output de-scaling factor (0 to 3) */
 )
 {
-    unsigned int x, y, mx, my;
+    return jd_decomp_rst(jd, outfunc, scale, 0, (unsigned int) -1);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Decompress a range of restart intervals (Espressif extension)         */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_decomp_rst (
+    JDEC *jd,                               /* Initialized decompression object, positioned at the start of interval first */
+    int (*outfunc)(JDEC *, void *, JRECT *), /* RGB output function */
+    uint8_t scale,                          /* Output de-scaling factor (0 to 3) */
+    unsigned int first,                     /* First restart interval to decompress (0 if no restart interval is defined) */
+    unsigned int count                      /* Number of restart intervals to decompress */
+)
+{
+    unsigned int x, y, mx, my, mcu, end, n, out;
     uint16_t rst, rsc;
     JRESULT rc;
 
@@ -1363,30 +1548,81 @@ JRESULT jd_decomp (
     jd->scale = scale;
 
     mx = jd->msx * 8; my = jd->msy * 8;         /* Size of the MCU (pixel) */
+    n = (jd->width + mx - 1) / mx;              /* Number of MCUs in a row */
+    end = n * ((jd->height + my - 1) / my);     /* Number of MCUs in the image */
+
+    mcu = jd->nrst ? first * jd->nrst : 0;      /* Range of MCUs to decompress */
+    if (mcu >= end) {
+        return JDR_PAR;
+    }
+    if (jd->nrst && count < (end - mcu + jd->nrst - 1) / jd->nrst) {
+        end = mcu + count * jd->nrst;
+    }
+    if (end > (jd->roi.bottom / my + 1) * n) {  /* Nothing to output below the region of interest */
+        end = (jd->roi.bottom / my + 1) * n;
+    }
+    x = mcu % n * mx; y = mcu / n * my;
 
     jd->dcv[2] = jd->dcv[1] = jd->dcv[0] = 0;   /* Initialize DC values */
-    rst = rsc = 0;
+    rst = 0; rsc = (uint16_t)first;
 
     rc = JDR_OK;
-    for (y = 0; y < jd->height; y += my) {      /* Vertical loop of MCUs */
-        for (x = 0; x < jd->width; x += mx) {   /* Horizontal loop of MCUs */
-            if (jd->nrst && rst++ == jd->nrst) {    /* Process restart interval if enabled */
-                rc = restart(jd, rsc++);
-                if (rc != JDR_OK) {
-                    return rc;
-                }
-                rst = 1;
-            }
-            rc = mcu_load(jd);                  /* Load an MCU (decompress huffman coded stream, dequantize and apply IDCT) */
+    for ( ; mcu < end; mcu++) {
+        if (jd->nrst && rst++ == jd->nrst) {    /* Process restart interval if enabled */
+            rc = restart(jd, rsc++);
             if (rc != JDR_OK) {
                 return rc;
             }
+            rst = 1;
+        }
+        out = x <= jd->roi.right && x + mx > jd->roi.left && y + my > jd->roi.top;  /* MCU overlaps the region of interest? */
+        rc = mcu_load(jd, out);                 /* Load an MCU (decompress huffman coded stream, dequantize and apply IDCT) */
+        if (rc != JDR_OK) {
+            return rc;
+        }
+        if (out) {
             rc = mcu_output(jd, outfunc, x, y); /* Output the MCU (YCbCr to RGB, scaling and output) */
             if (rc != JDR_OK) {
                 return rc;
             }
         }
+        x += mx;                                /* Next MCU */
+        if (x >= jd->width) {
+            x = 0; y += my;
+        }
     }
 
     return rc;
 }
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Create a decompressor object for another part of the image            */
+/* (Espressif extension)                                                 */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_clone (
+    JDEC *jd,               /* Blank decompressor object */
+    const JDEC *src,        /* Decompression object initialized by jd_prepare() */
+    void *pool,             /* Working buffer for the new object */
+    size_t sz_pool          /* Size of working buffer */
+)
+{
+    *jd = *src;             /* Image parameters and tables are shared, they are not modified by decompression */
+    jd->pool = pool;
+    jd->sz_pool = sz_pool;
+    jd->dctr = 0;           /* Input stream is empty */
+    jd->dbit = 0;
+#if JD_FASTDECODE >= 1
+    jd->wreg = 0;
+    jd->marker = 0;
+#endif
+
+    jd->inbuf = jd->dptr = alloc_pool(jd, JD_SZBUF);   /* Allocate stream input buffer */
+    if (!jd->inbuf) {
+        return JDR_MEM1;
+    }
+    return alloc_mcu_buf(jd);
+}
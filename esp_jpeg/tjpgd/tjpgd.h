@@ -86,6 +86,8 @@ struct JDEC {
     size_t sz_pool;             /* Size of memory pool (bytes available) */
     size_t (*infunc)(JDEC *, uint8_t *, size_t); /* Pointer to jpeg stream input function */
     void *device;               /* Pointer to I/O device identifier for the session */
+    JRECT roi;                  /* Region of the input image to output, whole image after jd_prepare() (Espressif extension) */
+    uint8_t ycbcr;              /* Output Y, Cb, Cr (3 bytes/pixel) instead of RGB, 0 after jd_prepare() (Espressif extension) */
 };
 
 
@@ -93,6 +95,10 @@ struct JDEC {
 /* TJpgDec API functions */
 JRESULT jd_prepare (JDEC *jd, size_t (*infunc)(JDEC *, uint8_t *, size_t), void *pool, size_t sz_pool, void *dev);
 JRESULT jd_decomp (JDEC *jd, int (*outfunc)(JDEC *, void *, JRECT *), uint8_t scale);
+JRESULT jd_input_mem (JDEC *jd, const uint8_t *data, size_t ndata);
+JRESULT jd_decomp_rst (JDEC *jd, int (*outfunc)(JDEC *, void *, JRECT *), uint8_t scale, unsigned int first, unsigned int count);
+JRESULT jd_clone (JDEC *jd, const JDEC *src, void *pool, size_t sz_pool);
+JRESULT jd_prepare_next (JDEC *jd, size_t (*infunc)(JDEC *, uint8_t *, size_t), void *pool, size_t sz_pool, void *dev);
 
 
 #ifdef __cplusplus
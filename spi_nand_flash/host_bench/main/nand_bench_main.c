@@ -0,0 +1,477 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * FTL benchmark on the Linux NAND emulator.
+ *
+ * Runs a fixed sequence of workloads through the public page API and reports, for each of them, the operations per
+ * second of the emulator's simulated time and of the host wall clock, the chip operations and the write
+ * amplification. Mount time and the RAM taken by the device handle are reported as well, and the mount of images of
+ * several sizes after a clean shutdown and after a power cut. The results are printed as a table and as one JSON line (prefixed with NAND_BENCH_JSON:), which is also written to the file named by the
+ * NAND_BENCH_JSON environment variable when it is set.
+ *
+ * Environment:
+ *   NAND_BENCH_FLASH_MB  Size of the emulated chip in MiB (default 32)
+ *   NAND_BENCH_GC_FACTOR Garbage collection factor (default: the driver's)
+ *   NAND_BENCH_JSON      File the JSON results are written to
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "spi_nand_flash.h"
+#include "nand_linux_mmap_emul.h"
+#include "nand_diag_api.h"
+#include "sdkconfig.h"
+
+#if !CONFIG_NAND_ENABLE_STATS
+#error "The benchmark reads the emulator statistics, enable CONFIG_NAND_ENABLE_STATS"
+#endif
+
+#define BENCH_IMAGE             "/tmp/nand-bench.bin"
+#define BENCH_MOUNT_IMAGE       "/tmp/nand-bench-mount.bin"
+#define BENCH_MOUNT_CUT_IMAGE   "/tmp/nand-bench-mount-cut.bin"
+#define BENCH_DEFAULT_FLASH_MB  32
+#define BENCH_MAX_RESULTS       16
+#define BENCH_SEQ_CHUNK_BYTES   (64 * 1024)     // Large sequential transfers
+#define BENCH_RANDOM_IO_BYTES   4096            // Random I/O unit, one FAT cluster
+#define BENCH_SYNC_INTERVAL     8               // FAT churn: file appends between syncs
+#define BENCH_MOUNT_SIZES       3
+
+typedef struct {
+    const char *name;
+    uint32_t ops;                   // Calls to the page API (one transfer of the workload's unit each)
+    uint64_t bytes;
+    uint64_t wall_us;
+    nand_emul_perf_stats_t perf;
+    uint32_t write_p50_us;          // Wear-levelling layer page writes, with CONFIG_NAND_FLASH_LATENCY_STATS
+    uint32_t write_p99_us;
+} bench_result_t;
+
+typedef struct {
+    uint32_t page_reads;
+    uint64_t sim_us;
+    uint64_t wall_us;
+} bench_mount_t;
+
+typedef struct {
+    size_t flash_mb;
+    bench_mount_t clean;            // After a clean shutdown
+    bench_mount_t cut;              // After a power cut following a sync
+} bench_mount_size_t;
+
+typedef struct {
+    nand_file_mmap_emul_config_t emul;
+    spi_nand_flash_config_t config;
+    spi_nand_flash_device_t *dev;
+    uint32_t page_size;
+    uint32_t num_pages;             // Logical pages
+    uint32_t num_blocks;
+    uint8_t *buf;                   // BENCH_SEQ_CHUNK_BYTES
+    uint32_t rng;
+    bench_result_t results[BENCH_MAX_RESULTS];
+    uint32_t num_results;
+    uint64_t mount_fresh_wall_us;
+    uint64_t mount_fresh_sim_us;
+    uint64_t mount_clean_wall_us;
+    uint64_t mount_clean_sim_us;
+    bench_mount_size_t mount_sizes[BENCH_MOUNT_SIZES];
+    long ram_bytes;                 // Heap held by an initialized device, -1 if unknown
+} bench_t;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long heap_in_use(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (long)mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (long)mallinfo().uordblks;
+#else
+    return -1;
+#endif
+}
+
+static uint32_t bench_rand(bench_t *b)
+{
+    // xorshift32, so that every run issues the same operations
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 17;
+    b->rng ^= b->rng << 5;
+    return b->rng;
+}
+
+static void fill_pages(bench_t *b, uint32_t first_page, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t *page = b->buf + (size_t)i * b->page_size;
+        uint32_t stamp = first_page + i;
+        memset(page, (uint8_t)stamp, b->page_size);
+        memcpy(page, &stamp, sizeof(stamp));
+    }
+}
+
+static void check_ok(esp_err_t err, const char *what)
+{
+    if (err != ESP_OK) {
+        printf("%s failed: %s\n", what, esp_err_to_name(err));
+        exit(1);
+    }
+}
+
+static void mount(bench_t *b, uint64_t *wall_us, uint64_t *sim_us)
+{
+    long heap_before = heap_in_use();
+    uint64_t start = now_us();
+    check_ok(spi_nand_flash_init_device(&b->config, &b->dev), "spi_nand_flash_init_device");
+    *wall_us = now_us() - start;
+    // The emulator counts from init, so this is the cost of the mount itself
+    nand_emul_perf_stats_t perf;
+    check_ok(nand_emul_get_perf_stats(b->dev, &perf), "nand_emul_get_perf_stats");
+    *sim_us = perf.elapsed_us;
+    if (heap_before >= 0) {
+        b->ram_bytes = heap_in_use() - heap_before;
+    }
+}
+
+static void unmount(bench_t *b)
+{
+    check_ok(spi_nand_flash_deinit_device(b->dev), "spi_nand_flash_deinit_device");
+    b->dev = NULL;
+}
+
+static bench_result_t *begin(bench_t *b, const char *name)
+{
+    bench_result_t *r = &b->results[b->num_results++];
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    nand_emul_clear_stats(b->dev);
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    nand_reset_latency_stats(b->dev);
+#endif
+    r->wall_us = now_us();
+    return r;
+}
+
+static void end(bench_t *b, bench_result_t *r)
+{
+    r->wall_us = now_us() - r->wall_us;
+    check_ok(nand_emul_get_perf_stats(b->dev, &r->perf), "nand_emul_get_perf_stats");
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    nand_latency_stats_t lat;
+    if (nand_get_write_latency_stats(b->dev, &lat) == ESP_OK) {
+        r->write_p50_us = nand_latency_stats_percentile(&lat, 50);
+        r->write_p99_us = nand_latency_stats_percentile(&lat, 99);
+    }
+#endif
+}
+
+/* Sequential 64 KiB writes over the first `percent` of the device */
+static void run_seq_write(bench_t *b, const char *name, uint32_t percent)
+{
+    const uint32_t chunk = BENCH_SEQ_CHUNK_BYTES / b->page_size;
+    const uint32_t pages = b->num_pages / 100 * percent / chunk * chunk;
+    bench_result_t *r = begin(b, name);
+    for (uint32_t page = 0; page < pages; page += chunk) {
+        fill_pages(b, page, chunk);
+        check_ok(spi_nand_flash_write_pages(b->dev, b->buf, page, chunk), "spi_nand_flash_write_pages");
+        r->ops++;
+    }
+    check_ok(spi_nand_flash_sync(b->dev), "spi_nand_flash_sync");
+    r->bytes = (uint64_t)pages * b->page_size;
+    end(b, r);
+}
+
+static void run_seq_read(bench_t *b, const char *name, uint32_t percent)
+{
+    const uint32_t chunk = BENCH_SEQ_CHUNK_BYTES / b->page_size;
+    const uint32_t pages = b->num_pages / 100 * percent / chunk * chunk;
+    bench_result_t *r = begin(b, name);
+    for (uint32_t page = 0; page < pages; page += chunk) {
+        check_ok(spi_nand_flash_read_pages(b->dev, b->buf, page, chunk), "spi_nand_flash_read_pages");
+        uint32_t stamp;
+        memcpy(&stamp, b->buf, sizeof(stamp));
+        if (stamp != page) {
+            printf("%s: page %" PRIu32 " holds page %" PRIu32 "\n", name, page, stamp);
+            exit(1);
+        }
+        r->ops++;
+    }
+    r->bytes = (uint64_t)pages * b->page_size;
+    end(b, r);
+}
+
+/* 4 KiB reads and writes at random aligned offsets of the first `percent` of the device */
+static void run_random(bench_t *b, const char *name, uint32_t percent, uint32_t ops, uint32_t write_percent)
+{
+    const uint32_t unit = BENCH_RANDOM_IO_BYTES > b->page_size ? BENCH_RANDOM_IO_BYTES / b->page_size : 1;
+    const uint32_t slots = b->num_pages / 100 * percent / unit;
+    bench_result_t *r = begin(b, name);
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t page = bench_rand(b) % slots * unit;
+        if (bench_rand(b) % 100 < write_percent) {
+            fill_pages(b, page, unit);
+            check_ok(spi_nand_flash_write_pages(b->dev, b->buf, page, unit), "spi_nand_flash_write_pages");
+        } else {
+            check_ok(spi_nand_flash_read_pages(b->dev, b->buf, page, unit), "spi_nand_flash_read_pages");
+        }
+    }
+    check_ok(spi_nand_flash_sync(b->dev), "spi_nand_flash_sync");
+    r->ops = ops;
+    r->bytes = (uint64_t)ops * unit * b->page_size;
+    end(b, r);
+}
+
+/*
+ * What a FAT file system does when files are appended to: each 4 KiB cluster written to the data area also rewrites
+ * the FAT page holding its entry and the directory page of the file, and the file is synced every few clusters.
+ * The data area starts after the FAT and wraps around, so old clusters are overwritten as on a full volume.
+ */
+static void run_fat_churn(bench_t *b, const char *name, uint32_t clusters)
+{
+    const uint32_t unit = BENCH_RANDOM_IO_BYTES > b->page_size ? BENCH_RANDOM_IO_BYTES / b->page_size : 1;
+    const uint32_t data_clusters = b->num_pages / 2 / unit;
+    const uint32_t entries_per_page = b->page_size / sizeof(uint32_t);
+    const uint32_t fat_pages = (data_clusters + entries_per_page - 1) / entries_per_page;
+    const uint32_t dir_pages = 4;
+    const uint32_t data_start = fat_pages + dir_pages;
+    uint32_t cursor = 0;
+
+    bench_result_t *r = begin(b, name);
+    for (uint32_t i = 0; i < clusters; i++) {
+        const uint32_t file = i / 64;
+        fill_pages(b, data_start + cursor * unit, unit);
+        check_ok(spi_nand_flash_write_pages(b->dev, b->buf, data_start + cursor * unit, unit), "data write");
+        fill_pages(b, cursor / entries_per_page, 1);
+        check_ok(spi_nand_flash_write_page(b->dev, b->buf, cursor / entries_per_page), "FAT write");
+        fill_pages(b, fat_pages + file % dir_pages, 1);
+        check_ok(spi_nand_flash_write_page(b->dev, b->buf, fat_pages + file % dir_pages), "directory write");
+        if (i % BENCH_SYNC_INTERVAL == BENCH_SYNC_INTERVAL - 1) {
+            check_ok(spi_nand_flash_sync(b->dev), "spi_nand_flash_sync");
+        }
+        cursor = (cursor + 1) % data_clusters;
+    }
+    check_ok(spi_nand_flash_sync(b->dev), "spi_nand_flash_sync");
+    r->ops = clusters;
+    r->bytes = (uint64_t)clusters * (unit + 2) * b->page_size;
+    end(b, r);
+}
+
+/* Mount the image in `path`, which is kept when the device is deinitialized */
+static spi_nand_flash_device_t *mount_image(const char *path, size_t flash_mb, bench_mount_t *m)
+{
+    nand_file_mmap_emul_config_t emul = {"", flash_mb * 1024 * 1024, true};
+    snprintf(emul.flash_file_name, sizeof(emul.flash_file_name), "%s", path);
+    spi_nand_flash_config_t config = {.emul_conf = &emul, .io_mode = SPI_NAND_IO_MODE_QIO};
+    spi_nand_flash_device_t *dev;
+    uint64_t start = now_us();
+    check_ok(spi_nand_flash_init_device(&config, &dev), "spi_nand_flash_init_device");
+    m->wall_us = now_us() - start;
+    nand_emul_perf_stats_t perf;
+    check_ok(nand_emul_get_perf_stats(dev, &perf), "nand_emul_get_perf_stats");
+    m->page_reads = perf.page_reads;
+    m->sim_us = perf.elapsed_us;
+    return dev;
+}
+
+static void copy_image(const char *src, const char *dst)
+{
+    FILE *in = fopen(src, "rb");
+    FILE *out = fopen(dst, "wb");
+    if (in == NULL || out == NULL) {
+        printf("Failed to copy %s to %s\n", src, dst);
+        exit(1);
+    }
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        if (fwrite(chunk, 1, n, out) != n) {
+            printf("Failed to write %s\n", dst);
+            exit(1);
+        }
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/*
+ * Mount of an image half filled with data, after a clean shutdown and after a power cut that follows a sync and a
+ * write. With CONFIG_NAND_FLASH_FAST_MOUNT the first one reads the checkpoint, and the second one searches the
+ * journal because the checkpoint is stale.
+ */
+static void run_mount_size(bench_t *b, bench_mount_size_t *r, size_t flash_mb)
+{
+    bench_mount_t fresh;
+    r->flash_mb = flash_mb;
+    remove(BENCH_MOUNT_IMAGE);
+    spi_nand_flash_device_t *dev = mount_image(BENCH_MOUNT_IMAGE, flash_mb, &fresh);
+    uint32_t page_size, num_pages;
+    check_ok(spi_nand_flash_get_page_size(dev, &page_size), "spi_nand_flash_get_page_size");
+    check_ok(spi_nand_flash_get_page_count(dev, &num_pages), "spi_nand_flash_get_page_count");
+    const uint32_t chunk = BENCH_SEQ_CHUNK_BYTES / page_size;
+    const uint32_t pages = num_pages / 2 / chunk * chunk;
+    for (uint32_t page = 0; page < pages; page += chunk) {
+        fill_pages(b, page, chunk);
+        check_ok(spi_nand_flash_write_pages(dev, b->buf, page, chunk), "spi_nand_flash_write_pages");
+    }
+    // Rewrite every third chunk, so that the journal holds garbage as well
+    for (uint32_t page = 0; page < pages; page += 3 * chunk) {
+        fill_pages(b, page, chunk);
+        check_ok(spi_nand_flash_write_pages(dev, b->buf, page, chunk), "spi_nand_flash_write_pages");
+    }
+    check_ok(spi_nand_flash_deinit_device(dev), "spi_nand_flash_deinit_device");
+
+    dev = mount_image(BENCH_MOUNT_IMAGE, flash_mb, &r->clean);
+    check_ok(spi_nand_flash_sync(dev), "spi_nand_flash_sync");
+    fill_pages(b, 0, 1);
+    check_ok(spi_nand_flash_write_page(dev, b->buf, 0), "spi_nand_flash_write_page");
+    copy_image(BENCH_MOUNT_IMAGE, BENCH_MOUNT_CUT_IMAGE);
+    check_ok(spi_nand_flash_deinit_device(dev), "spi_nand_flash_deinit_device");
+    remove(BENCH_MOUNT_IMAGE);
+
+    dev = mount_image(BENCH_MOUNT_CUT_IMAGE, flash_mb, &r->cut);
+    check_ok(spi_nand_flash_deinit_device(dev), "spi_nand_flash_deinit_device");
+    remove(BENCH_MOUNT_CUT_IMAGE);
+}
+
+static double per_second(uint64_t count, uint64_t us)
+{
+    return us ? (double)count * 1000000.0 / (double)us : 0.0;
+}
+
+static void print_table(const bench_t *b)
+{
+    printf("\n%-16s %8s %12s %10s %12s %9s %9s %8s %6s\n", "workload", "ops", "sim ops/s", "sim MiB/s",
+           "wall ops/s", "programs", "reads", "erases", "WA");
+    for (uint32_t i = 0; i < b->num_results; i++) {
+        const bench_result_t *r = &b->results[i];
+        printf("%-16s %8" PRIu32 " %12.1f %10.2f %12.1f %9" PRIu32 " %9" PRIu32 " %8" PRIu32 " %6.2f\n", r->name,
+               r->ops, per_second(r->ops, r->perf.elapsed_us), per_second(r->bytes, r->perf.elapsed_us) / (1024 * 1024),
+               per_second(r->ops, r->wall_us), r->perf.page_programs, r->perf.page_reads, r->perf.block_erases,
+               nand_emul_write_amplification(&r->perf));
+    }
+    printf("mount: fresh %" PRIu64 " us (sim %" PRIu64 " us), clean remount %" PRIu64 " us (sim %" PRIu64 " us)\n",
+           b->mount_fresh_wall_us, b->mount_fresh_sim_us, b->mount_clean_wall_us, b->mount_clean_sim_us);
+    for (uint32_t i = 0; i < BENCH_MOUNT_SIZES; i++) {
+        const bench_mount_size_t *m = &b->mount_sizes[i];
+        printf("mount %4zu MiB: clean %5" PRIu32 " reads %8" PRIu64 " us (sim %8" PRIu64 " us), after a cut %5" PRIu32
+               " reads %8" PRIu64 " us (sim %8" PRIu64 " us)\n", m->flash_mb, m->clean.page_reads, m->clean.wall_us,
+               m->clean.sim_us, m->cut.page_reads, m->cut.wall_us, m->cut.sim_us);
+    }
+    printf("device RAM: %ld bytes\n\n", b->ram_bytes);
+}
+
+static void write_json(const bench_t *b, FILE *f)
+{
+    fprintf(f, "{\"flash_size\":%zu,\"page_size\":%" PRIu32 ",\"num_blocks\":%" PRIu32 ",\"capacity_pages\":%" PRIu32
+            ",\"gc_factor\":%u,\"io_mode\":%d,\"ram_bytes\":%ld,", b->emul.flash_file_size, b->page_size, b->num_blocks,
+            b->num_pages, b->config.gc_factor, (int)b->config.io_mode, b->ram_bytes);
+    fprintf(f, "\"mount\":{\"fresh_wall_us\":%" PRIu64 ",\"fresh_sim_us\":%" PRIu64 ",\"clean_wall_us\":%" PRIu64
+            ",\"clean_sim_us\":%" PRIu64 "},", b->mount_fresh_wall_us, b->mount_fresh_sim_us, b->mount_clean_wall_us,
+            b->mount_clean_sim_us);
+    fprintf(f, "\"mount_sizes\":[");
+    for (uint32_t i = 0; i < BENCH_MOUNT_SIZES; i++) {
+        const bench_mount_size_t *m = &b->mount_sizes[i];
+        fprintf(f, "%s{\"flash_mb\":%zu,\"clean_reads\":%" PRIu32 ",\"clean_sim_us\":%" PRIu64 ",\"clean_wall_us\":%"
+                PRIu64 ",\"cut_reads\":%" PRIu32 ",\"cut_sim_us\":%" PRIu64 ",\"cut_wall_us\":%" PRIu64 "}", i ? "," : "",
+                m->flash_mb, m->clean.page_reads, m->clean.sim_us, m->clean.wall_us, m->cut.page_reads, m->cut.sim_us,
+                m->cut.wall_us);
+    }
+    fprintf(f, "],");
+    fprintf(f, "\"workloads\":[");
+    for (uint32_t i = 0; i < b->num_results; i++) {
+        const bench_result_t *r = &b->results[i];
+        fprintf(f, "%s{\"name\":\"%s\",\"ops\":%" PRIu32 ",\"bytes\":%" PRIu64 ",\"sim_us\":%" PRIu64
+                ",\"sim_ops_per_s\":%.1f,\"sim_mib_per_s\":%.3f,\"wall_us\":%" PRIu64 ",\"wall_ops_per_s\":%.1f,"
+                "\"page_reads\":%" PRIu32 ",\"page_programs\":%" PRIu32 ",\"block_erases\":%" PRIu32
+                ",\"host_page_writes\":%" PRIu32 ",\"write_amplification\":%.3f,\"write_p50_us\":%" PRIu32
+                ",\"write_p99_us\":%" PRIu32 "}", i ? "," : "", r->name, r->ops, r->bytes, r->perf.elapsed_us,
+                per_second(r->ops, r->perf.elapsed_us), per_second(r->bytes, r->perf.elapsed_us) / (1024 * 1024),
+                r->wall_us, per_second(r->ops, r->wall_us), r->perf.page_reads, r->perf.page_programs,
+                r->perf.block_erases, r->perf.host_page_writes, nand_emul_write_amplification(&r->perf),
+                r->write_p50_us, r->write_p99_us);
+    }
+    fprintf(f, "]}\n");
+}
+
+void app_main(void)
+{
+    static bench_t bench;
+    bench_t *b = &bench;
+    const char *env = getenv("NAND_BENCH_FLASH_MB");
+    size_t flash_mb = env ? strtoul(env, NULL, 0) : BENCH_DEFAULT_FLASH_MB;
+    env = getenv("NAND_BENCH_GC_FACTOR");
+
+    remove(BENCH_IMAGE);
+    snprintf(b->emul.flash_file_name, sizeof(b->emul.flash_file_name), "%s", BENCH_IMAGE);
+    b->emul.flash_file_size = flash_mb * 1024 * 1024;
+    b->emul.keep_dump = true;   // Kept across the remount, removed at the end
+    b->config.emul_conf = &b->emul;
+    b->config.gc_factor = env ? (uint8_t)strtoul(env, NULL, 0) : 0;
+    b->config.io_mode = SPI_NAND_IO_MODE_QIO;
+    b->ram_bytes = -1;
+    b->rng = 0x2545F491;
+
+    mount(b, &b->mount_fresh_wall_us, &b->mount_fresh_sim_us);
+    check_ok(spi_nand_flash_get_page_size(b->dev, &b->page_size), "spi_nand_flash_get_page_size");
+    check_ok(spi_nand_flash_get_page_count(b->dev, &b->num_pages), "spi_nand_flash_get_page_count");
+    check_ok(spi_nand_flash_get_block_num(b->dev, &b->num_blocks), "spi_nand_flash_get_block_num");
+    b->buf = malloc(BENCH_SEQ_CHUNK_BYTES > b->page_size ? BENCH_SEQ_CHUNK_BYTES : b->page_size);
+    if (b->buf == NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    const uint32_t random_ops = b->num_pages / 4;
+    run_seq_write(b, "seq_write", 75);
+    run_seq_read(b, "seq_read", 75);
+    run_random(b, "rand_write_4k", 75, random_ops, 100);
+    run_random(b, "rand_read_4k", 75, random_ops, 0);
+    run_random(b, "mixed_4k_70r30w", 75, random_ops, 30);
+    run_fat_churn(b, "fat_churn", random_ops / 2);
+    run_seq_write(b, "seq_overwrite", 75);
+
+    unmount(b);
+    mount(b, &b->mount_clean_wall_us, &b->mount_clean_sim_us);
+    run_seq_read(b, "seq_read_remount", 75);
+    unmount(b);
+    remove(BENCH_IMAGE);
+
+    static const size_t mount_sizes_mb[BENCH_MOUNT_SIZES] = {8, 32, 128};
+    for (uint32_t i = 0; i < BENCH_MOUNT_SIZES; i++) {
+        run_mount_size(b, &b->mount_sizes[i], mount_sizes_mb[i]);
+    }
+    free(b->buf);
+
+    print_table(b);
+    printf("NAND_BENCH_JSON:");
+    write_json(b, stdout);
+    env = getenv("NAND_BENCH_JSON");
+    if (env) {
+        FILE *f = fopen(env, "w");
+        if (f == NULL) {
+            printf("Failed to open %s\n", env);
+            exit(1);
+        }
+        write_json(b, f);
+        fclose(f);
+    }
+    printf("Benchmark done\n");
+    fflush(stdout);
+    exit(0);
+}
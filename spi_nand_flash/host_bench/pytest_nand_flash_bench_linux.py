@@ -0,0 +1,32 @@
+# SPDX-FileCopyrightText: 2026 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+import glob
+import json
+from pathlib import Path
+
+import pytest
+from pytest_embedded import Dut
+from pytest_embedded_idf.utils import idf_parametrize
+
+
+@pytest.mark.host_test
+@pytest.mark.skipif(
+    not bool(glob.glob(f'{Path(__file__).parent.absolute()}/build*/')),
+    reason="Skip the idf version that not build"
+)
+@idf_parametrize('target', ['linux'], indirect=['target'])
+def test_nand_flash_bench_linux(dut: Dut) -> None:
+    match = dut.expect(r'NAND_BENCH_JSON:(\{.*\})\r?\n', timeout=300)
+    results = json.loads(match.group(1).decode())
+    names = [w['name'] for w in results['workloads']]
+    for name in ('seq_write', 'seq_read', 'rand_write_4k', 'rand_read_4k', 'fat_churn'):
+        assert name in names
+    for workload in results['workloads']:
+        assert workload['ops'] > 0
+        assert workload['sim_us'] > 0
+        if workload['host_page_writes']:
+            assert workload['write_amplification'] >= 1.0
+    for mount in results['mount_sizes']:
+        assert mount['clean_reads'] > 0
+        assert mount['cut_reads'] > 0
+    dut.expect_exact('Benchmark done', timeout=30)
@@ -11,6 +11,7 @@
 #include "spi_nand_flash_test_helpers.h"
 #include "nand_linux_mmap_emul.h"
 #include "nand_private/nand_impl_wrap.h"
+#include "sdkconfig.h"
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -40,6 +41,40 @@ TEST_CASE("verify mark_bad_block works", "[spi_nand_flash]")
     spi_nand_flash_deinit_device(device_handle);
 }
 
+#if CONFIG_NAND_ENABLE_STATS
+TEST_CASE("bad block status is read from flash once per block", "[spi_nand_flash]")
+{
+    nand_file_mmap_emul_config_t conf = {"", 16 * 1024 * 1024, false};
+    spi_nand_flash_config_t nand_flash_config = {&conf, 0, SPI_NAND_IO_MODE_SIO, 0};
+    spi_nand_flash_device_t *device_handle;
+    REQUIRE(spi_nand_flash_init_device(&nand_flash_config, &device_handle) == ESP_OK);
+
+    uint32_t block_num;
+    REQUIRE(spi_nand_flash_get_block_num(device_handle, &block_num) == 0);
+    size_t reads, write_ops, erase_ops, read_bytes, write_bytes;
+    bool is_bad_status = false;
+
+    // First pass: the markers of the blocks not seen yet by the wear-levelling layer are read
+    for (uint32_t block = 0; block < block_num; block++) {
+        REQUIRE(nand_wrap_is_bad(device_handle, block, &is_bad_status) == 0);
+        REQUIRE(is_bad_status == false);
+    }
+
+    // Then every query is served from RAM, including for a block marked bad since
+    uint32_t test_block = 7;
+    REQUIRE(nand_wrap_mark_bad(device_handle, test_block) == 0);
+    nand_emul_clear_stats(device_handle);
+    for (uint32_t block = 0; block < block_num; block++) {
+        REQUIRE(nand_wrap_is_bad(device_handle, block, &is_bad_status) == 0);
+        REQUIRE(is_bad_status == (block == test_block));
+    }
+    nand_emul_get_stats(device_handle, &reads, &write_ops, &erase_ops, &read_bytes, &write_bytes);
+    REQUIRE(reads == 0);
+
+    spi_nand_flash_deinit_device(device_handle);
+}
+#endif // CONFIG_NAND_ENABLE_STATS
+
 TEST_CASE("verify nand_prog, nand_read, nand_copy, nand_is_free works", "[spi_nand_flash]")
 {
     nand_file_mmap_emul_config_t conf = {"", 50 * 1024 * 1024, false};
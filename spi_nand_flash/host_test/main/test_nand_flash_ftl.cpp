@@ -8,7 +8,7 @@
  * FTL-level host tests for spi_nand_flash.
  *
  * All tests exercise the public logical-sector API exclusively:
- *   spi_nand_flash_write_sector / read_sector / copy_sector / trim /
+ *   spi_nand_flash_write_sector / read_sector / copy_sector / trim / trim_range /
  *   sync / get_capacity / get_sector_size / get_block_size /
  *   get_block_num / spi_nand_erase_chip
  *
@@ -20,10 +20,16 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #include "spi_nand_flash.h"
 #include "spi_nand_flash_test_helpers.h"
 #include "nand_linux_mmap_emul.h"
+#include "nand_diag_api.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include <catch2/catch_test_macros.hpp>
 
@@ -37,21 +43,51 @@
 /** Larger flash used for the full-capacity sequential sweep. */
 #define FTL_TEST_FLASH_LARGE ((size_t)32u * 1024u * 1024u)
 
+/** Emulator and device configuration; cfg.emul_conf points to emul. */
+typedef struct {
+    nand_file_mmap_emul_config_t emul;
+    spi_nand_flash_config_t cfg;
+} ftl_test_config_t;
+
 /**
- * Open a fresh emulated NAND device backed by an anonymous temp file.
+ * Configure an emulated NAND device backed by an anonymous temp file.
  * gc_factor == 0 selects the driver default.
+ * With an `image` path, the device is backed by that file instead, which is kept at deinit so that it can be
+ * mounted again.
  */
+static void make_ftl_config(ftl_test_config_t *conf, size_t flash_size = FTL_TEST_FLASH_SIZE,
+                            uint8_t gc_factor = 0, const char *image = nullptr)
+{
+    conf->emul = {"", flash_size, /*keep_dump=*/image != nullptr};
+    if (image != nullptr) {
+        snprintf(conf->emul.flash_file_name, sizeof(conf->emul.flash_file_name), "%s", image);
+    }
+    conf->cfg = {&conf->emul, gc_factor, SPI_NAND_IO_MODE_SIO, 0};
+}
+
+/** Open a fresh emulated NAND device, configured as by make_ftl_config(). */
 static spi_nand_flash_device_t *make_ftl_dev(size_t flash_size = FTL_TEST_FLASH_SIZE,
-        uint8_t gc_factor = 0)
+        uint8_t gc_factor = 0, const char *image = nullptr)
 {
-    nand_file_mmap_emul_config_t emul = {"", flash_size, /*keep_dump=*/false};
-    spi_nand_flash_config_t cfg = {&emul, gc_factor, SPI_NAND_IO_MODE_SIO, 0};
+    ftl_test_config_t conf;
+    make_ftl_config(&conf, flash_size, gc_factor, image);
     spi_nand_flash_device_t *dev = nullptr;
-    REQUIRE(spi_nand_flash_init_device(&cfg, &dev) == ESP_OK);
+    REQUIRE(spi_nand_flash_init_device(&conf.cfg, &dev) == ESP_OK);
     REQUIRE(dev != nullptr);
     return dev;
 }
 
+/**
+ * Create an empty image file named after `path`, whose last six characters are XXXXXX (see mkstemp()). The name is
+ * unique, so that test apps of several configurations can run at the same time.
+ */
+static void make_ftl_image(char *path)
+{
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+}
+
 static void destroy_ftl_dev(spi_nand_flash_device_t *dev)
 {
     REQUIRE(spi_nand_flash_deinit_device(dev) == ESP_OK);
@@ -215,6 +251,57 @@ TEST_CASE("FTL multiple sectors hold independent data after interleaved writes",
     destroy_ftl_dev(dev);
 }
 
+TEST_CASE("FTL write_pages/read_pages round-trip with trimmed and rewritten pages",
+          "[ftl][rw][batch]")
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+    uint32_t sz = 0;
+    REQUIRE(spi_nand_flash_get_page_size(dev, &sz) == ESP_OK);
+
+    /* Spans several read batches of the wear-leveling layer */
+    const uint32_t N = 40;
+    const uint32_t START = 100;
+    uint8_t *wbuf = (uint8_t *)malloc((size_t)N * sz);
+    uint8_t *rbuf = (uint8_t *)malloc((size_t)N * sz);
+    REQUIRE(wbuf != nullptr);
+    REQUIRE(rbuf != nullptr);
+
+    for (uint32_t i = 0; i < N; i++) {
+        spi_nand_flash_fill_buffer_seeded(wbuf + (size_t)i * sz, sz / sizeof(uint32_t), START + i);
+    }
+    REQUIRE(spi_nand_flash_write_pages(dev, wbuf, START, N) == ESP_OK);
+
+    /* Punch holes and break up physical contiguity */
+    REQUIRE(spi_nand_flash_trim(dev, START + 5) == ESP_OK);
+    REQUIRE(spi_nand_flash_trim(dev, START + 20) == ESP_OK);
+    spi_nand_flash_fill_buffer_seeded(wbuf + (size_t)30 * sz, sz / sizeof(uint32_t), 0xC0FFEEu);
+    REQUIRE(spi_nand_flash_write_page(dev, wbuf + (size_t)30 * sz, START + 30) == ESP_OK);
+
+    REQUIRE(spi_nand_flash_read_pages(dev, rbuf, START, N) == ESP_OK);
+    for (uint32_t i = 0; i < N; i++) {
+        const uint8_t *page = rbuf + (size_t)i * sz;
+        if (i == 5 || i == 20) {
+            for (uint32_t b = 0; b < sz; b++) {
+                REQUIRE(page[b] == 0xFF);
+            }
+        } else if (i == 30) {
+            REQUIRE(spi_nand_flash_check_buffer_seeded(page, sz / sizeof(uint32_t), 0xC0FFEEu) == 0);
+        } else {
+            REQUIRE(spi_nand_flash_check_buffer_seeded(page, sz / sizeof(uint32_t), START + i) == 0);
+        }
+    }
+
+    /* The batched read must agree with single-page reads */
+    for (uint32_t i = 0; i < N; i++) {
+        REQUIRE(spi_nand_flash_read_page(dev, wbuf, START + i) == ESP_OK);
+        REQUIRE(memcmp(wbuf, rbuf + (size_t)i * sz, sz) == 0);
+    }
+
+    free(wbuf);
+    free(rbuf);
+    destroy_ftl_dev(dev);
+}
+
 /* -------------------------------------------------------------------------
  * Group 3: sync
  * ---------------------------------------------------------------------- */
@@ -380,6 +467,93 @@ TEST_CASE("FTL trim on unwritten sector returns ESP_OK", "[ftl][trim]")
     destroy_ftl_dev(dev);
 }
 
+/* Fill most of the device, churn it until the journal is full, then trim `count` sectors from `start` either one at
+ * a time or with one range call. Returns the device for the caller to check and destroy. */
+static spi_nand_flash_device_t *make_trimmed_dev(bool ranged, uint32_t live, uint32_t start, uint32_t count)
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+    uint32_t sectors = 0, sz = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+
+    for (uint32_t i = 0; i < live; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, i) == ESP_OK);
+    }
+    uint32_t seed = 3;
+    for (uint32_t i = 0; i < sectors; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t s = (seed >> 8) % live;
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), s);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, s) == ESP_OK);
+    }
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+
+#if CONFIG_NAND_ENABLE_STATS
+    nand_emul_clear_stats(dev);
+#endif
+    if (ranged) {
+        REQUIRE(spi_nand_flash_trim_range(dev, start, count) == ESP_OK);
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            REQUIRE(spi_nand_flash_trim(dev, start + i) == ESP_OK);
+        }
+    }
+    free(buf);
+    return dev;
+}
+
+TEST_CASE("FTL trim_range unmaps the range and keeps the sectors around it", "[ftl][trim]")
+{
+    uint32_t sectors = 0, sz = 0;
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    destroy_ftl_dev(dev);
+
+    /* Most of the device is live, and the range reaches past the written sectors */
+    const uint32_t live = sectors * 9 / 10;
+    const uint32_t start = sectors / 10;
+    const uint32_t count = sectors * 85 / 100;
+    dev = make_trimmed_dev(true, live, start, count);
+#if CONFIG_NAND_ENABLE_STATS
+    nand_emul_perf_stats_t range_stats;
+    REQUIRE(nand_emul_get_perf_stats(dev, &range_stats) == ESP_OK);
+#endif
+
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+    for (uint32_t i = 0; i < live; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+        if (i - start < count) {
+            for (uint32_t k = 0; k < sz; k++) {
+                REQUIRE(buf[k] == 0xFF);
+            }
+        } else {
+            REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), i) == 0);
+        }
+    }
+    /* Trimmed sectors can be written again */
+    spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), 77);
+    REQUIRE(spi_nand_flash_write_sector(dev, buf, start) == ESP_OK);
+    REQUIRE(spi_nand_flash_read_sector(dev, buf, start) == ESP_OK);
+    REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), 77) == 0);
+    free(buf);
+    destroy_ftl_dev(dev);
+
+#if CONFIG_NAND_ENABLE_STATS
+    /* The same trim one sector at a time relocates sectors of the range that garbage collection meets first */
+    dev = make_trimmed_dev(false, live, start, count);
+    nand_emul_perf_stats_t loop_stats;
+    REQUIRE(nand_emul_get_perf_stats(dev, &loop_stats) == ESP_OK);
+    destroy_ftl_dev(dev);
+    REQUIRE(range_stats.page_programs < loop_stats.page_programs);
+    REQUIRE(range_stats.block_erases <= loop_stats.block_erases);
+#endif
+}
+
 /* -------------------------------------------------------------------------
  * Group 6: erase_chip
  * ---------------------------------------------------------------------- */
@@ -461,6 +635,7 @@ TEST_CASE("FTL read from sector_id == capacity succeeds",
     destroy_ftl_dev(dev);
 }
 
+#if !CONFIG_DHARA_COMPACT_META
 TEST_CASE("FTL write to UINT32_MAX sector_id succeeds",
           "[ftl][bounds]")
 {
@@ -478,6 +653,32 @@ TEST_CASE("FTL write to UINT32_MAX sector_id succeeds",
     free(buf);
     destroy_ftl_dev(dev);
 }
+#else
+/* With compact metadata the radix tree only holds sector IDs below 2^20. */
+TEST_CASE("FTL write beyond the compact metadata sector range fails",
+          "[ftl][bounds]")
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+    uint32_t sz = 0;
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+
+    uint8_t *buf = (uint8_t *)calloc(1, sz);
+    REQUIRE(buf != nullptr);
+
+    REQUIRE(spi_nand_flash_write_sector(dev, buf, (1U << 20) - 1) == ESP_OK);
+    REQUIRE(spi_nand_flash_write_sector(dev, buf, 1U << 20) != ESP_OK);
+    REQUIRE(spi_nand_flash_write_sector(dev, buf, UINT32_MAX) != ESP_OK);
+
+    /* Out-of-range sectors read as unwritten, they never alias a mapped one */
+    REQUIRE(spi_nand_flash_read_sector(dev, buf, (1U << 20) + ((1U << 20) - 1)) == ESP_OK);
+    for (uint32_t i = 0; i < sz; i++) {
+        REQUIRE(buf[i] == 0xff);
+    }
+
+    free(buf);
+    destroy_ftl_dev(dev);
+}
+#endif
 
 /* -------------------------------------------------------------------------
  * Group 8: Sequential full-capacity write sweep
@@ -646,6 +847,564 @@ TEST_CASE("FTL GC stability with trim: hot-set with interleaved trims",
     destroy_ftl_dev(dev);
 }
 
+#if CONFIG_NAND_FLASH_BACKGROUND_GC && CONFIG_NAND_FLASH_LATENCY_STATS
+/* Wait until the background collector has found the device idle and finished collecting, after the last write */
+static nand_gc_stats_t wait_gc_idle_check(spi_nand_flash_device_t *dev)
+{
+    nand_gc_stats_t before = {}, stats = {};
+    REQUIRE(nand_get_gc_stats(dev, &before) == ESP_OK);
+    for (int i = 0; i < 3000; i++) {
+        REQUIRE(nand_get_gc_stats(dev, &stats) == ESP_OK);
+        if (stats.idle_checks > before.idle_checks) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    REQUIRE(stats.idle_checks > before.idle_checks);
+    return stats;
+}
+
+TEST_CASE("FTL background GC: bursts separated by idle time keep data intact",
+          "[ftl][gc][background]")
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+
+    uint32_t sectors = 0, sz = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+
+    /* Fill 60 % of the device, then rewrite random sectors of it in bursts */
+    const uint32_t live = sectors * 6 / 10;
+    uint8_t *wbuf = (uint8_t *)malloc(sz);
+    uint8_t *rbuf = (uint8_t *)malloc(sz);
+    uint32_t *last_seed = (uint32_t *)malloc(live * sizeof(uint32_t));
+    REQUIRE(wbuf != nullptr);
+    REQUIRE(rbuf != nullptr);
+    REQUIRE(last_seed != nullptr);
+
+    for (uint32_t s = 0; s < live; s++) {
+        spi_nand_flash_fill_buffer_seeded(wbuf, sz / sizeof(uint32_t), s);
+        REQUIRE(spi_nand_flash_write_sector(dev, wbuf, s) == ESP_OK);
+        last_seed[s] = s;
+    }
+    /* Write back the fill from the RAM cache, if any, before counting */
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+    REQUIRE(nand_reset_latency_stats(dev) == ESP_OK);
+
+    srand(0x5EEDu);
+    uint32_t seed = live;
+    for (int burst = 0; burst < 30; burst++) {
+        for (int i = 0; i < 100; i++) {
+            uint32_t s = (uint32_t)((unsigned)rand() % live);
+            spi_nand_flash_fill_buffer_seeded(wbuf, sz / sizeof(uint32_t), seed);
+            REQUIRE(spi_nand_flash_write_sector(dev, wbuf, s) == ESP_OK);
+            last_seed[s] = seed++;
+        }
+        /* Let the background collector catch up */
+        wait_gc_idle_check(dev);
+    }
+    nand_gc_stats_t gc_stats = {};
+    REQUIRE(nand_get_gc_stats(dev, &gc_stats) == ESP_OK);
+    REQUIRE(gc_stats.collections > 0u);
+    REQUIRE(gc_stats.gc_steps > 0u);
+
+    nand_latency_stats_t stats;
+    REQUIRE(nand_get_write_latency_stats(dev, &stats) == ESP_OK);
+#if CONFIG_NAND_FLASH_WRITE_CACHE
+    /* Only the writes that left the RAM cache reached the wear-levelling layer */
+    REQUIRE(stats.count > 0u);
+    REQUIRE(stats.count <= 30u * 100u);
+#else
+    REQUIRE(stats.count == 30u * 100u);
+#endif
+    uint32_t hist_count = 0;
+    for (int i = 0; i < NAND_LATENCY_HIST_BUCKETS; i++) {
+        hist_count += stats.hist[i];
+    }
+    REQUIRE(hist_count == stats.count);
+    REQUIRE(stats.min_us <= stats.total_us / stats.count);
+    REQUIRE(stats.total_us / stats.count <= stats.max_us);
+    REQUIRE(nand_latency_stats_percentile(&stats, 50) <= nand_latency_stats_percentile(&stats, 99));
+    REQUIRE(nand_latency_stats_percentile(&stats, 99) <= stats.max_us);
+
+    for (uint32_t s = 0; s < live; s++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, rbuf, s) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(rbuf, sz / sizeof(uint32_t), last_seed[s]) == 0);
+    }
+
+    free(wbuf);
+    free(rbuf);
+    free(last_seed);
+    destroy_ftl_dev(dev);
+}
+#endif // CONFIG_NAND_FLASH_BACKGROUND_GC && CONFIG_NAND_FLASH_LATENCY_STATS
+
+#if CONFIG_NAND_FLASH_WRITE_CACHE
+TEST_CASE("FTL write cache coalesces hot-sector rewrites and flushes them on sync and timeout",
+          "[ftl][gc][cache]")
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+    uint32_t sz = 0;
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+
+    uint8_t *wbuf = (uint8_t *)malloc(sz);
+    uint8_t *rbuf = (uint8_t *)malloc(sz * 4);
+    REQUIRE(wbuf != nullptr);
+    REQUIRE(rbuf != nullptr);
+
+    /* FAT-like pattern: four hot sectors rewritten over and over */
+    for (uint32_t i = 0; i < 400; i++) {
+        spi_nand_flash_fill_buffer_seeded(wbuf, sz / sizeof(uint32_t), 1000 + i);
+        REQUIRE(spi_nand_flash_write_sector(dev, wbuf, i % 4) == ESP_OK);
+    }
+    nand_write_cache_stats_t st;
+    REQUIRE(nand_get_write_cache_stats(dev, &st) == ESP_OK);
+    REQUIRE(st.write_misses == 4u);
+    REQUIRE(st.write_hits == 396u);
+    REQUIRE(st.writebacks <= 8u);
+
+    /* Reads see the cached data, both page by page and through read_pages */
+    REQUIRE(spi_nand_flash_read_pages(dev, rbuf, 0, 4) == ESP_OK);
+    for (uint32_t i = 0; i < 4; i++) {
+        REQUIRE(spi_nand_flash_check_buffer_seeded(rbuf + (size_t)i * sz, sz / sizeof(uint32_t), 1396 + i) == 0);
+    }
+
+    /* Sync writes everything back, a second sync has nothing left to do */
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+    REQUIRE(nand_get_write_cache_stats(dev, &st) == ESP_OK);
+    uint32_t writebacks = st.writebacks;
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+    REQUIRE(nand_get_write_cache_stats(dev, &st) == ESP_OK);
+    REQUIRE(st.writebacks == writebacks);
+
+    /* A trimmed sector must not come back from the cache */
+    REQUIRE(spi_nand_flash_write_sector(dev, wbuf, 1) == ESP_OK);
+    REQUIRE(spi_nand_flash_trim(dev, 1) == ESP_OK);
+    REQUIRE(spi_nand_flash_read_sector(dev, rbuf, 1) == ESP_OK);
+    for (uint32_t b = 0; b < sz; b++) {
+        REQUIRE(rbuf[b] == 0xFF);
+    }
+
+    /* Without a sync, the flush task writes the page back after the timeout */
+    REQUIRE(spi_nand_flash_write_sector(dev, wbuf, 2) == ESP_OK);
+    for (int i = 0; i < 3000; i++) {
+        REQUIRE(nand_get_write_cache_stats(dev, &st) == ESP_OK);
+        if (st.writebacks != writebacks) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    REQUIRE(st.writebacks == writebacks + 1);
+
+    free(wbuf);
+    free(rbuf);
+    destroy_ftl_dev(dev);
+}
+#endif // CONFIG_NAND_FLASH_WRITE_CACHE
+
+#if CONFIG_NAND_FLASH_FAST_MOUNT && CONFIG_NAND_ENABLE_STATS
+/* Mount the image in `path`, reporting the NAND reads it took */
+static spi_nand_flash_device_t *mount_ftl_image(const char *path, size_t *reads)
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev(FTL_TEST_FLASH_SIZE, 0, path);
+    size_t write_ops, erase_ops, read_bytes, write_bytes;
+    nand_emul_get_stats(dev, reads, &write_ops, &erase_ops, &read_bytes, &write_bytes);
+    return dev;
+}
+
+/* Snapshot of a live image, as left by a power cut */
+static void copy_ftl_image(const char *src, const char *dst)
+{
+    FILE *in = fopen(src, "rb");
+    FILE *out = fopen(dst, "wb");
+    REQUIRE(in != nullptr);
+    REQUIRE(out != nullptr);
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        REQUIRE(fwrite(chunk, 1, n, out) == n);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+TEST_CASE("FTL mount reads the checkpoint after a clean shutdown, searches the journal after a power cut",
+          "[ftl][mount]")
+{
+    char image[] = "/tmp/nand-ftl-mount-XXXXXX";
+    char cut_image[] = "/tmp/nand-ftl-mount-cut-XXXXXX";
+    size_t reads, clean_reads;
+    make_ftl_image(image);
+    make_ftl_image(cut_image);
+
+    /* Format, fill half of the device with some rewrites, shut down cleanly */
+    spi_nand_flash_device_t *dev = mount_ftl_image(image, &reads);
+    uint32_t sectors = 0, sz = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+    const uint32_t live = sectors / 2;
+    for (uint32_t i = 0; i < live; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, i) == ESP_OK);
+    }
+    for (uint32_t i = 0; i < live; i += 3) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i + 1000000u);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, i) == ESP_OK);
+    }
+    destroy_ftl_dev(dev);
+
+    /* Clean remount: the checkpoint is used */
+    dev = mount_ftl_image(image, &clean_reads);
+    for (uint32_t i = 0; i < live; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), i % 3 ? i : i + 1000000u) == 0);
+    }
+
+    /* Modify the journal after a sync, and cut the power: the checkpoint is stale and must not be used */
+    spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), 42);
+    REQUIRE(spi_nand_flash_write_sector(dev, buf, 1) == ESP_OK);
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+    REQUIRE(spi_nand_flash_gc(dev) == ESP_OK);
+    copy_ftl_image(image, cut_image);
+    destroy_ftl_dev(dev);
+    remove(image);
+
+    dev = mount_ftl_image(cut_image, &reads);
+    REQUIRE(spi_nand_flash_read_sector(dev, buf, 1) == ESP_OK);
+    REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), 42) == 0);
+    for (uint32_t i = 2; i < live; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), i % 3 ? i : i + 1000000u) == 0);
+    }
+    free(buf);
+    destroy_ftl_dev(dev);
+    remove(cut_image);
+
+    /* A few page reads whatever the size: the checkpoint record, the checkpoint page at the root and the group after
+     * it. The search cost depends on where the journal ends and grows with the number of blocks; host_bench compares
+     * both mounts over several device sizes. */
+    REQUIRE(clean_reads <= 64u);
+}
+#endif // CONFIG_NAND_FLASH_FAST_MOUNT && CONFIG_NAND_ENABLE_STATS
+
+#if CONFIG_NAND_ENABLE_STATS
+/* Random overwrites of half the device then a sequential read back, on the emulator timing model */
+static void run_timed_workload(spi_nand_flash_io_mode_t io_mode, nand_emul_perf_stats_t *write_stats,
+                               nand_emul_perf_stats_t *read_stats)
+{
+    nand_file_mmap_emul_config_t emul = {"", FTL_TEST_FLASH_SIZE, /*keep_dump=*/false};
+    spi_nand_flash_config_t cfg = {&emul, 0, io_mode, 0};
+    spi_nand_flash_device_t *dev = nullptr;
+    REQUIRE(spi_nand_flash_init_device(&cfg, &dev) == ESP_OK);
+
+    uint32_t sectors = 0, sz = 0, num_blocks = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_block_num(dev, &num_blocks) == ESP_OK);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    uint32_t *erase_counts = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    REQUIRE(buf != nullptr);
+    REQUIRE(erase_counts != nullptr);
+
+    nand_emul_clear_stats(dev);
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < 3000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t sector = (seed >> 8) % (sectors / 2);
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), sector);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, sector) == ESP_OK);
+    }
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+    REQUIRE(nand_emul_get_perf_stats(dev, write_stats) == ESP_OK);
+
+    REQUIRE(nand_emul_get_erase_counts(dev, erase_counts, num_blocks) == ESP_OK);
+    uint32_t erase_sum = 0;
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        erase_sum += erase_counts[b];
+    }
+    REQUIRE(erase_sum == write_stats->block_erases);
+
+    nand_emul_clear_stats(dev);
+    for (uint32_t i = 0; i < 256; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+    }
+    REQUIRE(nand_emul_get_perf_stats(dev, read_stats) == ESP_OK);
+
+    free(erase_counts);
+    free(buf);
+    destroy_ftl_dev(dev);
+}
+
+TEST_CASE("Emulator timing model: simulated time, write amplification and erase counts",
+          "[ftl][emul]")
+{
+    nand_emul_perf_stats_t sio_write, sio_read, qio_write, qio_read;
+    run_timed_workload(SPI_NAND_IO_MODE_SIO, &sio_write, &sio_read);
+    run_timed_workload(SPI_NAND_IO_MODE_QIO, &qio_write, &qio_read);
+
+    REQUIRE(sio_write.host_page_writes == 3000);
+    REQUIRE(sio_write.page_programs > 0);
+    REQUIRE(sio_write.block_erases > 0);
+    REQUIRE(nand_emul_write_amplification(&sio_write) > 0.0f);
+    // Every program costs at least the array program time of the emulated chip (630 us)
+    REQUIRE(sio_write.elapsed_us >= (uint64_t)sio_write.page_programs * 630u + sio_write.bus_us);
+
+    // Reads are dominated by moving 2 KiB pages over the bus, on 4 lines in QIO instead of 1
+    REQUIRE(sio_read.page_reads >= 256);
+    REQUIRE(qio_read.bus_us * 3 < sio_read.bus_us);
+    REQUIRE(qio_read.elapsed_us < sio_read.elapsed_us);
+}
+#endif // CONFIG_NAND_ENABLE_STATS
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_ENABLE_STATS
+TEST_CASE("FTL erase counts match the emulator and persist across remounts and chip erases",
+          "[ftl][wear]")
+{
+    char image[] = "/tmp/nand-ftl-wear-XXXXXX";
+    make_ftl_image(image);
+    spi_nand_flash_device_t *dev = make_ftl_dev(FTL_TEST_FLASH_SIZE, 0, image);
+
+    uint32_t sectors = 0, sz = 0, num_blocks = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_block_num(dev, &num_blocks) == ESP_OK);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    uint32_t *counts = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    uint32_t *emul_counts = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    REQUIRE(buf != nullptr);
+    REQUIRE(counts != nullptr);
+    REQUIRE(emul_counts != nullptr);
+
+    /* Cold data in half of the device, then a small hot set rewritten many times */
+    const uint32_t cold = sectors / 2;
+    for (uint32_t i = 0; i < cold; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, i) == ESP_OK);
+    }
+    for (uint32_t i = 0; i < 20000; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, cold + i % 32) == ESP_OK);
+        if (i % 1000 == 999) {
+            REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+        }
+    }
+
+    /* Every erase of the chip is accounted for */
+    nand_wear_stats_t stats = {};
+    stats.erase_counts = counts;
+    stats.erase_counts_len = num_blocks;
+    REQUIRE(nand_get_wear_stats(dev, &stats) == ESP_OK);
+    REQUIRE(nand_emul_get_erase_counts(dev, emul_counts, num_blocks) == ESP_OK);
+    uint64_t emul_total = 0;
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        REQUIRE(counts[b] == emul_counts[b]);
+        emul_total += emul_counts[b];
+    }
+    REQUIRE(stats.num_blocks == num_blocks);
+    REQUIRE(stats.bad_blocks == 0);
+    REQUIRE(stats.total_erases == emul_total);
+    REQUIRE(stats.max_erase_count >= stats.avg_erase_count);
+    REQUIRE(stats.avg_erase_count >= stats.min_erase_count);
+    destroy_ftl_dev(dev);
+
+    /* The counts are saved on deinit and reloaded at mount */
+    dev = make_ftl_dev(FTL_TEST_FLASH_SIZE, 0, image);
+    uint32_t *reloaded = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    REQUIRE(reloaded != nullptr);
+    nand_wear_stats_t after = {};
+    after.erase_counts = reloaded;
+    after.erase_counts_len = num_blocks;
+    REQUIRE(nand_get_wear_stats(dev, &after) == ESP_OK);
+    // Deinit may still erase blocks while synchronising, and the last block holds the saved counts
+    for (uint32_t b = 0; b + 1 < num_blocks; b++) {
+        REQUIRE(reloaded[b] >= counts[b]);
+    }
+    for (uint32_t i = 0; i < cold; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), i) == 0);
+    }
+
+    /* A chip erase wipes the data, not the counts */
+    REQUIRE(spi_nand_erase_chip(dev) == ESP_OK);
+    destroy_ftl_dev(dev);
+    dev = make_ftl_dev(FTL_TEST_FLASH_SIZE, 0, image);
+    REQUIRE(nand_get_wear_stats(dev, &after) == ESP_OK);
+    REQUIRE(after.min_erase_count >= 1);
+    for (uint32_t b = 0; b + 1 < num_blocks; b++) {
+        REQUIRE(reloaded[b] >= counts[b] + 1);
+    }
+    destroy_ftl_dev(dev);
+    remove(image);
+
+    free(reloaded);
+    free(emul_counts);
+    free(counts);
+    free(buf);
+}
+#endif // CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_ENABLE_STATS
+
+#if CONFIG_NAND_FLASH_ECC_SCRUB && CONFIG_NAND_ENABLE_STATS
+static nand_scrub_stats_t wait_scrub_passes(spi_nand_flash_device_t *dev, uint32_t passes)
+{
+    nand_scrub_stats_t stats = {};
+    for (int i = 0; i < 3000; i++) {
+        REQUIRE(nand_get_scrub_stats(dev, &stats) == ESP_OK);
+        if (stats.passes >= passes) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    REQUIRE(stats.passes >= passes);
+    return stats;
+}
+
+TEST_CASE("FTL ECC scrubber refreshes pages that reached the data refresh threshold",
+          "[ftl][scrub]")
+{
+    spi_nand_flash_device_t *dev = make_ftl_dev();
+
+    uint32_t sectors = 0, sz = 0, block_size = 0, num_blocks = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_block_size(dev, &block_size) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_block_num(dev, &num_blocks) == ESP_OK);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+
+    const uint32_t live = 512;
+    for (uint32_t i = 0; i < live; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), i);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, i) == ESP_OK);
+    }
+    REQUIRE(spi_nand_flash_sync(dev) == ESP_OK);
+
+    /* Every page now needs 4-6 corrected bits to be read, which reaches the default refresh threshold */
+    const uint32_t num_pages = num_blocks * (block_size / sz);
+    for (uint32_t page = 0; page < num_pages; page++) {
+        REQUIRE(nand_emul_inject_ecc_status(dev, page, NAND_ECC_4_TO_6_BITS_CORRECTED) == ESP_OK);
+    }
+
+    /* Two passes make sure that one started after the injection */
+    nand_scrub_stats_t before = {};
+    REQUIRE(nand_get_scrub_stats(dev, &before) == ESP_OK);
+    nand_scrub_stats_t stats = wait_scrub_passes(dev, before.passes + 2);
+    REQUIRE(stats.num_sectors == sectors);
+    REQUIRE(stats.pages_checked - before.pages_checked >= live);
+    /* Live pages moved by garbage collection in between are fresh copies, and are not refreshed */
+    REQUIRE(stats.pages_refreshed - before.pages_refreshed > 0);
+    REQUIRE(stats.pages_refreshed - before.pages_refreshed <= live);
+    REQUIRE(stats.uncorrectable == before.uncorrectable);
+
+    /* Nothing is left to refresh */
+    nand_scrub_stats_t after = wait_scrub_passes(dev, stats.passes + 2);
+    REQUIRE(after.pages_refreshed == stats.pages_refreshed);
+
+    for (uint32_t i = 0; i < live; i++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), i) == 0);
+    }
+
+    free(buf);
+    destroy_ftl_dev(dev);
+}
+#endif // CONFIG_NAND_FLASH_ECC_SCRUB && CONFIG_NAND_ENABLE_STATS
+
+static void open_partitions(const char *path, spi_nand_flash_device_t **parts)
+{
+    ftl_test_config_t conf;
+    make_ftl_config(&conf, FTL_TEST_FLASH_SIZE, 0, path);
+    /* A small, often rewritten log area with a large GC reserve, then the rest for static assets */
+    const spi_nand_flash_partition_config_t layout[2] = {{32, 10}, {0, 0}};
+    REQUIRE(spi_nand_flash_init_partitions(&conf.cfg, layout, 2, parts) == ESP_OK);
+}
+
+TEST_CASE("FTL partitions are independent wear-levelled regions of one chip", "[ftl][partitions]")
+{
+    char image[] = "/tmp/nand-ftl-partitions-XXXXXX";
+    make_ftl_image(image);
+    spi_nand_flash_device_t *parts[2] = {};
+    open_partitions(image, parts);
+
+    uint32_t log_blocks = 0, asset_blocks = 0, log_sectors = 0, asset_sectors = 0, sz = 0;
+    REQUIRE(spi_nand_flash_get_block_num(parts[0], &log_blocks) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_block_num(parts[1], &asset_blocks) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_capacity(parts[0], &log_sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_capacity(parts[1], &asset_sectors) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(parts[0], &sz) == ESP_OK);
+    REQUIRE(log_blocks == 32);
+    REQUIRE(asset_blocks > log_blocks);
+    REQUIRE(log_sectors > 0);
+    REQUIRE(asset_sectors > 0);
+    uint8_t *buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+
+    /* The same logical sectors hold different data in each partition */
+    const uint32_t assets = asset_sectors / 2;
+    for (uint32_t i = 0; i < assets; i++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), 100000 + i);
+        REQUIRE(spi_nand_flash_write_sector(parts[1], buf, i) == ESP_OK);
+    }
+    REQUIRE(spi_nand_flash_sync(parts[1]) == ESP_OK);
+    const uint32_t log = log_sectors / 2;
+    for (uint32_t round = 0; round < 20; round++) {
+        for (uint32_t i = 0; i < log; i++) {
+            spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), round * 1000 + i);
+            REQUIRE(spi_nand_flash_write_sector(parts[0], buf, i) == ESP_OK);
+        }
+    }
+    for (uint32_t i = 0; i < log; i++) {
+        REQUIRE(spi_nand_flash_read_sector(parts[0], buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), 19000 + i) == 0);
+    }
+
+    /* Erasing the log partition and remounting leaves the assets untouched */
+    REQUIRE(spi_nand_erase_chip(parts[0]) == ESP_OK);
+    REQUIRE(spi_nand_flash_deinit_device(parts[0]) == ESP_OK);
+    REQUIRE(spi_nand_flash_deinit_device(parts[1]) == ESP_OK);
+    open_partitions(image, parts);
+
+    for (uint32_t i = 0; i < assets; i++) {
+        REQUIRE(spi_nand_flash_read_sector(parts[1], buf, i) == ESP_OK);
+        REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), 100000 + i) == 0);
+    }
+    REQUIRE(spi_nand_flash_read_sector(parts[0], buf, 0) == ESP_OK);
+    for (uint32_t k = 0; k < sz; k++) {
+        REQUIRE(buf[k] == 0xFF);
+    }
+
+    free(buf);
+    REQUIRE(spi_nand_flash_deinit_device(parts[1]) == ESP_OK);
+    REQUIRE(spi_nand_flash_deinit_device(parts[0]) == ESP_OK);
+    remove(image);
+}
+
+TEST_CASE("FTL partitions that do not fit on the chip are rejected", "[ftl][partitions]")
+{
+    ftl_test_config_t conf;
+    make_ftl_config(&conf);
+    spi_nand_flash_device_t *parts[2] = {};
+
+    const spi_nand_flash_partition_config_t too_large[2] = {{100, 0}, {100, 0}};
+    REQUIRE(spi_nand_flash_init_partitions(&conf.cfg, too_large, 2, parts) == ESP_ERR_INVALID_SIZE);
+    const spi_nand_flash_partition_config_t nothing_left[2] = {{4096, 0}, {0, 0}};
+    REQUIRE(spi_nand_flash_init_partitions(&conf.cfg, nothing_left, 2, parts) == ESP_ERR_INVALID_SIZE);
+    /* Smaller than the blocks the journal keeps in reserve */
+    const spi_nand_flash_partition_config_t too_small[2] = {{2, 0}, {0, 0}};
+    REQUIRE(spi_nand_flash_init_partitions(&conf.cfg, too_small, 2, parts) == ESP_ERR_INVALID_SIZE);
+}
+
+TEST_CASE("FTL init of a chip too small for the journal fails and returns no handle", "[ftl][info]")
+{
+    /* Two 128 KiB blocks, fewer than the journal keeps in reserve */
+    ftl_test_config_t conf;
+    make_ftl_config(&conf, 2 * 128 * 1024);
+    spi_nand_flash_device_t *dev = nullptr;
+    REQUIRE(spi_nand_flash_init_device(&conf.cfg, &dev) == ESP_ERR_INVALID_SIZE);
+    REQUIRE(dev == nullptr);
+}
+
 /* -------------------------------------------------------------------------
  * Group 10: Single-sector hammer — one sector written thousands of times
  * ---------------------------------------------------------------------- */
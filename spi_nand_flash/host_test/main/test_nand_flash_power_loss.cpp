@@ -0,0 +1,320 @@
+/*
+ * SPDX-FileCopyrightText: 2026 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Power-loss tests for the wear-levelling layer, on the fault injection of the mmap emulator.
+ *
+ * Each trial arms a power cut (or a program/erase failure) after a random number of chip operations, runs random
+ * sector writes and syncs until it hits, then remounts the image and checks that:
+ *   - every sector synced before the cut reads back the data synced, or data written after it;
+ *   - sectors written since the last sync read back one of the versions written since then, or the synced one;
+ *   - nothing returns an error.
+ * The trials run on the same image, so recovery also starts from states left by earlier recoveries.
+ *
+ * NAND_POWER_LOSS_TRIALS and NAND_POWER_LOSS_SEED in the environment change the number of power cuts and the seed,
+ * for longer runs when working on the recovery paths (dhara_journal_resume(), try_recover() in map.c).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "spi_nand_flash.h"
+#include "spi_nand_flash_test_helpers.h"
+#include "nand_linux_mmap_emul.h"
+#include "sdkconfig.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if CONFIG_NAND_ENABLE_STATS
+
+#define POWER_LOSS_IMAGE            "/tmp/nand-ftl-power-loss-XXXXXX"  // mkstemp() templates
+#define POWER_LOSS_TRIM_IMAGE       "/tmp/nand-ftl-torn-trim-XXXXXX"
+#define POWER_LOSS_FLASH_SIZE       ((size_t)8u * 1024u * 1024u)
+#define POWER_LOSS_DEFAULT_TRIALS   150
+#define POWER_LOSS_PROGRAM_FAILS    6   // Each one retires a block for good
+#define POWER_LOSS_MAX_OPS          400 // Chip operations before the fault, at most
+#define POWER_LOSS_MAX_WRITES       600 // Sector writes per trial, at most
+#define POWER_LOSS_MAX_PENDING      64  // Writes between two syncs, at most
+#define POWER_LOSS_VERSIONS         4096
+#define POWER_LOSS_NEVER_WRITTEN    UINT32_MAX
+
+typedef struct {
+    uint32_t sector;
+    uint32_t version;
+} power_loss_write_t;
+
+// What the sectors are expected to hold: the version synced last, and the writes done since
+typedef struct {
+    uint32_t sectors;
+    uint32_t sector_size;
+    uint32_t *synced;
+    uint32_t *last_version;
+    power_loss_write_t pending[POWER_LOSS_MAX_PENDING];
+    uint32_t num_pending;
+    uint32_t rng;
+} power_loss_model_t;
+
+static uint32_t power_loss_random(power_loss_model_t *model)
+{
+    model->rng ^= model->rng << 13;
+    model->rng ^= model->rng >> 17;
+    model->rng ^= model->rng << 5;
+    return model->rng;
+}
+
+static uint32_t power_loss_env(const char *name, uint32_t default_value)
+{
+    const char *value = getenv(name);
+    return value != nullptr ? (uint32_t)strtoul(value, nullptr, 0) : default_value;
+}
+
+/* Create an empty image file with a unique name from a mkstemp() template, so that several test apps can run at once */
+static void power_loss_new_image(char *path)
+{
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+}
+
+/* An empty image name mounts a new temporary image */
+static spi_nand_flash_device_t *power_loss_mount(const char *image)
+{
+    nand_file_mmap_emul_config_t emul = {"", POWER_LOSS_FLASH_SIZE, /*keep_dump=*/image[0] != '\0'};
+    strncpy(emul.flash_file_name, image, sizeof(emul.flash_file_name) - 1);
+    spi_nand_flash_config_t cfg = {&emul, 0, SPI_NAND_IO_MODE_SIO, 0};
+    spi_nand_flash_device_t *dev = nullptr;
+    REQUIRE(spi_nand_flash_init_device(&cfg, &dev) == ESP_OK);
+    return dev;
+}
+
+static bool power_loss_holds(const power_loss_model_t *model, const uint8_t *buf, uint32_t sector, uint32_t version)
+{
+    if (version == POWER_LOSS_NEVER_WRITTEN) {
+        for (uint32_t i = 0; i < model->sector_size; i++) {
+            if (buf[i] != 0xFF) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return spi_nand_flash_check_buffer_seeded(buf, model->sector_size / sizeof(uint32_t),
+            sector * POWER_LOSS_VERSIONS + version) == 0;
+}
+
+/* Check every sector after a remount, and take what survived as the new synced state */
+static void power_loss_verify(spi_nand_flash_device_t *dev, power_loss_model_t *model, uint8_t *buf)
+{
+    for (uint32_t sector = 0; sector < model->sectors; sector++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, sector) == ESP_OK);
+        uint32_t found = model->synced[sector];
+        bool ok = power_loss_holds(model, buf, sector, found);
+        for (uint32_t i = 0; i < model->num_pending && !ok; i++) {
+            if (model->pending[i].sector == sector) {
+                found = model->pending[i].version;
+                ok = power_loss_holds(model, buf, sector, found);
+            }
+        }
+        if (!ok) {
+            FAIL("power loss: sector " << sector << " lost its synced data");
+        }
+        model->synced[sector] = found;
+        model->last_version[sector] = found;
+    }
+    model->num_pending = 0;
+}
+
+static void power_loss_commit(power_loss_model_t *model)
+{
+    for (uint32_t i = 0; i < model->num_pending; i++) {
+        model->synced[model->pending[i].sector] = model->pending[i].version;
+    }
+    model->num_pending = 0;
+}
+
+/* Sync, and count the pending writes as synced if the power was still there at the end */
+static void power_loss_sync(spi_nand_flash_device_t *dev, power_loss_model_t *model, bool power_cut)
+{
+    esp_err_t ret = spi_nand_flash_sync(dev);
+    if (power_cut && nand_emul_fault_hit(dev)) {
+        // Whatever was in flight when the power went off has no meaningful result
+        return;
+    }
+    REQUIRE(ret == ESP_OK);
+    power_loss_commit(model);
+}
+
+/* Random writes and syncs until the fault hits, or POWER_LOSS_MAX_WRITES */
+static void power_loss_run_trial(spi_nand_flash_device_t *dev, power_loss_model_t *model, uint8_t *buf,
+                                 const nand_emul_fault_config_t *fault)
+{
+    const bool power_cut = fault->type == NAND_EMUL_FAULT_POWER_CUT;
+    const uint32_t sync_every = 1 + power_loss_random(model) % 16;
+
+    REQUIRE(nand_emul_inject_fault(dev, fault) == ESP_OK);
+    for (uint32_t w = 0; w < POWER_LOSS_MAX_WRITES && !(power_cut && nand_emul_fault_hit(dev)); w++) {
+        const uint32_t sector = power_loss_random(model) % model->sectors;
+        const uint32_t version = (model->last_version[sector] + 1) % POWER_LOSS_VERSIONS;
+        spi_nand_flash_fill_buffer_seeded(buf, model->sector_size / sizeof(uint32_t),
+                                          sector * POWER_LOSS_VERSIONS + version);
+
+        esp_err_t ret = spi_nand_flash_write_sector(dev, buf, sector);
+        REQUIRE((ret == ESP_OK || (power_cut && nand_emul_fault_hit(dev))));
+        model->pending[model->num_pending].sector = sector;
+        model->pending[model->num_pending].version = version;
+        model->num_pending++;
+        model->last_version[sector] = version;
+        if (model->num_pending == POWER_LOSS_MAX_PENDING || (w + 1) % sync_every == 0) {
+            power_loss_sync(dev, model, power_cut);
+            if (model->num_pending == POWER_LOSS_MAX_PENDING) {
+                break;
+            }
+        }
+    }
+    if (!power_cut) {
+        power_loss_sync(dev, model, false);
+    }
+}
+
+TEST_CASE("FTL keeps synced data across power cuts and program failures at random points", "[ftl][power-loss]")
+{
+    char image[] = POWER_LOSS_IMAGE;
+    power_loss_new_image(image);
+    spi_nand_flash_device_t *dev = power_loss_mount(image);
+
+    power_loss_model_t model = {};
+    uint32_t capacity = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &capacity) == ESP_OK);
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &model.sector_size) == ESP_OK);
+    // Three quarters of the capacity, so that garbage collection runs all the time
+    model.sectors = capacity * 3 / 4;
+    model.synced = (uint32_t *)malloc(model.sectors * sizeof(uint32_t));
+    model.last_version = (uint32_t *)malloc(model.sectors * sizeof(uint32_t));
+    uint8_t *buf = (uint8_t *)malloc(model.sector_size);
+    REQUIRE(model.synced != nullptr);
+    REQUIRE(model.last_version != nullptr);
+    REQUIRE(buf != nullptr);
+    for (uint32_t i = 0; i < model.sectors; i++) {
+        model.synced[i] = POWER_LOSS_NEVER_WRITTEN;
+        model.last_version[i] = POWER_LOSS_NEVER_WRITTEN;
+    }
+    model.rng = power_loss_env("NAND_POWER_LOSS_SEED", 0);
+    if (model.rng == 0) {
+        // xorshift32 must not start from 0
+        model.rng = 0x1234567;
+    }
+    const uint32_t power_cuts = power_loss_env("NAND_POWER_LOSS_TRIALS", POWER_LOSS_DEFAULT_TRIALS);
+
+    for (uint32_t trial = 0; trial < power_cuts + POWER_LOSS_PROGRAM_FAILS; trial++) {
+        power_loss_verify(dev, &model, buf);
+
+        nand_emul_fault_config_t fault = {};
+        fault.type = trial < power_cuts ? NAND_EMUL_FAULT_POWER_CUT : NAND_EMUL_FAULT_PROGRAM_FAIL;
+        fault.after_ops = power_loss_random(&model) % POWER_LOSS_MAX_OPS;
+        fault.torn = (trial & 1) != 0;
+        fault.seed = power_loss_random(&model);
+        power_loss_run_trial(dev, &model, buf, &fault);
+
+        const bool power_cut = fault.type == NAND_EMUL_FAULT_POWER_CUT && nand_emul_fault_hit(dev);
+        esp_err_t ret = spi_nand_flash_deinit_device(dev);
+        REQUIRE((ret == ESP_OK || power_cut));
+        dev = power_loss_mount(image);
+    }
+    power_loss_verify(dev, &model, buf);
+
+    free(buf);
+    free(model.last_version);
+    free(model.synced);
+    REQUIRE(spi_nand_flash_deinit_device(dev) == ESP_OK);
+    remove(image);
+}
+
+/* Total of the page programs and block erases, the chip operations counted by nand_emul_fault_config_t::after_ops */
+static uint32_t power_loss_chip_ops(spi_nand_flash_device_t *dev)
+{
+    nand_emul_perf_stats_t perf;
+    REQUIRE(nand_emul_get_perf_stats(dev, &perf) == ESP_OK);
+    return perf.page_programs + perf.block_erases;
+}
+
+#if !CONFIG_NAND_FLASH_WRITE_CACHE
+/* The sectors must reach the journal one write at a time, to tell which write programs a checkpoint */
+TEST_CASE("FTL trim_range garbage-collects across a torn checkpoint", "[ftl][power-loss][trim]")
+{
+    uint32_t sz = 0;
+    uint8_t *buf = nullptr;
+
+    /* On a new image, find the write that completes the second checkpoint group: it programs the user page, then
+     * the checkpoint page, last. The first write of a mount may program more (fast mount record, block erase). */
+    spi_nand_flash_device_t *dev = power_loss_mount("");
+    REQUIRE(spi_nand_flash_get_sector_size(dev, &sz) == ESP_OK);
+    buf = (uint8_t *)malloc(sz);
+    REQUIRE(buf != nullptr);
+    uint32_t checkpoints = 0, group_end = 0, ckpt_ops = 0;
+    for (uint32_t s = 0; checkpoints < 2; s++) {
+        nand_emul_perf_stats_t before, after;
+        REQUIRE(nand_emul_get_perf_stats(dev, &before) == ESP_OK);
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), s);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, s) == ESP_OK);
+        REQUIRE(nand_emul_get_perf_stats(dev, &after) == ESP_OK);
+        if (s > 0 && after.page_programs - before.page_programs == 2) {
+            checkpoints++;
+            group_end = s;
+            ckpt_ops = power_loss_chip_ops(dev);
+        }
+    }
+    REQUIRE(spi_nand_flash_deinit_device(dev) == ESP_OK);
+
+    /* Same writes on the kept image, with the power cut half way through that checkpoint program */
+    char image[] = POWER_LOSS_TRIM_IMAGE;
+    power_loss_new_image(image);
+    dev = power_loss_mount(image);
+    nand_emul_fault_config_t fault = {};
+    fault.type = NAND_EMUL_FAULT_POWER_CUT;
+    fault.after_ops = ckpt_ops - 1;
+    fault.torn = true;
+    fault.seed = 1;
+    REQUIRE(nand_emul_inject_fault(dev, &fault) == ESP_OK);
+    for (uint32_t s = 0; s <= group_end; s++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), s);
+        spi_nand_flash_write_sector(dev, buf, s);
+    }
+    REQUIRE(nand_emul_fault_hit(dev));
+    spi_nand_flash_deinit_device(dev);
+
+    /* The torn page stays in the journal. Write three quarters of the capacity, below the garbage collection
+     * threshold, then trim it all: the deletions fill the journal, and trim garbage collection runs from the tail,
+     * through the first group and the torn one. */
+    dev = power_loss_mount(image);
+    uint32_t capacity = 0;
+    REQUIRE(spi_nand_flash_get_capacity(dev, &capacity) == ESP_OK);
+    const uint32_t start = group_end + 1;
+    const uint32_t count = capacity * 3 / 4;
+    for (uint32_t s = start; s < start + count; s++) {
+        spi_nand_flash_fill_buffer_seeded(buf, sz / sizeof(uint32_t), s);
+        REQUIRE(spi_nand_flash_write_sector(dev, buf, s) == ESP_OK);
+    }
+    REQUIRE(spi_nand_flash_trim_range(dev, start, count) == ESP_OK);
+
+    for (uint32_t s = start; s < start + count; s++) {
+        REQUIRE(spi_nand_flash_read_sector(dev, buf, s) == ESP_OK);
+        for (uint32_t k = 0; k < sz; k++) {
+            REQUIRE(buf[k] == 0xFF);
+        }
+    }
+    /* The first group was committed before the cut, and was relocated by the garbage collection */
+    REQUIRE(spi_nand_flash_read_sector(dev, buf, 0) == ESP_OK);
+    REQUIRE(spi_nand_flash_check_buffer_seeded(buf, sz / sizeof(uint32_t), 0) == 0);
+
+    free(buf);
+    REQUIRE(spi_nand_flash_deinit_device(dev) == ESP_OK);
+    remove(image);
+}
+#endif // !CONFIG_NAND_FLASH_WRITE_CACHE
+
+#endif // CONFIG_NAND_ENABLE_STATS
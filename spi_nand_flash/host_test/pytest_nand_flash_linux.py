@@ -12,6 +12,21 @@ from pathlib import Path
     not bool(glob.glob(f'{Path(__file__).parent.absolute()}/build*/')),
     reason="Skip the idf version that not build"
 )
+@pytest.mark.parametrize(
+    'config',
+    [
+        'default',
+        'background_gc',
+        'map_cache',
+        'write_cache',
+        'fast_mount',
+        'erase_counts',
+        'scrub',
+        'compact_meta',
+        'all',
+    ],
+    indirect=True,
+)
 @idf_parametrize('target', ['linux'], indirect=['target'])
-def test_nand_flash_linux(dut: Dut) -> None:
+def test_nand_flash_linux(dut: Dut, config: str) -> None:
     dut.expect_exact('All tests passed', timeout=120)
@@ -136,6 +136,18 @@ extern "C" {
  */
 #define ESP_BLOCKDEV_CMD_COPY_PAGE                  (ESP_BLOCKDEV_CMD_NAND_BASE + 7)
 
+/** @brief Get the erase counts of the blocks (wear-levelling block device, CONFIG_NAND_FLASH_ERASE_COUNTS)
+ *
+ * See nand_get_wear_stats().
+ *
+ * @code{c}
+ * esp_blockdev_cmd_arg_wear_stats_t wear_stats = { .erase_counts = NULL, .erase_counts_len = 0 };
+ * esp_err_t ret = wl_bdl->ops->ioctl(wl_bdl, ESP_BLOCKDEV_CMD_GET_WEAR_STATS, &wear_stats);
+ * printf("Erase counts: min %" PRIu32 ", max %" PRIu32 "\n", wear_stats.min_erase_count, wear_stats.max_erase_count);
+ * @endcode
+ */
+#define ESP_BLOCKDEV_CMD_GET_WEAR_STATS             (ESP_BLOCKDEV_CMD_NAND_BASE + 8)
+
 /** @} */
 
 //=============================================================================
@@ -197,6 +209,13 @@ typedef struct {
     uint32_t dst_page;                              /*!< IN: destination page number */
 } esp_blockdev_cmd_arg_copy_page_t;
 
+/**
+ * @brief Block wear statistics
+ *
+ * Used with @ref ESP_BLOCKDEV_CMD_GET_WEAR_STATS.
+ */
+typedef nand_wear_stats_t esp_blockdev_cmd_arg_wear_stats_t;
+
 //=============================================================================
 // BLOCK DEVICE CREATION FUNCTIONS
 //=============================================================================
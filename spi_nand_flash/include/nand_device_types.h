@@ -54,6 +54,62 @@ typedef struct {
 #endif
 } nand_flash_geometry_t;
 
+/** @brief Chip operations whose busy time is tracked by the driver */
+typedef enum {
+    NAND_LATENCY_OP_READ = 0,               /*!< PAGE READ: array to cache register */
+    NAND_LATENCY_OP_PROGRAM,                /*!< PROGRAM EXECUTE: cache register to array */
+    NAND_LATENCY_OP_ERASE,                  /*!< BLOCK ERASE */
+    NAND_LATENCY_OP_MAX
+} nand_latency_op_t;
+
+#define NAND_LATENCY_HIST_BUCKETS 16        /*!< Number of log2 buckets in nand_latency_stats_t::hist */
+
+/** @brief Busy-time statistics of one chip operation (see CONFIG_NAND_FLASH_LATENCY_STATS) */
+typedef struct {
+    uint32_t count;                         /*!< Number of operations recorded */
+    uint32_t min_us;                        /*!< Shortest busy time in microseconds */
+    uint32_t max_us;                        /*!< Longest busy time in microseconds */
+    uint64_t total_us;                      /*!< Sum of all busy times in microseconds */
+    uint32_t hist[NAND_LATENCY_HIST_BUCKETS]; /*!< hist[i] counts busy times in [2^i, 2^(i+1)) us, hist[0] also counts 0 us; the last bucket is open-ended */
+} nand_latency_stats_t;
+
+/** @brief Counters of the RAM write-back page cache (see CONFIG_NAND_FLASH_WRITE_CACHE) */
+typedef struct {
+    uint32_t read_hits;                     /*!< Pages read from the cache instead of the flash */
+    uint32_t write_hits;                    /*!< Writes of a page that was already cached */
+    uint32_t write_misses;                  /*!< Writes that had to allocate a cache entry */
+    uint32_t writebacks;                    /*!< Pages written to the wear-levelling layer (eviction, sync or timeout) */
+} nand_write_cache_stats_t;
+
+/** @brief Block wear statistics (see CONFIG_NAND_FLASH_ERASE_COUNTS). Bad blocks are left out of the figures. */
+typedef struct {
+    uint32_t *erase_counts;                 /*!< [in] Optional array receiving the erase count of every block, or NULL */
+    uint32_t erase_counts_len;              /*!< [in] Number of entries of erase_counts, at most num_blocks are filled */
+    uint32_t num_blocks;                    /*!< Number of blocks of the chip */
+    uint32_t bad_blocks;                    /*!< Number of bad blocks */
+    uint32_t min_erase_count;               /*!< Lowest erase count of a good block */
+    uint32_t max_erase_count;               /*!< Highest erase count of a good block */
+    uint32_t avg_erase_count;               /*!< Mean erase count of the good blocks, rounded down */
+    uint64_t total_erases;                  /*!< Sum of the erase counts of the good blocks */
+} nand_wear_stats_t;
+
+/** @brief Counters of the background garbage collection task (see CONFIG_NAND_FLASH_BACKGROUND_GC) */
+typedef struct {
+    uint32_t idle_checks;                   /*!< Times the task found the device idle and was done collecting by the end of its turn */
+    uint32_t collections;                   /*!< Collections started because the headroom dropped below the low watermark */
+    uint64_t gc_steps;                      /*!< Garbage collection steps (journal pages reclaimed or relocated) */
+} nand_gc_stats_t;
+
+/** @brief Progress and counters of the background ECC scrubber (see CONFIG_NAND_FLASH_ECC_SCRUB) */
+typedef struct {
+    uint32_t passes;                        /*!< Completed passes over all logical pages */
+    uint32_t next_sector;                   /*!< Logical page the current pass carries on from */
+    uint32_t num_sectors;                   /*!< Logical pages covered by a pass */
+    uint64_t pages_checked;                 /*!< Mapped logical pages read by the scrubber */
+    uint32_t pages_refreshed;               /*!< Pages rewritten because their corrected-bit count reached the refresh threshold */
+    uint32_t uncorrectable;                 /*!< Reads that hit an uncorrectable ECC error, counted again on every pass */
+} nand_scrub_stats_t;
+
 /** @brief NAND Flash device identification information */
 typedef struct {
     uint8_t manufacturer_id;                /*!< Manufacturer ID */
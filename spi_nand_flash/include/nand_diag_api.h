@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "spi_nand_flash.h"
+#include "nand_device_types.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +36,91 @@ esp_err_t nand_get_bad_block_stats(spi_nand_flash_device_t *flash, uint32_t *bad
  */
 esp_err_t nand_get_ecc_stats(spi_nand_flash_device_t *flash);
 
+/** @brief Get busy-time statistics of one chip operation.
+ *
+ * Every page read, page program and block erase waited for by the driver is recorded in a log2 histogram,
+ * which can be used to tune CONFIG_NAND_FLASH_WAIT_STRATEGY for a given chip.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param op The operation to get the statistics of.
+ * @param[out] stats Where to copy the statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_LATENCY_STATS is disabled.
+ */
+esp_err_t nand_get_latency_stats(spi_nand_flash_device_t *flash, nand_latency_op_t op, nand_latency_stats_t *stats);
+
+/** @brief Clear the busy-time statistics of all chip operations.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_LATENCY_STATS is disabled.
+ */
+esp_err_t nand_reset_latency_stats(spi_nand_flash_device_t *flash);
+
+/** @brief Get statistics of the page write duration through the wear-levelling layer.
+ *
+ * Each sample covers one dhara_map_write(), including any garbage collection it had to do inline, which is what
+ * CONFIG_NAND_FLASH_BACKGROUND_GC is meant to keep out of the write path.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param[out] stats Where to copy the statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_LATENCY_STATS is disabled.
+ */
+esp_err_t nand_get_write_latency_stats(spi_nand_flash_device_t *flash, nand_latency_stats_t *stats);
+
+/** @brief Estimate a percentile from latency statistics.
+ *
+ * @param stats Statistics as returned by nand_get_latency_stats() or nand_get_write_latency_stats().
+ * @param percentile Percentile to estimate, 1 to 100.
+ * @return Upper bound of the histogram bucket holding the percentile, in microseconds (capped to stats->max_us),
+ *         or 0 if no samples were recorded.
+ */
+uint32_t nand_latency_stats_percentile(const nand_latency_stats_t *stats, uint32_t percentile);
+
+/** @brief Get the counters of the RAM write-back page cache.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param[out] stats Where to copy the counters.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_WRITE_CACHE is disabled.
+ */
+esp_err_t nand_get_write_cache_stats(spi_nand_flash_device_t *flash, nand_write_cache_stats_t *stats);
+
+/** @brief Get the erase counts of the blocks.
+ *
+ * The wear-levelling layer counts every block erase, and saves the counts in the flash so that they survive reboots
+ * and chip erases. The counts of the last block include the saves of the counts themselves.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param[inout] stats Where to put the statistics. Set stats->erase_counts and stats->erase_counts_len to also get
+ *                     the count of each block, or NULL and 0.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_INVALID_STATE if the wear-levelling layer is not initialised,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_ERASE_COUNTS is disabled.
+ */
+esp_err_t nand_get_wear_stats(spi_nand_flash_device_t *flash, nand_wear_stats_t *stats);
+
+/** @brief Get the counters of the background garbage collection task.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param[out] stats Where to copy the counters.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_BACKGROUND_GC is disabled.
+ */
+esp_err_t nand_get_gc_stats(spi_nand_flash_device_t *flash, nand_gc_stats_t *stats);
+
+/** @brief Get the progress and counters of the background ECC scrubber.
+ *
+ * The scrubber walks the logical pages of the wear-levelling layer while the device is idle, and rewrites the pages
+ * that needed at least the chip's data refresh threshold of corrected bits to be read.
+ *
+ * @param flash The handle to the SPI nand flash chip.
+ * @param[out] stats Where to copy the statistics.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_NAND_FLASH_ECC_SCRUB is disabled.
+ */
+esp_err_t nand_get_scrub_stats(spi_nand_flash_device_t *flash, nand_scrub_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
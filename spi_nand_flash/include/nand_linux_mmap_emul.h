@@ -17,6 +17,11 @@ extern "C" {
 
 // Control structure for NAND emulation
 typedef struct {
+    /**
+     * Path of the backing file, or an empty string for a temporary file. A new file, or one of a different size,
+     * starts fully erased; an existing file of flash_file_size bytes is reused as-is, so an image kept with
+     * keep_dump can be mounted again.
+     */
     char flash_file_name[256];
     /**
      * Size of the backing mmap file in bytes. Must be a multiple of the chip's
@@ -36,8 +41,53 @@ typedef struct {
      */
     size_t flash_file_size;
     bool keep_dump;
+    /**
+     * SPI clock of the simulated bus in Hz, used with the io_mode of spi_nand_flash_config_t to time the transfers
+     * in the timing model (CONFIG_NAND_ENABLE_STATS). 0 selects NAND_EMUL_DEFAULT_SPI_CLOCK_HZ.
+     */
+    uint32_t spi_clock_hz;
 } nand_file_mmap_emul_config_t;
 
+/** @brief Flash operation fed to the emulator timing model */
+typedef enum {
+    NAND_EMUL_OP_READ,      /*!< PAGE READ into the cache register, then READ FROM CACHE of the given bytes */
+    NAND_EMUL_OP_PROGRAM,   /*!< WRITE ENABLE, PROGRAM LOAD of the given bytes, then PROGRAM EXECUTE */
+    NAND_EMUL_OP_COPY,      /*!< PAGE READ then PROGRAM EXECUTE, the data staying in the cache register */
+    NAND_EMUL_OP_ERASE,     /*!< WRITE ENABLE then BLOCK ERASE */
+} nand_emul_op_t;
+
+#ifdef CONFIG_NAND_ENABLE_STATS
+/** @brief Simulated performance of the emulated chip since init or the last nand_emul_clear_stats() */
+typedef struct {
+    uint64_t elapsed_us;        /*!< Simulated time: SPI transfers plus the array busy times of the chip geometry */
+    uint64_t bus_us;            /*!< Part of elapsed_us spent transferring commands and data on the SPI bus */
+    uint32_t page_reads;        /*!< Array reads, including the OOB-only reads of the free/bad checks */
+    uint32_t page_programs;     /*!< Array programs, including internal page copies */
+    uint32_t block_erases;      /*!< Block erases */
+    uint32_t host_page_writes;  /*!< Pages written through spi_nand_flash_write_page() / spi_nand_flash_write_pages() */
+} nand_emul_perf_stats_t;
+
+/** @brief Fault injected by nand_emul_inject_fault() */
+typedef enum {
+    NAND_EMUL_FAULT_NONE,           /*!< No fault */
+    NAND_EMUL_FAULT_POWER_CUT,      /*!< Power is lost: the operation and all the following programs and erases are
+                                         not carried out, but report success as nobody is left to see them fail */
+    NAND_EMUL_FAULT_PROGRAM_FAIL,   /*!< The operation reports a program/erase failure, as on a worn-out block */
+} nand_emul_fault_type_t;
+
+/** @brief Fault injection setting */
+typedef struct {
+    nand_emul_fault_type_t type;    /*!< Fault to inject */
+    uint32_t after_ops;             /*!< Page programs (copies included) and block erases completed before the fault */
+    bool torn;                      /*!< NAND_EMUL_FAULT_POWER_CUT: leave the interrupted operation half done rather
+                                         than not started. A torn program leaves a used page with random contents, a
+                                         torn erase erases the first pages of the block only; the pages left half
+                                         done read back with an uncorrectable ECC error until their block is erased,
+                                         also after the image is mounted again. */
+    uint32_t seed;                  /*!< Seed of the random contents of torn operations */
+} nand_emul_fault_config_t;
+#endif
+
 // nand mmap emulator handle
 typedef struct {
     void *mem_file_buf;
@@ -51,12 +101,25 @@ typedef struct {
         size_t read_bytes;
         size_t write_bytes;
     } stats;
+    nand_emul_perf_stats_t perf;
+    uint64_t elapsed_ns;        // Simulated time, kept in ns so that short bus transfers are not rounded away
+    uint64_t bus_ns;
+    uint32_t *erase_counts;     // Erases of each block, allocated on the first erase
+    uint32_t erase_counts_len;
+    uint8_t *ecc_status;        // nand_ecc_status_t injected for each page, allocated on the first injection
+    uint32_t ecc_status_len;
+    nand_emul_fault_config_t fault;  // Armed fault, after_ops counting down
+    uint32_t fault_rng;         // xorshift32 state for torn operations
+    bool fault_hit;
 #endif
 } nand_mmap_emul_handle_t;
 
 // Emulated nand mmap file size
 #define EMULATED_NAND_SIZE        128 * 1024 * 1024
 
+// SPI clock of the timing model when nand_file_mmap_emul_config_t::spi_clock_hz is 0
+#define NAND_EMUL_DEFAULT_SPI_CLOCK_HZ  (40 * 1000 * 1000)
+
 #include "spi_nand_flash.h"
 
 /**
@@ -134,10 +197,144 @@ void nand_emul_get_stats(spi_nand_flash_device_t *handle, size_t *read_ops, size
                          size_t *read_bytes, size_t *write_bytes);
 
 /**
- * @brief Clear NAND operation statistics
+ * @brief Clear NAND operation statistics, the simulated performance counters and the per-block erase counts
  * @param handle spi_nand_flash_device_t handle for nand device
  */
 void nand_emul_clear_stats(spi_nand_flash_device_t *handle);
+
+/**
+ * @brief Advance the timing model by one flash operation
+ *
+ * Called by the Linux NAND implementation for each chip operation it emulates. The operation costs its SPI
+ * transfers, at the configured clock and with the data lanes of the io_mode, plus the read/program/erase delay of
+ * the chip geometry.
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param op Simulated operation
+ * @param bytes Bytes moved over the bus: read from the cache register for NAND_EMUL_OP_READ, loaded into it for
+ *              NAND_EMUL_OP_PROGRAM, ignored otherwise
+ */
+void nand_emul_simulate_op(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t bytes);
+
+/**
+ * @brief Count pages written by the application, the reference for the write amplification
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param count Number of pages
+ */
+void nand_emul_record_host_writes(spi_nand_flash_device_t *handle, uint32_t count);
+
+/**
+ * @brief Get the simulated performance counters
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param[out] stats Where to copy the counters
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if stats is NULL
+ *         ESP_ERR_INVALID_STATE if emulation is not initialized
+ */
+esp_err_t nand_emul_get_perf_stats(spi_nand_flash_device_t *handle, nand_emul_perf_stats_t *stats);
+
+/**
+ * @brief Write amplification: pages programmed on the chip per page written by the application
+ *
+ * @param stats Counters returned by nand_emul_get_perf_stats()
+ * @return page_programs / host_page_writes, or 0 if no page was written. Below 1 when the write cache merged writes.
+ */
+float nand_emul_write_amplification(const nand_emul_perf_stats_t *stats);
+
+/**
+ * @brief Get the number of erases of each block
+ *
+ * The counts, like the other statistics of the emulator, cover the whole chip even for a partition handle.
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param[out] counts Array receiving the erase count of blocks 0 to num_blocks - 1
+ * @param num_blocks Number of entries in counts
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if counts is NULL
+ *         ESP_ERR_INVALID_STATE if emulation is not initialized
+ */
+esp_err_t nand_emul_get_erase_counts(spi_nand_flash_device_t *handle, uint32_t *counts, uint32_t num_blocks);
+
+/**
+ * @brief Make the reads of a page report an ECC status, as if its cells had degraded
+ *
+ * The status is reported by every read or copy of the page until the page is programmed again or its block is
+ * erased. NAND_ECC_NOT_CORRECTED makes them fail, as an uncorrectable error does on a chip.
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param page Physical page, relative to the partition for a handle from spi_nand_flash_init_partitions()
+ * @param status ECC status to report, NAND_ECC_OK to clear an injected one
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if page or status is out of range
+ *         ESP_ERR_INVALID_STATE if emulation is not initialized
+ *         ESP_ERR_NO_MEM if the status table cannot be allocated
+ */
+esp_err_t nand_emul_inject_ecc_status(spi_nand_flash_device_t *handle, uint32_t page, nand_ecc_status_t status);
+
+/**
+ * @brief Get the ECC status injected for a page
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param page Physical page, relative to the partition for a handle from spi_nand_flash_init_partitions()
+ * @return Status set by nand_emul_inject_ecc_status(), NAND_ECC_OK if there is none
+ */
+nand_ecc_status_t nand_emul_get_ecc_status(spi_nand_flash_device_t *handle, uint32_t page);
+
+/**
+ * @brief Arm a power cut or a program/erase failure
+ *
+ * The fault hits the program, copy or erase that follows @p fault->after_ops others, counted over the whole chip.
+ * A power cut lasts until the device is deinitialized (the image is kept with keep_dump, to be mounted again) or
+ * until this function is called again. A program failure hits once.
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param fault Fault to inject, NULL to disarm any fault and restore the power
+ * @return ESP_OK on success
+ *         ESP_ERR_INVALID_ARG if the fault type is out of range
+ *         ESP_ERR_INVALID_STATE if emulation is not initialized
+ */
+esp_err_t nand_emul_inject_fault(spi_nand_flash_device_t *handle, const nand_emul_fault_config_t *fault);
+
+/**
+ * @brief Check whether the fault armed by nand_emul_inject_fault() has hit
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @return true once the power is cut or the program/erase failure has been reported, false otherwise
+ */
+bool nand_emul_fault_hit(spi_nand_flash_device_t *handle);
+
+/**
+ * @brief Fault injection point, called by the Linux NAND implementation before each program, copy or erase
+ *
+ * Applies the effect of a power cut that hits this operation to the flash contents.
+ *
+ * @param handle spi_nand_flash_device_t handle for nand device
+ * @param op NAND_EMUL_OP_PROGRAM, NAND_EMUL_OP_COPY or NAND_EMUL_OP_ERASE
+ * @param offset Offset in the backing file of the page programmed or of the block erased
+ * @return ESP_OK to carry the operation out
+ *         ESP_ERR_INVALID_STATE if the power is cut: skip the operation and report success
+ *         ESP_ERR_NOT_FINISHED to report a program/erase failure
+ */
+esp_err_t nand_emul_fault_point(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t offset);
+#else
+static inline void nand_emul_simulate_op(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t bytes)
+{
+}
+
+static inline void nand_emul_record_host_writes(spi_nand_flash_device_t *handle, uint32_t count)
+{
+}
+
+static inline nand_ecc_status_t nand_emul_get_ecc_status(spi_nand_flash_device_t *handle, uint32_t page)
+{
+    return NAND_ECC_OK;
+}
+
+static inline esp_err_t nand_emul_fault_point(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t offset)
+{
+    return ESP_OK;
+}
 #endif /* CONFIG_NAND_ENABLE_STATS */
 
 #ifdef __cplusplus
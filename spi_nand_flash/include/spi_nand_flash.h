@@ -59,6 +59,18 @@ struct spi_nand_flash_config_t {
 
 typedef struct spi_nand_flash_config_t spi_nand_flash_config_t;
 
+/** @brief Layout of one wear-levelled partition of a chip.
+
+ Partitions are laid out one after the other from the first block of the chip. Each one has its own journal and
+ garbage collection, so that data written often in one of them does not get mixed up with, and copied along with,
+ the mostly static data of another.
+*/
+typedef struct {
+    uint32_t num_blocks;                     ///< Number of erase blocks of the partition. 0 in the last entry takes the
+    ///< rest of the chip.
+    uint8_t gc_factor;                       ///< The gc factor of this partition, 0 to use the one of spi_nand_flash_config_t.
+} spi_nand_flash_partition_config_t;
+
 /** @brief Initialise SPI nand flash chip interface.
  *
  * This function must be called before calling any other API functions for the nand flash.
@@ -72,6 +84,29 @@ typedef struct spi_nand_flash_config_t spi_nand_flash_config_t;
  */
 esp_err_t spi_nand_flash_init_device(spi_nand_flash_config_t *config, spi_nand_flash_device_t **handle);
 
+/** @brief Initialise SPI nand flash chip interface, split into independently wear-levelled partitions.
+ *
+ * Each partition is used with the returned handle like a device of its own, of the size given by its layout: page,
+ * block and capacity numbers are relative to the partition, and spi_nand_erase_chip() erases the partition only.
+ * The partitions share the SPI device and one mutex, so operations on different partitions are serialised.
+ * Release each handle with spi_nand_flash_deinit_device(); the chip is released with the last one.
+ *
+ * The layout must stay the same across mounts. Erase the chip when it changes.
+ *
+ * @param config Pointer to SPI nand flash config structure.
+ * @param partitions Layout of the partitions.
+ * @param num_partitions Number of entries of partitions and handles.
+ * @param[out] handles The handle of each partition is returned in this array.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the partitions do not fit on the chip or one of them is too small
+ *         to hold any data, or a flash error code if the initialisation failed.
+ *
+ * @note When CONFIG_NAND_FLASH_ENABLE_BDL is enabled, this function returns ESP_ERR_NOT_SUPPORTED.
+ *       Use spi_nand_flash_init_partitions_with_layers() instead.
+ */
+esp_err_t spi_nand_flash_init_partitions(spi_nand_flash_config_t *config,
+        const spi_nand_flash_partition_config_t *partitions, uint32_t num_partitions,
+        spi_nand_flash_device_t **handles);
+
 //-----------------------------------------------------------------------------
 // Page API (preferred terminology; NAND flash is page-based)
 //-----------------------------------------------------------------------------
@@ -94,6 +129,32 @@ esp_err_t spi_nand_flash_read_page(spi_nand_flash_device_t *handle, uint8_t *buf
  */
 esp_err_t spi_nand_flash_write_page(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t page_id);
 
+/** @brief Read consecutive logical pages from the nand flash.
+ *
+ * Equivalent to calling spi_nand_flash_read_page() for each page, but the device is locked only once and the
+ * wear-leveling layer resolves the page mappings for the whole range before reading, so physically consecutive
+ * pages are read as one run.
+ *
+ * @param handle The handle to the SPI nand flash chip.
+ * @param[out] buffer The output buffer (must hold at least count * page_size bytes).
+ * @param start_page First logical page index to read.
+ * @param count Number of pages to read.
+ * @return ESP_OK on success, or a flash error code if any read failed.
+ */
+esp_err_t spi_nand_flash_read_pages(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_page, uint32_t count);
+
+/** @brief Write consecutive logical pages to the nand flash.
+ *
+ * Equivalent to calling spi_nand_flash_write_page() for each page, but the device is locked only once.
+ *
+ * @param handle The handle to the SPI nand flash chip.
+ * @param buffer The input buffer (must hold at least count * page_size bytes).
+ * @param start_page First logical page index to write.
+ * @param count Number of pages to write.
+ * @return ESP_OK on success, or a flash error code if any write failed. Pages before the failing one are written.
+ */
+esp_err_t spi_nand_flash_write_pages(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t start_page, uint32_t count);
+
 /** @brief Copy a page to another page within the nand flash.
  *
  * @param handle The handle to the SPI nand flash chip.
@@ -114,6 +175,19 @@ esp_err_t spi_nand_flash_copy_page(spi_nand_flash_device_t *handle, uint32_t src
  */
 esp_err_t spi_nand_flash_trim(spi_nand_flash_device_t *handle, uint32_t page_id);
 
+/** @brief Trim consecutive logical pages from the nand flash.
+ *
+ * Equivalent to calling spi_nand_flash_trim() for each page, but the device is locked only once, pages that hold no
+ * data are skipped without any garbage collection, and the pages of the range that garbage collection reaches are
+ * dropped instead of being relocated first.
+ *
+ * @param handle The handle to the SPI nand flash chip.
+ * @param start_page First logical page index to trim.
+ * @param count Number of pages to trim.
+ * @return ESP_OK on success, or a flash error code if the trim failed. Pages before the failing one are trimmed.
+ */
+esp_err_t spi_nand_flash_trim_range(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count);
+
 /** @brief Get the number of logical pages (capacity).
  *
  * @param handle The handle to the SPI nand flash chip.
@@ -177,6 +251,8 @@ esp_err_t spi_nand_flash_sync(spi_nand_flash_device_t *handle);
 esp_err_t spi_nand_flash_get_block_size(spi_nand_flash_device_t *handle, uint32_t *block_size);
 
 /** @brief Erases the entire chip, invalidating any data on the chip.
+ *
+ * On a handle from spi_nand_flash_init_partitions(), only the blocks of the partition are erased.
  *
  * @param handle The handle to the SPI nand flash chip.
  * @return ESP_OK on success, or a flash error code if the erase failed.
@@ -234,6 +310,27 @@ esp_err_t spi_nand_flash_deinit_device(spi_nand_flash_device_t *handle);
  */
 esp_err_t spi_nand_flash_init_with_layers(spi_nand_flash_config_t *config,
         esp_blockdev_handle_t *wl_bdl);
+
+/** @brief Initialize SPI NAND Flash split into wear-levelled partitions, with a block device per partition
+ *
+ * Layered counterpart of spi_nand_flash_init_partitions(). Each partition gets a Flash Block Device Layer covering
+ * its blocks and a Wear-Leveling Block Device Layer on top of it; releasing a Wear-Leveling layer releases the Flash
+ * layer under it, and the chip is released with the last one.
+ *
+ * @param config Configuration for the SPI NAND flash
+ * @param partitions Layout of the partitions
+ * @param num_partitions Number of entries of partitions and wl_bdls
+ * @param[out] wl_bdls The Wear-Leveling Block Device Layer handle of each partition is returned in this array
+ * @return
+ *         - ESP_OK: Success
+ *         - ESP_ERR_INVALID_ARG: Invalid configuration or NULL pointers
+ *         - ESP_ERR_INVALID_SIZE: The partitions do not fit on the chip, or one of them is too small to hold any data
+ *         - ESP_ERR_NO_MEM: Insufficient memory
+ *         - ESP_ERR_NOT_FOUND: NAND device not detected
+ */
+esp_err_t spi_nand_flash_init_partitions_with_layers(spi_nand_flash_config_t *config,
+        const spi_nand_flash_partition_config_t *partitions, uint32_t num_partitions,
+        esp_blockdev_handle_t *wl_bdls);
 #endif // CONFIG_NAND_FLASH_ENABLE_BDL
 
 #ifdef __cplusplus
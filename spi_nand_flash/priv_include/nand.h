@@ -30,6 +30,9 @@ extern "C" {
 
 #define NAND_FLAG_HAS_PROG_PLANE_SELECT       BIT(0)
 #define NAND_FLAG_HAS_READ_PLANE_SELECT       BIT(1)
+#define NAND_FLAG_HAS_CACHE_READ_SEQ          BIT(2)
+
+typedef struct nand_write_cache nand_write_cache_t;
 
 // Legacy typedef for compatibility - now uses nand_flash_geometry_t internally
 typedef nand_flash_geometry_t spi_nand_chip_t;
@@ -46,6 +49,10 @@ typedef struct {
     esp_err_t (*copy_sector)(spi_nand_flash_device_t *handle, uint32_t src_sec, uint32_t dst_sec);
     esp_err_t (*get_capacity)(spi_nand_flash_device_t *handle, uint32_t *number_of_sectors);
     esp_err_t (*gc)(spi_nand_flash_device_t *handle);
+    // Optional vectored variants, called with the device mutex held. When NULL, the per-page ops are looped instead.
+    esp_err_t (*read_pages)(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_sector, uint32_t count);
+    esp_err_t (*write_pages)(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t start_sector, uint32_t count);
+    esp_err_t (*trim_range)(spi_nand_flash_device_t *handle, uint32_t start_sector, uint32_t count);
 } spi_nand_ops;
 
 struct spi_nand_flash_device_t {
@@ -55,25 +62,111 @@ struct spi_nand_flash_device_t {
     const spi_nand_ops *ops;
     void *ops_priv_data;
     uint8_t *work_buffer;
-    uint8_t *read_buffer;
+    uint8_t *read_buffer;                  // Shared by the partitions of a chip, like temp_buffer and mutex
     uint8_t *temp_buffer;
+    uint8_t *verify_buffer;                // CONFIG_NAND_FLASH_VERIFY_WRITE read-back, shared like read_buffer
+    uint32_t *bad_block_bitmap;            // 2 bits per block, see nand_bad_block_lookup()
     SemaphoreHandle_t mutex;
+    uint32_t first_block;                  // Block of the chip that is block 0 of this handle, see nand_chip_page()
+    uint32_t *chip_refs;                   // Handles sharing the chip (partitions), NULL if this one has it alone
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+    uint32_t wait_estimate_us[NAND_LATENCY_OP_MAX]; // Running estimate of each operation's busy time
+#endif
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    nand_latency_stats_t latency_stats[NAND_LATENCY_OP_MAX];
+    nand_latency_stats_t write_latency_stats; // Wear-levelling layer page writes, including any inline GC
+#endif
+#if CONFIG_NAND_FLASH_WRITE_CACHE
+    nand_write_cache_t *write_cache;       // NULL until the wear-levelling layer is initialised
+#endif
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    uint32_t *erase_counts;                // Erases of each block of the chip, NULL until the wear-levelling layer is initialised
+#endif
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+    nand_gc_stats_t gc_stats;              // Updated by the garbage collection task of the wear-levelling layer
+#endif
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+    nand_scrub_stats_t scrub_stats;        // Updated by the scrub task of the wear-levelling layer
+#endif
 #ifdef CONFIG_IDF_TARGET_LINUX
     nand_mmap_emul_handle_t *emul_handle;
 #endif
 };
 
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+/** @brief Add one sample to a latency histogram */
+static inline void nand_latency_record(nand_latency_stats_t *stats, uint32_t elapsed_us)
+{
+    uint32_t bucket = 0;
+    while ((elapsed_us >> (bucket + 1)) != 0 && bucket < NAND_LATENCY_HIST_BUCKETS - 1) {
+        bucket++;
+    }
+    stats->hist[bucket]++;
+    if (stats->count == 0 || elapsed_us < stats->min_us) {
+        stats->min_us = elapsed_us;
+    }
+    if (elapsed_us > stats->max_us) {
+        stats->max_us = elapsed_us;
+    }
+    stats->total_us += elapsed_us;
+    stats->count++;
+}
+#endif //CONFIG_NAND_FLASH_LATENCY_STATS
+
+/*
+ * Bad-block status of every block, kept in RAM so that nand_is_bad() reads the markers of a block at most once. Each
+ * block has two bits: bit 0 is set once its status is known, bit 1 if it is bad. The statuses are filled in on first
+ * query rather than by a scan at init, which would cost a page read per block at every mount.
+ */
+#define NAND_BAD_BLOCK_BITMAP_WORDS(num_blocks) (((num_blocks) + 15) / 16)
+
+/** @return true if the status of the block is known, in *is_bad */
+static inline bool nand_bad_block_lookup(const spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad)
+{
+    if (block >= handle->chip.num_blocks) {
+        return false;
+    }
+    uint32_t bits = handle->bad_block_bitmap[block / 16] >> ((block % 16) * 2);
+    *is_bad = (bits & 2) != 0;
+    return (bits & 1) != 0;
+}
+
+static inline void nand_bad_block_record(spi_nand_flash_device_t *handle, uint32_t block, bool is_bad)
+{
+    if (block >= handle->chip.num_blocks) {
+        return;
+    }
+    uint32_t *word = &handle->bad_block_bitmap[block / 16];
+    uint32_t shift = (block % 16) * 2;
+    *word = (*word & ~(3U << shift)) | ((is_bad ? 3U : 1U) << shift);
+}
+
+/**
+ * A partition handle sees chip.num_blocks blocks starting at first_block: block and page numbers are relative to it
+ * everywhere, and only translated to chip addresses when they are sent to the chip (or the emulator).
+ */
+static inline uint32_t nand_chip_page(const spi_nand_flash_device_t *handle, uint32_t page)
+{
+    return page + (handle->first_block << handle->chip.log2_ppb);
+}
+
+/** @return lower bound of the corrected-bit count for a correctable ECC class, 0 otherwise */
+static inline uint8_t nand_ecc_min_bits_corrected(nand_ecc_status_t status)
+{
+    if (status == NAND_ECC_1_TO_3_BITS_CORRECTED) {
+        return 1;
+    } else if (status == NAND_ECC_4_TO_6_BITS_CORRECTED) {
+        return 4;
+    } else if (status == NAND_ECC_7_8_BITS_CORRECTED) {
+        return 7;
+    }
+    return 0;
+}
+
 /** @return true if corrected-bit ECC class meets or exceeds the data-refresh threshold */
 static inline bool nand_ecc_exceeds_data_refresh_threshold(const spi_nand_flash_device_t *handle)
 {
-    uint8_t min_bits_corrected = 0;
-    if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_1_TO_3_BITS_CORRECTED) {
-        min_bits_corrected = 1;
-    } else if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_4_TO_6_BITS_CORRECTED) {
-        min_bits_corrected = 4;
-    } else if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_7_8_BITS_CORRECTED) {
-        min_bits_corrected = 7;
-    }
+    uint8_t min_bits_corrected = nand_ecc_min_bits_corrected(handle->chip.ecc_data.ecc_corrected_bits_status);
     return min_bits_corrected >= handle->chip.ecc_data.ecc_data_refresh_threshold;
 }
 
@@ -104,6 +197,53 @@ esp_err_t nand_wl_attach_ops(spi_nand_flash_device_t *handle);
  */
 esp_err_t nand_wl_detach_ops(spi_nand_flash_device_t *handle);
 
+/**
+ * @brief Split a chip handle from nand_init_device() into partition handles (internal use only)
+ *
+ * Each partition handle gets its own work buffer and bad-block bitmap, and shares the mutex, the SPI device (or
+ * emulator) and the read buffers of the chip. The chip handle is released, whether or not this succeeds.
+ *
+ * @param[in]  chip            Chip handle, without wear-levelling operations attached
+ * @param[in]  partitions      Partition layout
+ * @param[in]  num_partitions  Number of entries of partitions and handles
+ * @param[out] handles         Partition handles, to be released with nand_release_device()
+ *
+ * @return
+ *         - ESP_OK: Success
+ *         - ESP_ERR_INVALID_SIZE: The partitions do not fit on the chip, or one is empty
+ *         - ESP_ERR_NO_MEM: Insufficient memory
+ */
+esp_err_t nand_split_partitions(spi_nand_flash_device_t *chip, const spi_nand_flash_partition_config_t *partitions,
+                                uint32_t num_partitions, spi_nand_flash_device_t **handles);
+
+/**
+ * @brief Free a device handle (internal use only)
+ *
+ * Frees the buffers of the handle, and the mutex and the SPI device or emulator once no other partition of the chip
+ * uses them. Wear-levelling operations must be detached first.
+ *
+ * @param[in] handle  NAND device handle
+ *
+ * @return
+ *         - ESP_OK: Success
+ *         - Error from the emulator on Linux
+ */
+esp_err_t nand_release_device(spi_nand_flash_device_t *handle);
+
+#ifdef CONFIG_NAND_FLASH_ENABLE_BDL
+/**
+ * @brief Create a Flash Block Device Layer on an initialized device handle (internal use only)
+ *
+ * @param[in]  handle              NAND device handle, owned by the Flash BDL on success
+ * @param[out] out_bdl_handle_ptr  Flash BDL handle
+ *
+ * @return
+ *         - ESP_OK: Success
+ *         - ESP_ERR_NO_MEM: Insufficient memory
+ */
+esp_err_t nand_flash_blockdev_create(spi_nand_flash_device_t *handle, esp_blockdev_handle_t *out_bdl_handle_ptr);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
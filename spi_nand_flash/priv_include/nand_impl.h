@@ -9,6 +9,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "nand.h"
 
@@ -41,6 +42,20 @@ extern "C" {
 esp_err_t nand_init_device(spi_nand_flash_config_t *config,
                            spi_nand_flash_device_t **handle);
 
+/**
+ * @brief Allocate a one-page buffer that data can be transferred to and from the chip with (internal use only)
+ *
+ * @return The buffer, to be freed with free(), or NULL if out of memory
+ */
+uint8_t *nand_alloc_page_buffer(const spi_nand_flash_device_t *handle);
+
+/**
+ * @brief Whether data can be transferred straight to or from a buffer, without a bounce buffer (internal use only)
+ *
+ * True for DMA-capable buffers aligned to spi_nand_get_dma_alignment(), and for any buffer on Linux.
+ */
+bool nand_buffer_dma_capable(const void *buf);
+
 esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t b, bool *is_bad_status);
 esp_err_t nand_mark_bad(spi_nand_flash_device_t *handle, uint32_t b);
 esp_err_t nand_erase_chip(spi_nand_flash_device_t *handle);
@@ -48,6 +63,15 @@ esp_err_t nand_erase_block(spi_nand_flash_device_t *handle, uint32_t b);
 esp_err_t nand_prog(spi_nand_flash_device_t *handle, uint32_t p, const uint8_t *data);
 esp_err_t nand_is_free(spi_nand_flash_device_t *handle, uint32_t p, bool *is_free_status);
 esp_err_t nand_read(spi_nand_flash_device_t *handle, uint32_t p, size_t offset, size_t length, uint8_t *data);
+
+/**
+ * @brief Read `count` whole, physically consecutive pages into `data`
+ *
+ * On chips with NAND_FLAG_HAS_CACHE_READ_SEQ (and CONFIG_NAND_FLASH_SEQUENTIAL_READ enabled) the pages of each
+ * block are streamed with the cache read sequence instead of one PAGE READ per page. On success,
+ * chip.ecc_data.ecc_corrected_bits_status holds the worst correctable ECC class seen across the run.
+ */
+esp_err_t nand_read_pages(spi_nand_flash_device_t *handle, uint32_t p, uint32_t count, uint8_t *data);
 esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst);
 esp_err_t nand_get_ecc_status(spi_nand_flash_device_t *handle, uint32_t page);
 
@@ -0,0 +1,126 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "nand.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RAM write-back cache of logical pages in front of the wear-levelling layer (CONFIG_NAND_FLASH_WRITE_CACHE).
+ *
+ * Single-page writes are kept in RAM and only written to the wear-levelling layer when evicted (least recently used
+ * first), on spi_nand_flash_sync(), or once the oldest unflushed write is CONFIG_NAND_FLASH_WRITE_CACHE_FLUSH_MS old.
+ * Repeated writes of the same page in between, typically the FAT and directory sectors, cost one flash write.
+ *
+ * Except for create/destroy, all functions must be called with handle->mutex held, and do nothing (or report a
+ * miss) when the device has no cache.
+ */
+
+#if CONFIG_NAND_FLASH_WRITE_CACHE
+
+/** @brief Allocate the cache of the device and start its flush task */
+esp_err_t nand_write_cache_create(spi_nand_flash_device_t *handle);
+
+/** @brief Flush the cache to the wear-levelling layer and free it. The device must not be in use anymore. */
+esp_err_t nand_write_cache_destroy(spi_nand_flash_device_t *handle);
+
+/** @brief Copy a cached page into buffer. @return true if the page was cached */
+bool nand_write_cache_read(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t page_id);
+
+/** @brief Overwrite the pages of a range just read from the wear-levelling layer with their cached contents */
+void nand_write_cache_overlay(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_page, uint32_t count);
+
+/** @brief Store a page in the cache, writing back the least recently used page if the cache is full */
+esp_err_t nand_write_cache_write(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t page_id);
+
+/** @brief Drop the cached copies of a range of pages, without writing them back */
+void nand_write_cache_discard(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count);
+
+/** @brief Drop all cached pages, without writing them back */
+void nand_write_cache_invalidate(spi_nand_flash_device_t *handle);
+
+/** @brief Write back one page if it is cached and dirty */
+esp_err_t nand_write_cache_flush_page(spi_nand_flash_device_t *handle, uint32_t page_id);
+
+/** @brief Write back all dirty pages */
+esp_err_t nand_write_cache_flush(spi_nand_flash_device_t *handle);
+
+/**
+ * @return true if a write of count pages from start_page should bypass the cache: large transfers, so they do not
+ *         evict the hot pages, and pages past the capacity, so the wear-levelling layer reports the error at once
+ */
+bool nand_write_cache_bypass(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count);
+
+/** @brief Copy the hit/write-back counters of the cache */
+esp_err_t nand_write_cache_get_stats(spi_nand_flash_device_t *handle, nand_write_cache_stats_t *stats);
+
+#else
+
+static inline esp_err_t nand_write_cache_create(spi_nand_flash_device_t *handle)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t nand_write_cache_destroy(spi_nand_flash_device_t *handle)
+{
+    return ESP_OK;
+}
+
+static inline bool nand_write_cache_read(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t page_id)
+{
+    return false;
+}
+
+static inline void nand_write_cache_overlay(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_page,
+        uint32_t count)
+{
+}
+
+static inline esp_err_t nand_write_cache_write(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t page_id)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline void nand_write_cache_discard(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count)
+{
+}
+
+static inline void nand_write_cache_invalidate(spi_nand_flash_device_t *handle)
+{
+}
+
+static inline esp_err_t nand_write_cache_flush_page(spi_nand_flash_device_t *handle, uint32_t page_id)
+{
+    return ESP_OK;
+}
+
+static inline esp_err_t nand_write_cache_flush(spi_nand_flash_device_t *handle)
+{
+    return ESP_OK;
+}
+
+static inline bool nand_write_cache_bypass(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count)
+{
+    return true;
+}
+
+static inline esp_err_t nand_write_cache_get_stats(spi_nand_flash_device_t *handle, nand_write_cache_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif //CONFIG_NAND_FLASH_WRITE_CACHE
+
+#ifdef __cplusplus
+}
+#endif
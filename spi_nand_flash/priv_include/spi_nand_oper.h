@@ -36,9 +36,13 @@ typedef struct spi_nand_transaction_t spi_nand_transaction_t;
 #define CMD_WRITE_ENABLE    0x06
 #define CMD_READ_ID         0x9F
 #define CMD_PAGE_READ       0x13
+#define CMD_PAGE_READ_CACHE_SEQ  0x31
+#define CMD_PAGE_READ_CACHE_LAST 0x3F
 #define CMD_PROGRAM_EXECUTE 0x10
 #define CMD_PROGRAM_LOAD    0x84
 #define CMD_PROGRAM_LOAD_X4 0x34
+#define CMD_PROGRAM_LOAD_RESET    0x02
+#define CMD_PROGRAM_LOAD_RESET_X4 0x32
 #define CMD_READ_FAST       0x0B
 #define CMD_READ_X2         0x3B
 #define CMD_READ_X4         0x6B
@@ -67,9 +71,13 @@ esp_err_t spi_nand_read_register(spi_nand_flash_device_t *handle, uint8_t reg, u
 esp_err_t spi_nand_write_register(spi_nand_flash_device_t *handle, uint8_t reg, uint8_t val);
 esp_err_t spi_nand_write_enable(spi_nand_flash_device_t *handle);
 esp_err_t spi_nand_read_page(spi_nand_flash_device_t *handle, uint32_t page);
+esp_err_t spi_nand_read_page_cache_seq(spi_nand_flash_device_t *handle);
+esp_err_t spi_nand_read_page_cache_last(spi_nand_flash_device_t *handle);
 esp_err_t spi_nand_read(spi_nand_flash_device_t *handle, uint8_t *data, uint16_t column, uint16_t length);
 esp_err_t spi_nand_program_execute(spi_nand_flash_device_t *handle, uint32_t page);
 esp_err_t spi_nand_program_load(spi_nand_flash_device_t *handle, const uint8_t *data, uint16_t column, uint16_t length);
+/* Like spi_nand_program_load(), but the rest of the cache register is reset to 0xFF first */
+esp_err_t spi_nand_program_load_reset(spi_nand_flash_device_t *handle, const uint8_t *data, uint16_t column, uint16_t length);
 esp_err_t spi_nand_erase_block(spi_nand_flash_device_t *handle, uint32_t page);
 
 #ifdef __cplusplus
@@ -6,6 +6,7 @@
  * SPDX-FileContributor: 2015-2024 Espressif Systems (Shanghai) CO LTD
  */
 
+#include <stddef.h>
 #include <string.h>
 #include <sys/lock.h>
 #include "dhara/nand.h"
@@ -19,11 +20,67 @@
 #include "nand_impl.h"
 #include "nand.h"
 #include "nand_device_types.h"
+#include "nand_write_cache.h"
+#if CONFIG_NAND_FLASH_BACKGROUND_GC || CONFIG_NAND_FLASH_ECC_SCRUB
+#include "freertos/task.h"
+#endif
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+#endif
 
 #ifdef CONFIG_NAND_FLASH_ENABLE_BDL
 #include "esp_nand_blockdev.h"
 #endif
 
+// Number of logical pages whose physical location is resolved at once by the vectored read path
+#define DHARA_READ_BATCH_PAGES 16
+
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+// Number of dhara_map_gc() steps done per acquisition of the device mutex. Bounds how long a foreground operation
+// can be held up by the background collector.
+#define DHARA_BG_GC_STEPS_PER_LOCK 4
+
+_Static_assert(CONFIG_NAND_FLASH_BACKGROUND_GC_HIGH_WATERMARK > CONFIG_NAND_FLASH_BACKGROUND_GC_LOW_WATERMARK,
+               "CONFIG_NAND_FLASH_BACKGROUND_GC_HIGH_WATERMARK must be greater than the low watermark");
+#endif
+
+// The last block of the chip is kept out of the journal and holds the metadata of the options below
+#define DHARA_HAS_META_BLOCK (CONFIG_NAND_FLASH_FAST_MOUNT || CONFIG_NAND_FLASH_ERASE_COUNTS)
+
+#if DHARA_HAS_META_BLOCK
+// Records appended one per page to the metadata block: mount checkpoints, and pointers to the erase-count tables
+#define DHARA_CKPT_MAGIC        0x4b435044  // "DPCK"
+#define DHARA_CKPT_STATE_CLEAN  0x4e41454c
+#define DHARA_CKPT_STATE_DIRTY  0x00000000
+
+typedef struct {
+    uint32_t magic;
+    uint32_t state;
+    uint32_t num_blocks;    // Journal size when the record was written
+    uint32_t root;          // dhara_journal_root() of the synchronised journal
+    uint32_t epoch;
+    uint32_t wear_table;    // First page of the latest erase-count table, DHARA_PAGE_NONE if there is none
+    uint32_t crc;           // Of the fields above
+} dhara_ckpt_record_t;
+#endif
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+#define DHARA_WEAR_MAGIC        0x54524557  // "WERT"
+#define DHARA_BLOCK_NONE        ((dhara_block_t)0xffffffff)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t num_blocks;    // Chip size, one count follows per block
+    uint32_t crc;           // Of the counts
+} dhara_wear_header_t;
+#endif
+
+static const char *TAG = "dhara_glue";
+
 typedef struct {
     struct dhara_nand dhara_nand;
     struct dhara_map dhara_map;
@@ -31,8 +88,574 @@ typedef struct {
     esp_blockdev_handle_t bdl_handle;
 #endif
     spi_nand_flash_device_t *parent_handle;
+    bool mounted;               // dhara_init() completed, the journal may be written back on detach
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+    TaskHandle_t gc_task;
+    SemaphoreHandle_t gc_task_done;
+    volatile bool gc_task_stop;
+#endif
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+    TaskHandle_t scrub_task;
+    SemaphoreHandle_t scrub_task_done;
+    volatile bool scrub_task_stop;
+    uint8_t *scrub_buf;
+#endif
+#if CONFIG_NAND_FLASH_BACKGROUND_GC || CONFIG_NAND_FLASH_ECC_SCRUB
+    volatile TickType_t last_access_tick;  // Last foreground operation, the background tasks only run once this is old enough
+#endif
+#if DHARA_HAS_META_BLOCK
+    uint8_t *meta_buf;
+    dhara_page_t meta_next;     // Next free page of the metadata block, DHARA_PAGE_NONE if the block is unusable
+    dhara_page_t wear_table;    // First page of the latest erase-count table in the metadata block
+    bool ckpt_clean;            // The last record on flash is a clean one, and must be superseded before any write
+#endif
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    uint32_t wear_unsaved;      // Erases counted since the table was last saved
+    uint32_t wear_erases;       // Erases counted since the mount
+#if CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+    uint32_t wl_checked_erases; // wear_erases when the distribution was last checked
+    dhara_block_t wl_target;    // Block being relocated by static wear levelling, DHARA_BLOCK_NONE if none
+#endif
+#endif
 } spi_nand_flash_dhara_priv_data_t;
 
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+static inline int64_t dhara_time_us(void)
+{
+#ifdef CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+#endif //CONFIG_NAND_FLASH_LATENCY_STATS
+
+static inline void dhara_note_access(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+#if CONFIG_NAND_FLASH_BACKGROUND_GC || CONFIG_NAND_FLASH_ECC_SCRUB
+    dhara_priv_data->last_access_tick = xTaskGetTickCount();
+#endif
+}
+
+/* Write one sector, recording how long it took (including any garbage collection done inline by dhara) */
+static int dhara_timed_write(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_sector_t sector_id,
+                             const uint8_t *data, dhara_error_t *err)
+{
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    int64_t start_us = dhara_time_us();
+    int ret = dhara_map_write(&dhara_priv_data->dhara_map, sector_id, data, err);
+    nand_latency_record(&dhara_priv_data->parent_handle->write_latency_stats, (uint32_t)(dhara_time_us() - start_us));
+    return ret;
+#else
+    return dhara_map_write(&dhara_priv_data->dhara_map, sector_id, data, err);
+#endif
+}
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+static void dhara_wear_level(spi_nand_flash_dhara_priv_data_t *dhara_priv_data);
+#endif
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+static esp_err_t dhara_scrub_task_start(spi_nand_flash_dhara_priv_data_t *dhara_priv_data);
+#endif
+
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+/* Pages that can still be appended to the journal before a write has to collect garbage inline */
+static dhara_page_t dhara_gc_headroom(const struct dhara_map *map)
+{
+    dhara_page_t size = dhara_journal_size(&map->journal);
+    dhara_sector_t capacity = dhara_map_capacity(map);
+    return size < capacity ? capacity - size : 0;
+}
+
+static void dhara_gc_task(void *arg)
+{
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)arg;
+    spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+    struct dhara_map *map = &dhara_priv_data->dhara_map;
+    nand_gc_stats_t *stats = &handle->gc_stats;
+    TickType_t idle_ticks = pdMS_TO_TICKS(CONFIG_NAND_FLASH_BACKGROUND_GC_IDLE_MS);
+    if (idle_ticks == 0) {
+        idle_ticks = 1;
+    }
+    TickType_t wait_ticks = idle_ticks;
+    bool collecting = false;
+    dhara_page_t steps_left = 0;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+        if (dhara_priv_data->gc_task_stop) {
+            break;
+        }
+        wait_ticks = idle_ticks;
+        if ((TickType_t)(xTaskGetTickCount() - dhara_priv_data->last_access_tick) < idle_ticks) {
+            continue;
+        }
+
+        xSemaphoreTake(handle->mutex, portMAX_DELAY);
+        const dhara_sector_t capacity = dhara_map_capacity(map);
+        if (!collecting && dhara_gc_headroom(map) < (uint64_t)capacity * CONFIG_NAND_FLASH_BACKGROUND_GC_LOW_WATERMARK / 100) {
+            collecting = true;
+            stats->collections++;
+            // If most of the journal is live data, GC mostly moves pages around without freeing any: give up after one
+            // pass over the whole journal rather than wearing the chip for nothing
+            steps_left = dhara_journal_capacity(&map->journal);
+        }
+        for (int i = 0; collecting && i < DHARA_BG_GC_STEPS_PER_LOCK; i++) {
+            dhara_error_t err;
+            if (dhara_map_gc(map, &err) < 0) {
+                ESP_LOGW(TAG, "background gc failed: %s", dhara_strerror(err));
+                collecting = false;
+                break;
+            }
+            stats->gc_steps++;
+            if (dhara_gc_headroom(map) >= (uint64_t)capacity * CONFIG_NAND_FLASH_BACKGROUND_GC_HIGH_WATERMARK / 100 ||
+                    --steps_left == 0) {
+                collecting = false;
+            }
+        }
+        if (!collecting) {
+#if CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+            dhara_wear_level(dhara_priv_data);
+#endif
+            stats->idle_checks++;
+        }
+        xSemaphoreGive(handle->mutex);
+
+        if (collecting) {
+            // Carry on straight away, but let any foreground operation waiting for the mutex in first
+            wait_ticks = 0;
+            taskYIELD();
+        }
+    }
+
+    xSemaphoreGive(dhara_priv_data->gc_task_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t dhara_gc_task_start(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    dhara_priv_data->gc_task_done = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(dhara_priv_data->gc_task_done, ESP_ERR_NO_MEM, TAG, "nomem");
+    dhara_priv_data->last_access_tick = xTaskGetTickCount();
+    BaseType_t res = xTaskCreatePinnedToCore(dhara_gc_task, "nand_gc", CONFIG_NAND_FLASH_BACKGROUND_GC_TASK_STACK_SIZE,
+                     dhara_priv_data, CONFIG_NAND_FLASH_BACKGROUND_GC_TASK_PRIORITY, &dhara_priv_data->gc_task,
+#if CONFIG_NAND_FLASH_BACKGROUND_GC_TASK_CORE < 0
+                     tskNO_AFFINITY);
+#else
+                     CONFIG_NAND_FLASH_BACKGROUND_GC_TASK_CORE);
+#endif
+    if (res != pdPASS) {
+        vSemaphoreDelete(dhara_priv_data->gc_task_done);
+        dhara_priv_data->gc_task_done = NULL;
+        dhara_priv_data->gc_task = NULL;
+        ESP_LOGE(TAG, "Failed to create background gc task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void dhara_gc_task_stop(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    if (dhara_priv_data->gc_task == NULL) {
+        return;
+    }
+    dhara_priv_data->gc_task_stop = true;
+    xTaskNotifyGive(dhara_priv_data->gc_task);
+    xSemaphoreTake(dhara_priv_data->gc_task_done, portMAX_DELAY);
+    vSemaphoreDelete(dhara_priv_data->gc_task_done);
+    dhara_priv_data->gc_task = NULL;
+}
+#endif //CONFIG_NAND_FLASH_BACKGROUND_GC
+
+#if DHARA_HAS_META_BLOCK
+static uint32_t dhara_meta_crc(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static inline dhara_block_t dhara_meta_block(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    return dhara_priv_data->dhara_nand.num_blocks;
+}
+
+static inline dhara_page_t dhara_meta_first_page(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    return dhara_meta_block(dhara_priv_data) << dhara_priv_data->dhara_nand.log2_ppb;
+}
+
+static bool dhara_ckpt_record_valid(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data, const dhara_ckpt_record_t *rec)
+{
+    return rec->magic == DHARA_CKPT_MAGIC && rec->num_blocks == dhara_priv_data->dhara_nand.num_blocks &&
+           rec->crc == dhara_meta_crc(0, (const uint8_t *)rec, offsetof(dhara_ckpt_record_t, crc));
+}
+
+/* Find the last record in the metadata block. Pages are programmed in order, so the first free page is found with a
+ * binary search: mounting costs a handful of page reads whatever the size of the chip. The last page is normally a
+ * record; if the power was lost while an erase-count table was being written, the records before it are tried. */
+static bool dhara_meta_load(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_ckpt_record_t *rec)
+{
+    const struct dhara_nand *n = &dhara_priv_data->dhara_nand;
+    const dhara_block_t blk = dhara_meta_block(dhara_priv_data);
+    const dhara_page_t first = dhara_meta_first_page(dhara_priv_data);
+    const dhara_page_t ppb = 1 << n->log2_ppb;
+    dhara_error_t err;
+
+    dhara_priv_data->meta_next = DHARA_PAGE_NONE;
+    if (dhara_nand_is_bad(n, blk)) {
+        ESP_LOGW(TAG, "Metadata block %"PRIu32" is bad, fast mount and erase counts are not saved", (uint32_t)blk);
+        return false;
+    }
+
+    dhara_page_t low = 0;
+    dhara_page_t high = ppb;
+    while (low < high) {
+        dhara_page_t mid = (low + high) >> 1;
+        if (dhara_nand_is_free(n, first + mid)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    dhara_priv_data->meta_next = first + low;
+
+    // Free pages followed by used ones: the power was lost while the block was being erased. Pages programmed over
+    // what is left of the erase may not read back, so nothing in the block is trusted and the next record erases it.
+    if (low < ppb && !dhara_nand_is_free(n, first + ppb - 1)) {
+        ESP_LOGW(TAG, "Metadata block %"PRIu32" was not fully erased, ignoring it", (uint32_t)blk);
+        dhara_priv_data->meta_next = first + ppb;
+        return false;
+    }
+
+    while (low-- > 0) {
+        if (dhara_nand_read(n, first + low, 0, sizeof(*rec), dhara_priv_data->meta_buf, &err) == 0) {
+            memcpy(rec, dhara_priv_data->meta_buf, sizeof(*rec));
+            if (dhara_ckpt_record_valid(dhara_priv_data, rec)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* The metadata block cannot be written anymore: erase what is left in it so it is never trusted again */
+static void dhara_meta_fail(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    dhara_error_t err;
+    ESP_LOGW(TAG, "Failed to write the metadata block, fast mount and erase counts are not saved anymore");
+    dhara_nand_erase(&dhara_priv_data->dhara_nand, dhara_meta_block(dhara_priv_data), &err);
+    dhara_priv_data->meta_next = DHARA_PAGE_NONE;
+    dhara_priv_data->ckpt_clean = false;
+}
+
+/* Program meta_buf into the next page of the metadata block */
+static bool dhara_meta_append(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    dhara_error_t err;
+    if (dhara_nand_prog(&dhara_priv_data->dhara_nand, dhara_priv_data->meta_next, dhara_priv_data->meta_buf, &err) < 0) {
+        dhara_meta_fail(dhara_priv_data);
+        return false;
+    }
+    dhara_priv_data->meta_next++;
+    return true;
+}
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+/* An erase-count table is a dhara_wear_header_t followed by the count of every block of the chip, over as many
+ * consecutive pages as needed */
+static inline size_t dhara_wear_table_size(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    return sizeof(dhara_wear_header_t) + (size_t)dhara_priv_data->parent_handle->chip.num_blocks * sizeof(uint32_t);
+}
+
+static inline dhara_page_t dhara_wear_table_pages(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    const uint8_t log2_page_size = dhara_priv_data->dhara_nand.log2_page_size;
+    return (dhara_wear_table_size(dhara_priv_data) + (1U << log2_page_size) - 1) >> log2_page_size;
+}
+
+/* The metadata block must fit a table and a record after it, plus one more record before it is full again */
+static inline bool dhara_wear_persistent(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    return dhara_wear_table_pages(dhara_priv_data) + 2 <= (1U << dhara_priv_data->dhara_nand.log2_ppb);
+}
+
+/* Copy `len` bytes at `offset` of the serialised table (header, then counts) to `dst` */
+static void dhara_wear_table_copy(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data,
+                                  const dhara_wear_header_t *hdr, size_t offset, uint8_t *dst, size_t len)
+{
+    const uint8_t *counts = (const uint8_t *)dhara_priv_data->parent_handle->erase_counts;
+    if (offset < sizeof(*hdr)) {
+        size_t chunk = sizeof(*hdr) - offset < len ? sizeof(*hdr) - offset : len;
+        memcpy(dst, (const uint8_t *)hdr + offset, chunk);
+        dst += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+    memcpy(dst, counts + offset - sizeof(*hdr), len);
+}
+
+/* Append the current counts. The caller makes room for them in the metadata block. */
+static bool dhara_wear_write_table(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    const spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+    const size_t page_size = handle->chip.page_size;
+    const size_t table_size = dhara_wear_table_size(dhara_priv_data);
+    const dhara_page_t table = dhara_priv_data->meta_next;
+    dhara_wear_header_t hdr = {
+        .magic = DHARA_WEAR_MAGIC,
+        .num_blocks = handle->chip.num_blocks,
+        .crc = dhara_meta_crc(0, (const uint8_t *)handle->erase_counts, (size_t)handle->chip.num_blocks * sizeof(uint32_t)),
+    };
+
+    for (size_t offset = 0; offset < table_size; offset += page_size) {
+        size_t len = table_size - offset < page_size ? table_size - offset : page_size;
+        memset(dhara_priv_data->meta_buf, 0xff, page_size);
+        dhara_wear_table_copy(dhara_priv_data, &hdr, offset, dhara_priv_data->meta_buf, len);
+        if (!dhara_meta_append(dhara_priv_data)) {
+            return false;
+        }
+    }
+    dhara_priv_data->wear_table = table;
+    dhara_priv_data->wear_unsaved = 0;
+    return true;
+}
+
+static void dhara_wear_load_table(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_page_t table)
+{
+    spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+    const size_t page_size = handle->chip.page_size;
+    const size_t table_size = dhara_wear_table_size(dhara_priv_data);
+    const size_t counts_size = (size_t)handle->chip.num_blocks * sizeof(uint32_t);
+    uint8_t *counts = (uint8_t *)handle->erase_counts;
+    dhara_wear_header_t hdr;
+    dhara_error_t err;
+
+    if (table == DHARA_PAGE_NONE) {
+        // Never saved: first mount, or the option was just enabled
+        memset(counts, 0, counts_size);
+        return;
+    }
+    if (table < dhara_meta_first_page(dhara_priv_data) ||
+            table + dhara_wear_table_pages(dhara_priv_data) > dhara_priv_data->meta_next) {
+        goto fail;
+    }
+    for (size_t offset = 0; offset < table_size; offset += page_size) {
+        size_t len = table_size - offset < page_size ? table_size - offset : page_size;
+        if (dhara_nand_read(&dhara_priv_data->dhara_nand, table + offset / page_size, 0, len,
+                            dhara_priv_data->meta_buf, &err) < 0) {
+            goto fail;
+        }
+        const uint8_t *src = dhara_priv_data->meta_buf;
+        if (offset == 0) {
+            memcpy(&hdr, src, sizeof(hdr));
+            src += sizeof(hdr);
+            len -= sizeof(hdr);
+        }
+        memcpy(counts + (offset ? offset - sizeof(hdr) : 0), src, len);
+    }
+    if (hdr.magic == DHARA_WEAR_MAGIC && hdr.num_blocks == handle->chip.num_blocks &&
+            hdr.crc == dhara_meta_crc(0, counts, counts_size)) {
+        dhara_priv_data->wear_table = table;
+        return;
+    }
+
+fail:
+    ESP_LOGW(TAG, "No valid erase-count table, counting from zero");
+    memset(counts, 0, counts_size);
+}
+
+static inline void dhara_wear_count_erase(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_block_t b)
+{
+    dhara_priv_data->parent_handle->erase_counts[b]++;
+    dhara_priv_data->wear_unsaved++;
+    dhara_priv_data->wear_erases++;
+}
+#endif //CONFIG_NAND_FLASH_ERASE_COUNTS
+
+/* Make room for `pages` more pages in the metadata block. When it is full it is erased, and the erase-count table is
+ * carried over first. */
+static bool dhara_meta_reserve(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_page_t pages)
+{
+    const struct dhara_nand *n = &dhara_priv_data->dhara_nand;
+    const dhara_page_t first = dhara_meta_first_page(dhara_priv_data);
+    dhara_error_t err;
+
+    if (dhara_priv_data->meta_next == DHARA_PAGE_NONE) {
+        return false;
+    }
+    if (dhara_priv_data->meta_next - first + pages <= (1U << n->log2_ppb)) {
+        return true;
+    }
+
+    // The last record goes with the erase: until a new one is written there is nothing to trust
+    dhara_priv_data->ckpt_clean = false;
+    dhara_priv_data->wear_table = DHARA_PAGE_NONE;
+    if (dhara_nand_erase(n, dhara_meta_block(dhara_priv_data), &err) < 0) {
+        dhara_meta_fail(dhara_priv_data);
+        return false;
+    }
+    dhara_priv_data->meta_next = first;
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    return !dhara_wear_persistent(dhara_priv_data) || dhara_wear_write_table(dhara_priv_data);
+#else
+    return true;
+#endif
+}
+
+static void dhara_ckpt_write(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, uint32_t state)
+{
+    // Only a clean record can leave the state unchanged, so clear the flag first: a failure below must not leave a
+    // stale clean record to be trusted at the next mount
+    dhara_priv_data->ckpt_clean = false;
+    if (!dhara_meta_reserve(dhara_priv_data, 1)) {
+        return;
+    }
+
+    dhara_ckpt_record_t rec = {
+        .magic = DHARA_CKPT_MAGIC,
+        .state = state,
+        .num_blocks = dhara_priv_data->dhara_nand.num_blocks,
+        .root = dhara_journal_root(&dhara_priv_data->dhara_map.journal),
+        .epoch = dhara_priv_data->dhara_map.journal.epoch,
+        .wear_table = dhara_priv_data->wear_table,
+    };
+    rec.crc = dhara_meta_crc(0, (const uint8_t *)&rec, offsetof(dhara_ckpt_record_t, crc));
+    memset(dhara_priv_data->meta_buf, 0xff, 1 << dhara_priv_data->dhara_nand.log2_page_size);
+    memcpy(dhara_priv_data->meta_buf, &rec, sizeof(rec));
+    if (dhara_meta_append(dhara_priv_data)) {
+        dhara_priv_data->ckpt_clean = (state == DHARA_CKPT_STATE_CLEAN);
+    }
+}
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+/* Save the erase counts: a table, then a record pointing to it */
+static void dhara_wear_save(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    if (!dhara_wear_persistent(dhara_priv_data) ||
+            !dhara_meta_reserve(dhara_priv_data, dhara_wear_table_pages(dhara_priv_data) + 1)) {
+        return;
+    }
+    // Erasing the full metadata block above already wrote the table
+    if (dhara_priv_data->wear_unsaved > 0 && !dhara_wear_write_table(dhara_priv_data)) {
+        return;
+    }
+    dhara_ckpt_write(dhara_priv_data, DHARA_CKPT_STATE_DIRTY);
+}
+#endif
+
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+/* Called before anything in the journal is programmed or erased */
+static inline void dhara_ckpt_invalidate(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    if (dhara_priv_data->ckpt_clean) {
+        dhara_ckpt_write(dhara_priv_data, DHARA_CKPT_STATE_DIRTY);
+    }
+}
+
+/* Record that the journal is checkpointed at its current root, so that the next mount does not have to search for it */
+static void dhara_ckpt_mark_clean(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    const struct dhara_journal *journal = &dhara_priv_data->dhara_map.journal;
+    if (!dhara_priv_data->ckpt_clean && dhara_journal_is_clean(journal) && !dhara_journal_in_recovery(journal) &&
+            dhara_journal_root(journal) != DHARA_PAGE_NONE) {
+        dhara_ckpt_write(dhara_priv_data, DHARA_CKPT_STATE_CLEAN);
+    }
+}
+#endif //CONFIG_NAND_FLASH_FAST_MOUNT
+
+static void dhara_resume(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    dhara_ckpt_record_t rec;
+    dhara_error_t ignored;
+    bool loaded = dhara_meta_load(dhara_priv_data, &rec);
+
+    dhara_priv_data->wear_table = DHARA_PAGE_NONE;
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    dhara_wear_load_table(dhara_priv_data, loaded ? rec.wear_table : DHARA_PAGE_NONE);
+#endif
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+    dhara_priv_data->ckpt_clean = loaded && rec.state == DHARA_CKPT_STATE_CLEAN;
+    if (dhara_priv_data->ckpt_clean) {
+        if (dhara_map_resume_at(&dhara_priv_data->dhara_map, rec.root, (uint8_t)rec.epoch, &ignored) == 0) {
+            return;
+        }
+        ESP_LOGW(TAG, "Mount checkpoint does not match the journal, scanning");
+    }
+#endif
+    dhara_map_resume(&dhara_priv_data->dhara_map, &ignored);
+}
+#endif //DHARA_HAS_META_BLOCK
+
+#if CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+/* Does the journal hold data in block b, i.e. between its tail and its head? */
+static bool dhara_wl_block_in_use(const spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_block_t b)
+{
+    const struct dhara_journal *j = &dhara_priv_data->dhara_map.journal;
+    const uint8_t log2_ppb = dhara_priv_data->dhara_nand.log2_ppb;
+    const dhara_page_t total = dhara_priv_data->dhara_nand.num_blocks << log2_ppb;
+    const dhara_page_t used = (j->head + total - j->tail) % total;
+
+    if (used == 0) {
+        return false;
+    }
+    return (j->tail >> log2_ppb) == b || ((b << log2_ppb) + total - j->tail) % total < used;
+}
+
+/* Static wear levelling, a block's worth of garbage collection at most per call. Dhara's journal rotates through all
+ * its blocks, so data left in a block that is far less worn than the others can only be cold data that the rotation
+ * has not reached: collect up to the end of that block so that it is relocated and the block gets erased again. */
+static void dhara_wear_level(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    struct dhara_map *map = &dhara_priv_data->dhara_map;
+    const uint32_t *counts = dhara_priv_data->parent_handle->erase_counts;
+    const dhara_block_t num_blocks = dhara_priv_data->dhara_nand.num_blocks;
+
+    if (dhara_priv_data->wl_target == DHARA_BLOCK_NONE) {
+        // The distribution only changes with erases
+        if (dhara_priv_data->wl_checked_erases == dhara_priv_data->wear_erases) {
+            return;
+        }
+        dhara_priv_data->wl_checked_erases = dhara_priv_data->wear_erases;
+
+        uint32_t max_count = 0;
+        dhara_block_t least_worn = DHARA_BLOCK_NONE;
+        for (dhara_block_t b = 0; b < num_blocks; b++) {
+            max_count = counts[b] > max_count ? counts[b] : max_count;
+            if (dhara_wl_block_in_use(dhara_priv_data, b) &&
+                    (least_worn == DHARA_BLOCK_NONE || counts[b] < counts[least_worn]) &&
+                    !dhara_nand_is_bad(&dhara_priv_data->dhara_nand, b)) {
+                least_worn = b;
+            }
+        }
+        if (least_worn == DHARA_BLOCK_NONE || max_count - counts[least_worn] <= CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD) {
+            return;
+        }
+        ESP_LOGD(TAG, "static wear levelling: relocating block %"PRIu32" (%"PRIu32" erases, max %"PRIu32")",
+                 (uint32_t)least_worn, counts[least_worn], max_count);
+        dhara_priv_data->wl_target = least_worn;
+    }
+
+    for (dhara_page_t i = 0; i < (1U << dhara_priv_data->dhara_nand.log2_ppb); i++) {
+        dhara_page_t tail = map->journal.tail;
+        dhara_error_t err;
+        if (!dhara_wl_block_in_use(dhara_priv_data, dhara_priv_data->wl_target) ||
+                dhara_map_gc(map, &err) < 0 || map->journal.tail == tail) {
+            dhara_priv_data->wl_target = DHARA_BLOCK_NONE;
+            return;
+        }
+    }
+}
+#endif //CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+
 static esp_err_t dhara_init(spi_nand_flash_device_t *handle, void *bdl_handle)
 {
     // create a holder structure for dhara context
@@ -50,11 +673,54 @@ static esp_err_t dhara_init(spi_nand_flash_device_t *handle, void *bdl_handle)
     dhara_priv_data->dhara_nand.log2_page_size = handle->chip.log2_page_size;
     dhara_priv_data->dhara_nand.log2_ppb = handle->chip.log2_ppb;
     dhara_priv_data->dhara_nand.num_blocks = handle->chip.num_blocks;
+#if DHARA_COMPACT_META
+    // Compact metadata limits page numbers to 24 bits and sector numbers to DHARA_RADIX_DEPTH bits
+    ESP_RETURN_ON_FALSE(((uint64_t)handle->chip.num_blocks << handle->chip.log2_ppb) <= (1U << DHARA_RADIX_DEPTH),
+                        ESP_ERR_NOT_SUPPORTED, TAG, "%"PRIu32" blocks are too many for compact Dhara metadata",
+                        handle->chip.num_blocks);
+#endif
+#if DHARA_HAS_META_BLOCK
+    // The last block holds the mount checkpoints and the erase counts
+    dhara_priv_data->dhara_nand.num_blocks--;
+    dhara_priv_data->meta_buf = nand_alloc_page_buffer(handle);
+    if (dhara_priv_data->meta_buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    handle->erase_counts = heap_caps_calloc(handle->chip.num_blocks, sizeof(uint32_t), MALLOC_CAP_DEFAULT);
+    if (handle->erase_counts == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!dhara_wear_persistent(dhara_priv_data)) {
+        ESP_LOGW(TAG, "Erase counts of %"PRIu32" blocks do not fit in one block, they are not saved", handle->chip.num_blocks);
+    }
+#if CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+    dhara_priv_data->wl_target = DHARA_BLOCK_NONE;
+#endif
+#endif
 
     dhara_map_init(&dhara_priv_data->dhara_map, &dhara_priv_data->dhara_nand, handle->work_buffer, handle->config.gc_factor);
+#if DHARA_HAS_META_BLOCK
+    dhara_resume(dhara_priv_data);
+#else
     dhara_error_t ignored;
     dhara_map_resume(&dhara_priv_data->dhara_map, &ignored);
+#endif
+    // The journal reserves a few blocks for garbage collection, a partition must be larger than that. Its capacity
+    // does not account for bad blocks correctly below two blocks, so those are checked first.
+    ESP_RETURN_ON_FALSE(dhara_priv_data->dhara_nand.num_blocks >= 2 &&
+                        dhara_map_capacity(&dhara_priv_data->dhara_map) > 0, ESP_ERR_INVALID_SIZE, TAG,
+                        "%"PRIu32" blocks are too few for the wear-levelling layer", handle->chip.num_blocks);
 
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+    ESP_RETURN_ON_ERROR(dhara_gc_task_start(dhara_priv_data), TAG, "");
+#endif
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+    ESP_RETURN_ON_ERROR(dhara_scrub_task_start(dhara_priv_data), TAG, "");
+#endif
+    ESP_RETURN_ON_ERROR(nand_write_cache_create(handle), TAG, "");
+    dhara_priv_data->mounted = true;
     return ESP_OK;
 }
 
@@ -71,10 +737,15 @@ static esp_err_t dhara_read(spi_nand_flash_device_t *handle, uint8_t *buffer, dh
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
     dhara_error_t err;
-    if (dhara_map_read(&dhara_priv_data->dhara_map, sector_id, handle->read_buffer, &err)) {
+    dhara_note_access(dhara_priv_data);
+    // Read straight into the caller's buffer when the page can be transferred to it directly
+    uint8_t *dst = nand_buffer_dma_capable(buffer) ? buffer : handle->read_buffer;
+    if (dhara_map_read(&dhara_priv_data->dhara_map, sector_id, dst, &err)) {
         return ESP_ERR_FLASH_BASE + err;
     }
-    memcpy(buffer, handle->read_buffer, handle->chip.page_size);
+    if (dst != buffer) {
+        memcpy(buffer, dst, handle->chip.page_size);
+    }
     return ESP_OK;
 }
 
@@ -82,16 +753,237 @@ static esp_err_t dhara_write(spi_nand_flash_device_t *handle, const uint8_t *buf
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
     dhara_error_t err;
-    if (dhara_map_write(&dhara_priv_data->dhara_map, sector_id, buffer, &err)) {
+    dhara_note_access(dhara_priv_data);
+    if (dhara_timed_write(dhara_priv_data, sector_id, buffer, &err)) {
         return ESP_ERR_FLASH_BASE + err;
     }
     return ESP_OK;
 }
 
+/* Read `count` physically consecutive pages into `dst`. On return the ECC status of the device holds the worst
+ * correctable class seen across the run. */
+static esp_err_t dhara_read_physical_run(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, dhara_page_t page,
+        uint32_t count, uint8_t *dst)
+{
+    spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+#ifdef CONFIG_NAND_FLASH_ENABLE_BDL
+    esp_blockdev_handle_t bdl_handle = dhara_priv_data->bdl_handle;
+    size_t run_len = (size_t)count << handle->chip.log2_page_size;
+    return bdl_handle->ops->read(bdl_handle, dst, run_len, (uint64_t)page * bdl_handle->geometry.read_size, run_len);
+#else
+    return nand_read_pages(handle, page, count, dst);
+#endif
+}
+
+static esp_err_t dhara_read_pages(spi_nand_flash_device_t *handle, uint8_t *buffer, dhara_sector_t start_sector, uint32_t count)
+{
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
+    const uint8_t log2_page_size = handle->chip.log2_page_size;
+    dhara_page_t phys[DHARA_READ_BATCH_PAGES];
+    dhara_error_t err;
+
+    dhara_note_access(dhara_priv_data);
+    while (count > 0) {
+        uint32_t batch = count < DHARA_READ_BATCH_PAGES ? count : DHARA_READ_BATCH_PAGES;
+
+        // Resolve the whole batch first, so physically consecutive pages can be read in one go
+        for (uint32_t i = 0; i < batch; i++) {
+            if (dhara_map_find(&dhara_priv_data->dhara_map, start_sector + i, &phys[i], &err)) {
+                if (err != DHARA_E_NOT_FOUND) {
+                    return ESP_ERR_FLASH_BASE + err;
+                }
+                phys[i] = DHARA_PAGE_NONE;
+            }
+        }
+
+        uint32_t done = 0;
+        while (done < batch) {
+            uint8_t *dst = buffer + ((size_t)done << log2_page_size);
+            if (phys[done] == DHARA_PAGE_NONE) {
+                memset(dst, 0xff, handle->chip.page_size);
+                done++;
+                continue;
+            }
+
+            uint32_t run = 1;
+            while (done + run < batch && phys[done + run] == phys[done] + run) {
+                run++;
+            }
+
+            handle->chip.ecc_data.ecc_corrected_bits_status = NAND_ECC_OK;
+            esp_err_t ret = dhara_read_physical_run(dhara_priv_data, phys[done], run, dst);
+            if (ret != ESP_OK) {
+                if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_NOT_CORRECTED) {
+                    return ESP_ERR_FLASH_BASE + DHARA_E_ECC;
+                }
+                return ret;
+            }
+
+            if (handle->chip.ecc_data.ecc_corrected_bits_status && nand_ecc_exceeds_data_refresh_threshold(handle)) {
+                // Soft ECC error: rewrite the run to refresh it. The writes may relocate pages through GC, so the
+                // rest of this batch has to be resolved again.
+                for (uint32_t i = 0; i < run; i++) {
+                    if (dhara_map_write(&dhara_priv_data->dhara_map, start_sector + done + i,
+                                        dst + ((size_t)i << log2_page_size), &err)) {
+                        return ESP_ERR_FLASH_BASE + err;
+                    }
+                }
+                batch = done + run;
+            }
+            done += run;
+        }
+
+        buffer += (size_t)batch << log2_page_size;
+        start_sector += batch;
+        count -= batch;
+    }
+    return ESP_OK;
+}
+
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+/* Check the next CONFIG_NAND_FLASH_ECC_SCRUB_SECTORS_PER_STEP logical pages, rewriting those whose ECC corrected-bit
+ * count reached the refresh threshold. Called with the device mutex held. @return true once a pass is complete */
+static bool dhara_scrub_step(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+    struct dhara_map *map = &dhara_priv_data->dhara_map;
+    nand_scrub_stats_t *stats = &handle->scrub_stats;
+    dhara_error_t err;
+
+    stats->num_sectors = dhara_map_capacity(map);
+    for (int i = 0; i < CONFIG_NAND_FLASH_ECC_SCRUB_SECTORS_PER_STEP && stats->next_sector < stats->num_sectors; i++) {
+        dhara_sector_t sector = stats->next_sector++;
+        dhara_page_t page;
+        if (dhara_map_find(map, sector, &page, &err)) {
+            if (err != DHARA_E_NOT_FOUND) {
+                ESP_LOGW(TAG, "scrub: lookup of sector %"PRIu32" failed: %s", sector, dhara_strerror(err));
+            }
+            continue;
+        }
+
+        handle->chip.ecc_data.ecc_corrected_bits_status = NAND_ECC_OK;
+        esp_err_t ret = dhara_read_physical_run(dhara_priv_data, page, 1, dhara_priv_data->scrub_buf);
+        stats->pages_checked++;
+        if (ret != ESP_OK) {
+            if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_NOT_CORRECTED) {
+                // Nothing left to rescue, the application gets the error when it reads the sector
+                stats->uncorrectable++;
+                ESP_LOGW(TAG, "scrub: sector %"PRIu32" has an uncorrectable ECC error", sector);
+            } else {
+                ESP_LOGW(TAG, "scrub: reading sector %"PRIu32" failed: %d", sector, ret);
+            }
+            continue;
+        }
+
+        if (handle->chip.ecc_data.ecc_corrected_bits_status && nand_ecc_exceeds_data_refresh_threshold(handle)) {
+            // Same refresh as on the read path: write the corrected data back to a fresh page
+            if (dhara_map_write(map, sector, dhara_priv_data->scrub_buf, &err)) {
+                ESP_LOGW(TAG, "scrub: refreshing sector %"PRIu32" failed: %s", sector, dhara_strerror(err));
+            } else {
+                stats->pages_refreshed++;
+            }
+        }
+    }
+
+    if (stats->next_sector >= stats->num_sectors) {
+        stats->next_sector = 0;
+        stats->passes++;
+        return true;
+    }
+    return false;
+}
+
+static void dhara_scrub_task(void *arg)
+{
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)arg;
+    spi_nand_flash_device_t *handle = dhara_priv_data->parent_handle;
+    TickType_t step_ticks = pdMS_TO_TICKS(CONFIG_NAND_FLASH_ECC_SCRUB_STEP_INTERVAL_MS);
+    if (step_ticks == 0) {
+        step_ticks = 1;
+    }
+    const TickType_t pass_ticks = pdMS_TO_TICKS((uint64_t)CONFIG_NAND_FLASH_ECC_SCRUB_PASS_INTERVAL_S * 1000);
+    TickType_t wait_ticks = step_ticks;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+        if (dhara_priv_data->scrub_task_stop) {
+            break;
+        }
+        wait_ticks = step_ticks;
+        if ((TickType_t)(xTaskGetTickCount() - dhara_priv_data->last_access_tick) < step_ticks) {
+            continue;
+        }
+
+        xSemaphoreTake(handle->mutex, portMAX_DELAY);
+        bool pass_done = dhara_scrub_step(dhara_priv_data);
+        xSemaphoreGive(handle->mutex);
+
+        if (pass_done && pass_ticks > 0) {
+            wait_ticks = pass_ticks;
+        }
+    }
+
+    xSemaphoreGive(dhara_priv_data->scrub_task_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t dhara_scrub_task_start(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    dhara_priv_data->scrub_buf = nand_alloc_page_buffer(dhara_priv_data->parent_handle);
+    ESP_RETURN_ON_FALSE(dhara_priv_data->scrub_buf, ESP_ERR_NO_MEM, TAG, "nomem");
+    dhara_priv_data->scrub_task_done = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(dhara_priv_data->scrub_task_done, ESP_ERR_NO_MEM, TAG, "nomem");
+    dhara_priv_data->last_access_tick = xTaskGetTickCount();
+    BaseType_t res = xTaskCreatePinnedToCore(dhara_scrub_task, "nand_scrub", CONFIG_NAND_FLASH_ECC_SCRUB_TASK_STACK_SIZE,
+                     dhara_priv_data, CONFIG_NAND_FLASH_ECC_SCRUB_TASK_PRIORITY, &dhara_priv_data->scrub_task,
+#if CONFIG_NAND_FLASH_ECC_SCRUB_TASK_CORE < 0
+                     tskNO_AFFINITY);
+#else
+                     CONFIG_NAND_FLASH_ECC_SCRUB_TASK_CORE);
+#endif
+    if (res != pdPASS) {
+        vSemaphoreDelete(dhara_priv_data->scrub_task_done);
+        dhara_priv_data->scrub_task_done = NULL;
+        dhara_priv_data->scrub_task = NULL;
+        ESP_LOGE(TAG, "Failed to create scrub task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void dhara_scrub_task_stop(spi_nand_flash_dhara_priv_data_t *dhara_priv_data)
+{
+    if (dhara_priv_data->scrub_task != NULL) {
+        dhara_priv_data->scrub_task_stop = true;
+        xTaskNotifyGive(dhara_priv_data->scrub_task);
+        xSemaphoreTake(dhara_priv_data->scrub_task_done, portMAX_DELAY);
+        vSemaphoreDelete(dhara_priv_data->scrub_task_done);
+        dhara_priv_data->scrub_task = NULL;
+    }
+    free(dhara_priv_data->scrub_buf);
+    dhara_priv_data->scrub_buf = NULL;
+}
+#endif //CONFIG_NAND_FLASH_ECC_SCRUB
+
+static esp_err_t dhara_write_pages(spi_nand_flash_device_t *handle, const uint8_t *buffer, dhara_sector_t start_sector, uint32_t count)
+{
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
+    dhara_error_t err;
+    dhara_note_access(dhara_priv_data);
+    for (uint32_t i = 0; i < count; i++) {
+        if (dhara_timed_write(dhara_priv_data, start_sector + i, buffer, &err)) {
+            return ESP_ERR_FLASH_BASE + err;
+        }
+        buffer += handle->chip.page_size;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t dhara_copy_sector(spi_nand_flash_device_t *handle, dhara_sector_t src_sec, dhara_sector_t dst_sec)
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
     dhara_error_t err;
+    dhara_note_access(dhara_priv_data);
     if (dhara_map_copy_sector(&dhara_priv_data->dhara_map, src_sec, dst_sec, &err)) {
         return ESP_ERR_FLASH_BASE + err;
     }
@@ -102,22 +994,53 @@ static esp_err_t dhara_trim(spi_nand_flash_device_t *handle, dhara_sector_t sect
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
     dhara_error_t err;
+    dhara_note_access(dhara_priv_data);
     if (dhara_map_trim(&dhara_priv_data->dhara_map, sector_id, &err)) {
         return ESP_ERR_FLASH_BASE + err;
     }
     return ESP_OK;
 }
 
-static esp_err_t dhara_sync(spi_nand_flash_device_t *handle)
+static esp_err_t dhara_trim_range(spi_nand_flash_device_t *handle, dhara_sector_t start_sector, uint32_t count)
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
     dhara_error_t err;
+    dhara_note_access(dhara_priv_data);
+    if (dhara_map_trim_range(&dhara_priv_data->dhara_map, start_sector, count, &err)) {
+        return ESP_ERR_FLASH_BASE + err;
+    }
+    return ESP_OK;
+}
+
+/* Synchronise the journal, then save the erase counts once `wear_save_threshold` erases have not been saved */
+static esp_err_t dhara_sync_meta(spi_nand_flash_dhara_priv_data_t *dhara_priv_data, uint32_t wear_save_threshold)
+{
+    dhara_error_t err;
+#if CONFIG_NAND_FLASH_ERASE_COUNTS && CONFIG_NAND_FLASH_STATIC_WL_THRESHOLD > 0
+    dhara_wear_level(dhara_priv_data);
+#endif
     if (dhara_map_sync(&dhara_priv_data->dhara_map, &err)) {
         return ESP_ERR_FLASH_BASE + err;
     }
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    if (dhara_priv_data->wear_unsaved >= wear_save_threshold) {
+        dhara_wear_save(dhara_priv_data);
+    }
+#endif
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+    dhara_ckpt_mark_clean(dhara_priv_data);
+#endif
     return ESP_OK;
 }
 
+static esp_err_t dhara_sync(spi_nand_flash_device_t *handle)
+{
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
+    // Saving the counts costs a few pages of the metadata block: only do it every 1/16 of the blocks erased
+    uint32_t wear_save_threshold = handle->chip.num_blocks / 16;
+    return dhara_sync_meta(dhara_priv_data, wear_save_threshold ? wear_save_threshold : 1);
+}
+
 static esp_err_t dhara_get_capacity(spi_nand_flash_device_t *handle, dhara_sector_t *number_of_sectors)
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
@@ -137,12 +1060,46 @@ static esp_err_t dhara_gc(spi_nand_flash_device_t *handle)
 
 static esp_err_t dhara_erase_chip(spi_nand_flash_device_t *handle)
 {
+#if DHARA_HAS_META_BLOCK
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
+    esp_err_t ret = nand_erase_chip(handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    for (dhara_block_t b = 0; b < handle->chip.num_blocks; b++) {
+        if (!dhara_nand_is_bad(&dhara_priv_data->dhara_nand, b)) {
+            dhara_wear_count_erase(dhara_priv_data, b);
+        }
+    }
+#endif
+    if (dhara_priv_data->meta_next != DHARA_PAGE_NONE) {
+        // The metadata block was erased along with the rest
+        dhara_priv_data->meta_next = dhara_meta_first_page(dhara_priv_data);
+        dhara_priv_data->wear_table = DHARA_PAGE_NONE;
+        dhara_priv_data->ckpt_clean = false;
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+        // The counts outlive the data: save them straight away
+        dhara_wear_save(dhara_priv_data);
+#endif
+    }
+    return ESP_OK;
+#else
     return nand_erase_chip(handle);
+#endif
 }
 
 static esp_err_t dhara_erase_block(spi_nand_flash_device_t *handle, uint32_t block)
 {
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    esp_err_t ret = nand_erase_block(handle, block);
+    if (ret == ESP_OK && block < handle->chip.num_blocks) {
+        dhara_wear_count_erase((spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data, block);
+    }
+    return ret;
+#else
     return nand_erase_block(handle, block);
+#endif
 }
 
 
@@ -158,6 +1115,9 @@ const spi_nand_ops dhara_nand_ops = {
     .copy_sector = &dhara_copy_sector,
     .get_capacity = &dhara_get_capacity,
     .gc = &dhara_gc,
+    .read_pages = &dhara_read_pages,
+    .write_pages = &dhara_write_pages,
+    .trim_range = &dhara_trim_range,
 };
 
 esp_err_t nand_wl_attach_ops(spi_nand_flash_device_t *handle)
@@ -171,7 +1131,31 @@ esp_err_t nand_wl_attach_ops(spi_nand_flash_device_t *handle)
 
 esp_err_t nand_wl_detach_ops(spi_nand_flash_device_t *handle)
 {
+    spi_nand_flash_dhara_priv_data_t *dhara_priv_data = (spi_nand_flash_dhara_priv_data_t *)handle->ops_priv_data;
+    if (dhara_priv_data) {
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+        dhara_gc_task_stop(dhara_priv_data);
+#endif
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+        dhara_scrub_task_stop(dhara_priv_data);
+#endif
+        // Write back what is left in the write cache while the wear-levelling layer is still there
+        nand_write_cache_destroy(handle);
+#if DHARA_HAS_META_BLOCK
+        // Clean shutdown: save all the erase counts and checkpoint the journal, so that the next mount can skip the
+        // search for it. Nothing is written if dhara_init() failed, the journal or the counts may not be loaded.
+        if (dhara_priv_data->mounted) {
+            dhara_sync_meta(dhara_priv_data, 1);
+        }
+        free(dhara_priv_data->meta_buf);
+#endif
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+        free(handle->erase_counts);
+        handle->erase_counts = NULL;
+#endif
+    }
     free(handle->ops_priv_data);
+    handle->ops_priv_data = NULL;
     handle->ops = NULL;
     return ESP_OK;
 }
@@ -211,6 +1195,11 @@ int dhara_nand_prog(const struct dhara_nand *n, dhara_page_t p, const uint8_t *d
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = __containerof(n, spi_nand_flash_dhara_priv_data_t, dhara_nand);
     esp_err_t ret = ESP_OK;
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+    if ((p >> n->log2_ppb) != dhara_meta_block(dhara_priv_data)) {
+        dhara_ckpt_invalidate(dhara_priv_data);
+    }
+#endif
 #ifdef CONFIG_NAND_FLASH_ENABLE_BDL
     assert(dhara_priv_data->bdl_handle != NULL);
     esp_blockdev_handle_t bdl_handle = dhara_priv_data->bdl_handle;
@@ -233,6 +1222,11 @@ int dhara_nand_erase(const struct dhara_nand *n, dhara_block_t b, dhara_error_t
 {
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = __containerof(n, spi_nand_flash_dhara_priv_data_t, dhara_nand);
     esp_err_t ret = ESP_OK;
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+    if (b != dhara_meta_block(dhara_priv_data)) {
+        dhara_ckpt_invalidate(dhara_priv_data);
+    }
+#endif
 #ifdef CONFIG_NAND_FLASH_ENABLE_BDL
     assert(dhara_priv_data->bdl_handle != NULL);
     esp_blockdev_handle_t bdl_handle = dhara_priv_data->bdl_handle;
@@ -248,6 +1242,9 @@ int dhara_nand_erase(const struct dhara_nand *n, dhara_block_t b, dhara_error_t
         }
         return -1;
     }
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    dhara_wear_count_erase(dhara_priv_data, b);
+#endif
     return 0;
 }
 
@@ -317,6 +1314,9 @@ int dhara_nand_copy(const struct dhara_nand *n, dhara_page_t src, dhara_page_t d
     spi_nand_flash_dhara_priv_data_t *dhara_priv_data = __containerof(n, spi_nand_flash_dhara_priv_data_t, dhara_nand);
     spi_nand_flash_device_t *dev_handle = NULL;
     esp_err_t ret = ESP_OK;
+#if CONFIG_NAND_FLASH_FAST_MOUNT
+    dhara_ckpt_invalidate(dhara_priv_data);
+#endif
 
 #ifdef CONFIG_NAND_FLASH_ENABLE_BDL
     assert(dhara_priv_data->bdl_handle != NULL);
@@ -12,6 +12,7 @@
 #include "nand.h"
 #include "nand_impl.h"
 #include "nand_device_types.h"
+#include "nand_write_cache.h"
 
 #ifdef CONFIG_NAND_FLASH_ENABLE_BDL
 #include "esp_blockdev.h"
@@ -39,16 +40,116 @@ esp_err_t spi_nand_flash_init_device(spi_nand_flash_config_t *config, spi_nand_f
     ret = nand_wl_attach_ops(*handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to attach wear-leveling operations");
+        goto fail;
     }
 
     if ((*handle)->ops->init == NULL) {
         ESP_LOGE(TAG, "Failed to initialize spi_nand_ops");
         ret = ESP_FAIL;
-        return ret;
+        goto fail;
+    }
+    ret = (*handle)->ops->init(*handle, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize the wear-leveling layer");
+        goto fail;
     }
-    (*handle)->ops->init(*handle, NULL);
 
     return ESP_OK;
+
+fail:
+    spi_nand_flash_deinit_device(*handle);
+    *handle = NULL;
+    return ret;
+#endif // CONFIG_NAND_FLASH_ENABLE_BDL
+}
+
+esp_err_t nand_split_partitions(spi_nand_flash_device_t *chip, const spi_nand_flash_partition_config_t *partitions,
+                                uint32_t num_partitions, spi_nand_flash_device_t **handles)
+{
+    esp_err_t ret = ESP_OK;
+    uint32_t first_block = 0;
+
+    memset(handles, 0, num_partitions * sizeof(*handles));
+    chip->chip_refs = heap_caps_malloc(sizeof(uint32_t), MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE(chip->chip_refs, ESP_ERR_NO_MEM, end, TAG, "nomem");
+    *chip->chip_refs = 1;
+
+    for (uint32_t i = 0; i < num_partitions; i++) {
+        uint32_t blocks_left = chip->chip.num_blocks - first_block;
+        uint32_t num_blocks = partitions[i].num_blocks;
+        if (num_blocks == 0 && i == num_partitions - 1) {
+            num_blocks = blocks_left;
+        }
+        ESP_GOTO_ON_FALSE(num_blocks > 0 && num_blocks <= blocks_left, ESP_ERR_INVALID_SIZE, fail, TAG,
+                          "Partition %"PRIu32" (%"PRIu32" blocks) does not fit in the %"PRIu32" blocks left", i,
+                          num_blocks, blocks_left);
+
+        spi_nand_flash_device_t *handle = heap_caps_malloc(sizeof(spi_nand_flash_device_t), MALLOC_CAP_DEFAULT);
+        ESP_GOTO_ON_FALSE(handle, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+        // Geometry, SPI device or emulator, mutex and shared buffers are the chip's
+        memcpy(handle, chip, sizeof(spi_nand_flash_device_t));
+        handle->first_block = first_block;
+        handle->chip.num_blocks = num_blocks;
+        if (partitions[i].gc_factor) {
+            handle->config.gc_factor = partitions[i].gc_factor;
+        }
+        // The journal of each partition keeps its metadata in its own work buffer
+        handle->work_buffer = nand_alloc_page_buffer(chip);
+        handle->bad_block_bitmap = heap_caps_calloc(NAND_BAD_BLOCK_BITMAP_WORDS(num_blocks), sizeof(uint32_t), MALLOC_CAP_DEFAULT);
+        (*chip->chip_refs)++;
+        handles[i] = handle;
+        ESP_GOTO_ON_FALSE(handle->work_buffer && handle->bad_block_bitmap, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+        first_block += num_blocks;
+    }
+    goto end;
+
+fail:
+    for (uint32_t i = 0; i < num_partitions; i++) {
+        if (handles[i]) {
+            nand_release_device(handles[i]);
+            handles[i] = NULL;
+        }
+    }
+end:
+    nand_release_device(chip);
+    return ret;
+}
+
+esp_err_t spi_nand_flash_init_partitions(spi_nand_flash_config_t *config,
+        const spi_nand_flash_partition_config_t *partitions, uint32_t num_partitions,
+        spi_nand_flash_device_t **handles)
+{
+#ifdef CONFIG_NAND_FLASH_ENABLE_BDL
+    ESP_LOGE(TAG, "spi_nand_flash_init_partitions() is not supported when BDL is enabled. "
+             "Use spi_nand_flash_init_partitions_with_layers() instead");
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    ESP_RETURN_ON_FALSE(config && partitions && num_partitions > 0 && handles, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    if (!config->gc_factor) {
+        config->gc_factor = 45;
+    }
+
+    spi_nand_flash_device_t *chip = NULL;
+    esp_err_t ret = nand_init_device(config, &chip);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ESP_RETURN_ON_ERROR(nand_split_partitions(chip, partitions, num_partitions, handles), TAG, "");
+
+    for (uint32_t i = 0; i < num_partitions && ret == ESP_OK; i++) {
+        ret = nand_wl_attach_ops(handles[i]);
+        if (ret == ESP_OK) {
+            ret = handles[i]->ops->init(handles[i], NULL);
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize the wear-leveling layer of the partitions");
+        for (uint32_t i = 0; i < num_partitions; i++) {
+            spi_nand_flash_deinit_device(handles[i]);
+            handles[i] = NULL;
+        }
+    }
+    return ret;
 #endif // CONFIG_NAND_FLASH_ENABLE_BDL
 }
 
@@ -62,6 +163,7 @@ esp_err_t spi_nand_erase_chip(spi_nand_flash_device_t *handle)
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
+    nand_write_cache_invalidate(handle);
     ret = handle->ops->erase_chip(handle);
     if (ret) {
         goto end;
@@ -73,6 +175,23 @@ end:
     return ret;
 }
 
+// Must be called with handle->mutex held
+static esp_err_t read_page_locked(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t page_id)
+{
+    if (nand_write_cache_read(handle, buffer, page_id)) {
+        return ESP_OK;
+    }
+    esp_err_t ret = handle->ops->read(handle, buffer, page_id);
+    // After a successful read operation, check the ECC corrected bit status; if the read fails, return an error
+    if (ret == ESP_OK && handle->chip.ecc_data.ecc_corrected_bits_status) {
+        // This indicates a soft ECC error, we rewrite the page to recover if corrected bits are greater than refresh threshold
+        if (nand_ecc_exceeds_data_refresh_threshold(handle)) {
+            ret = handle->ops->write(handle, buffer, page_id);
+        }
+    }
+    return ret;
+}
+
 esp_err_t spi_nand_flash_read_page(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t page_id)
 {
     esp_err_t ret = ESP_OK;
@@ -82,14 +201,31 @@ esp_err_t spi_nand_flash_read_page(spi_nand_flash_device_t *handle, uint8_t *buf
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
-    ret = handle->ops->read(handle, buffer, page_id);
-    // After a successful read operation, check the ECC corrected bit status; if the read fails, return an error
-    if (ret == ESP_OK && handle->chip.ecc_data.ecc_corrected_bits_status) {
-        // This indicates a soft ECC error, we rewrite the page to recover if corrected bits are greater than refresh threshold
-        if (nand_ecc_exceeds_data_refresh_threshold(handle)) {
-            ret = handle->ops->write(handle, buffer, page_id);
+    ret = read_page_locked(handle, buffer, page_id);
+    xSemaphoreGive(handle->mutex);
+
+    return ret;
+}
+
+esp_err_t spi_nand_flash_read_pages(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_page, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (handle->ops->read_pages == NULL && handle->ops->read == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(handle->mutex, portMAX_DELAY);
+    if (handle->ops->read_pages) {
+        ret = handle->ops->read_pages(handle, buffer, start_page, count);
+    } else {
+        for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+            ret = read_page_locked(handle, buffer + (size_t)i * handle->chip.page_size, start_page + i);
         }
     }
+    if (ret == ESP_OK) {
+        nand_write_cache_overlay(handle, buffer, start_page, count);
+    }
     xSemaphoreGive(handle->mutex);
 
     return ret;
@@ -109,7 +245,11 @@ esp_err_t spi_nand_flash_copy_page(spi_nand_flash_device_t *handle, uint32_t src
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
-    ret = handle->ops->copy_sector(handle, src_page, dst_page);
+    ret = nand_write_cache_flush_page(handle, src_page);
+    if (ret == ESP_OK) {
+        nand_write_cache_discard(handle, dst_page, 1);
+        ret = handle->ops->copy_sector(handle, src_page, dst_page);
+    }
     xSemaphoreGive(handle->mutex);
 
     return ret;
@@ -129,7 +269,51 @@ esp_err_t spi_nand_flash_write_page(spi_nand_flash_device_t *handle, const uint8
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
-    ret = handle->ops->write(handle, buffer, page_id);
+    if (nand_write_cache_bypass(handle, page_id, 1)) {
+        ret = handle->ops->write(handle, buffer, page_id);
+    } else {
+        ret = nand_write_cache_write(handle, buffer, page_id);
+    }
+#ifdef CONFIG_IDF_TARGET_LINUX
+    if (ret == ESP_OK) {
+        nand_emul_record_host_writes(handle, 1);
+    }
+#endif
+    xSemaphoreGive(handle->mutex);
+
+    return ret;
+}
+
+esp_err_t spi_nand_flash_write_pages(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t start_page, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (handle->ops->write_pages == NULL && handle->ops->write == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(handle->mutex, portMAX_DELAY);
+    if (!nand_write_cache_bypass(handle, start_page, count)) {
+        for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+            ret = nand_write_cache_write(handle, buffer + (size_t)i * handle->chip.page_size, start_page + i);
+        }
+        goto end;
+    }
+    // Large transfers go straight to the wear-levelling layer, replacing any cached copy
+    nand_write_cache_discard(handle, start_page, count);
+    if (handle->ops->write_pages) {
+        ret = handle->ops->write_pages(handle, buffer, start_page, count);
+    } else {
+        for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+            ret = handle->ops->write(handle, buffer + (size_t)i * handle->chip.page_size, start_page + i);
+        }
+    }
+end:
+#ifdef CONFIG_IDF_TARGET_LINUX
+    if (ret == ESP_OK) {
+        nand_emul_record_host_writes(handle, count);
+    }
+#endif
     xSemaphoreGive(handle->mutex);
 
     return ret;
@@ -149,12 +333,35 @@ esp_err_t spi_nand_flash_trim(spi_nand_flash_device_t *handle, uint32_t page_id)
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
+    nand_write_cache_discard(handle, page_id, 1);
     ret = handle->ops->trim(handle, page_id);
     xSemaphoreGive(handle->mutex);
 
     return ret;
 }
 
+esp_err_t spi_nand_flash_trim_range(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (handle->ops->trim_range == NULL && handle->ops->trim == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(handle->mutex, portMAX_DELAY);
+    nand_write_cache_discard(handle, start_page, count);
+    if (handle->ops->trim_range) {
+        ret = handle->ops->trim_range(handle, start_page, count);
+    } else {
+        for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+            ret = handle->ops->trim(handle, start_page + i);
+        }
+    }
+    xSemaphoreGive(handle->mutex);
+
+    return ret;
+}
+
 esp_err_t spi_nand_flash_sync(spi_nand_flash_device_t *handle)
 {
     esp_err_t ret = ESP_OK;
@@ -164,7 +371,10 @@ esp_err_t spi_nand_flash_sync(spi_nand_flash_device_t *handle)
     }
 
     xSemaphoreTake(handle->mutex, portMAX_DELAY);
-    ret = handle->ops->sync(handle);
+    ret = nand_write_cache_flush(handle);
+    if (ret == ESP_OK) {
+        ret = handle->ops->sync(handle);
+    }
     xSemaphoreGive(handle->mutex);
 
     return ret;
@@ -222,25 +432,40 @@ esp_err_t spi_nand_flash_get_block_num(spi_nand_flash_device_t *handle, uint32_t
     return ESP_OK;
 }
 
-esp_err_t spi_nand_flash_deinit_device(spi_nand_flash_device_t *handle)
+esp_err_t nand_release_device(spi_nand_flash_device_t *handle)
 {
     esp_err_t ret = ESP_OK;
+    bool last = true;
+    if (handle->chip_refs) {
+        xSemaphoreTake(handle->mutex, portMAX_DELAY);
+        last = --(*handle->chip_refs) == 0;
+        xSemaphoreGive(handle->mutex);
+    }
+    if (last) {
 #ifdef CONFIG_IDF_TARGET_LINUX
-    ret = nand_emul_deinit(handle);
+        ret = nand_emul_deinit(handle);
 #endif
-    nand_wl_detach_ops(handle);
-    free(handle->work_buffer);
-    free(handle->read_buffer);
-#ifndef CONFIG_IDF_TARGET_LINUX
-    free(handle->temp_buffer);
-#endif
-    if (handle->mutex) {
-        vSemaphoreDelete(handle->mutex);
+        free(handle->read_buffer);
+        free(handle->temp_buffer);
+        free(handle->verify_buffer);
+        if (handle->mutex) {
+            vSemaphoreDelete(handle->mutex);
+        }
+        free(handle->chip_refs);
     }
+    free(handle->work_buffer);
+    free(handle->bad_block_bitmap);
     free(handle);
     return ret;
 }
 
+esp_err_t spi_nand_flash_deinit_device(spi_nand_flash_device_t *handle)
+{
+    // Detach first: this writes back any pages still held in the write cache
+    nand_wl_detach_ops(handle);
+    return nand_release_device(handle);
+}
+
 // NEW LAYERED ARCHITECTURE API IMPLEMENTATION
 //---------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -272,4 +497,57 @@ esp_err_t spi_nand_flash_init_with_layers(spi_nand_flash_config_t *config,
     ESP_LOGD(TAG, "SPI NAND Flash initialized with layered block device architecture");
     return ESP_OK;
 }
+
+esp_err_t spi_nand_flash_init_partitions_with_layers(spi_nand_flash_config_t *config,
+        const spi_nand_flash_partition_config_t *partitions, uint32_t num_partitions,
+        esp_blockdev_handle_t *wl_bdls)
+{
+    ESP_RETURN_ON_FALSE(config && partitions && num_partitions > 0 && wl_bdls, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+
+    // Set default GC factor if not specified
+    if (!config->gc_factor) {
+        config->gc_factor = 45;
+    }
+
+    spi_nand_flash_device_t **handles = heap_caps_calloc(num_partitions, sizeof(spi_nand_flash_device_t *), MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(handles, ESP_ERR_NO_MEM, TAG, "nomem");
+    memset(wl_bdls, 0, num_partitions * sizeof(esp_blockdev_handle_t));
+
+    spi_nand_flash_device_t *chip = NULL;
+    esp_err_t ret = nand_init_device(config, &chip);
+    if (ret == ESP_OK) {
+        ret = nand_split_partitions(chip, partitions, num_partitions, handles);
+    }
+
+    // A Flash BDL, then a WL BDL on top of it, for each partition
+    for (uint32_t i = 0; i < num_partitions && ret == ESP_OK; i++) {
+        esp_blockdev_handle_t flash_bdl;
+        ret = nand_flash_blockdev_create(handles[i], &flash_bdl);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create Flash BDL of partition %"PRIu32, i);
+            break;
+        }
+        // The device now belongs to the Flash BDL, and is released with it
+        handles[i] = NULL;
+        ret = spi_nand_flash_wl_get_blockdev(flash_bdl, &wl_bdls[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create WL BDL of partition %"PRIu32, i);
+            flash_bdl->ops->release(flash_bdl);
+        }
+    }
+
+    if (ret != ESP_OK) {
+        for (uint32_t i = 0; i < num_partitions; i++) {
+            if (wl_bdls[i]) {
+                wl_bdls[i]->ops->release(wl_bdls[i]);
+                wl_bdls[i] = NULL;
+            }
+            if (handles[i]) {
+                nand_release_device(handles[i]);
+            }
+        }
+    }
+    free(handles);
+    return ret;
+}
 #endif // CONFIG_NAND_FLASH_ENABLE_BDL
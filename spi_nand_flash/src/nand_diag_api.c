@@ -15,6 +15,8 @@
 #include "esp_log.h"
 #include "esp_check.h"
 #include "nand_device_types.h"
+#include "nand_write_cache.h"
+#include "nand_impl.h"
 
 static const char *TAG = "nand_diag";
 
@@ -84,3 +86,148 @@ esp_err_t nand_get_ecc_stats(spi_nand_flash_device_t *flash)
              ecc_err_total_count, ecc_err_not_corrected_count, flash->chip.ecc_data.ecc_data_refresh_threshold, ecc_err_exceeding_threshold_count);
     return ret;
 }
+
+esp_err_t nand_get_latency_stats(spi_nand_flash_device_t *flash, nand_latency_op_t op, nand_latency_stats_t *stats)
+{
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(op < NAND_LATENCY_OP_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid operation");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    *stats = flash->latency_stats[op];
+    xSemaphoreGive(flash->mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t nand_reset_latency_stats(spi_nand_flash_device_t *flash)
+{
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    ESP_RETURN_ON_FALSE(flash != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    memset(flash->latency_stats, 0, sizeof(flash->latency_stats));
+    memset(&flash->write_latency_stats, 0, sizeof(flash->write_latency_stats));
+    xSemaphoreGive(flash->mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t nand_get_write_latency_stats(spi_nand_flash_device_t *flash, nand_latency_stats_t *stats)
+{
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    *stats = flash->write_latency_stats;
+    xSemaphoreGive(flash->mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+uint32_t nand_latency_stats_percentile(const nand_latency_stats_t *stats, uint32_t percentile)
+{
+    if (stats == NULL || stats->count == 0) {
+        return 0;
+    }
+    if (percentile > 100) {
+        percentile = 100;
+    }
+    // Rank of the sample at the requested percentile, rounded up (nearest-rank method)
+    uint64_t rank = ((uint64_t)stats->count * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < NAND_LATENCY_HIST_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= rank) {
+            uint32_t upper_us = (i == NAND_LATENCY_HIST_BUCKETS - 1) ? stats->max_us : (2U << i) - 1;
+            return upper_us < stats->max_us ? upper_us : stats->max_us;
+        }
+    }
+    return stats->max_us;
+}
+
+esp_err_t nand_get_write_cache_stats(spi_nand_flash_device_t *flash, nand_write_cache_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    esp_err_t ret = nand_write_cache_get_stats(flash, stats);
+    xSemaphoreGive(flash->mutex);
+    return ret;
+}
+
+esp_err_t nand_get_wear_stats(spi_nand_flash_device_t *flash, nand_wear_stats_t *stats)
+{
+#if CONFIG_NAND_FLASH_ERASE_COUNTS
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(stats->erase_counts != NULL || stats->erase_counts_len == 0, ESP_ERR_INVALID_ARG, TAG,
+                        "invalid argument");
+    esp_err_t ret = ESP_OK;
+    uint32_t good_blocks = 0;
+
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(flash->erase_counts != NULL, ESP_ERR_INVALID_STATE, end, TAG, "wear-levelling layer not initialised");
+    stats->num_blocks = flash->chip.num_blocks;
+    stats->bad_blocks = 0;
+    stats->min_erase_count = UINT32_MAX;
+    stats->max_erase_count = 0;
+    stats->total_erases = 0;
+    for (uint32_t blk = 0; blk < flash->chip.num_blocks; blk++) {
+        uint32_t count = flash->erase_counts[blk];
+        bool is_bad = false;
+        if (blk < stats->erase_counts_len) {
+            stats->erase_counts[blk] = count;
+        }
+        ESP_GOTO_ON_ERROR(nand_is_bad(flash, blk, &is_bad), end, TAG, "Failed to get bad block status for blk=%"PRIu32, blk);
+        if (is_bad) {
+            stats->bad_blocks++;
+            continue;
+        }
+        good_blocks++;
+        stats->total_erases += count;
+        stats->min_erase_count = count < stats->min_erase_count ? count : stats->min_erase_count;
+        stats->max_erase_count = count > stats->max_erase_count ? count : stats->max_erase_count;
+    }
+    if (good_blocks == 0) {
+        stats->min_erase_count = 0;
+    }
+    stats->avg_erase_count = good_blocks ? (uint32_t)(stats->total_erases / good_blocks) : 0;
+
+end:
+    xSemaphoreGive(flash->mutex);
+    return ret;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t nand_get_gc_stats(spi_nand_flash_device_t *flash, nand_gc_stats_t *stats)
+{
+#if CONFIG_NAND_FLASH_BACKGROUND_GC
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    *stats = flash->gc_stats;
+    xSemaphoreGive(flash->mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t nand_get_scrub_stats(spi_nand_flash_device_t *flash, nand_scrub_stats_t *stats)
+{
+#if CONFIG_NAND_FLASH_ECC_SCRUB
+    ESP_RETURN_ON_FALSE(flash != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    xSemaphoreTake(flash->mutex, portMAX_DELAY);
+    *stats = flash->scrub_stats;
+    xSemaphoreGive(flash->mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
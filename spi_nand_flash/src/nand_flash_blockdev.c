@@ -65,14 +65,12 @@ static esp_err_t nand_flash_blockdev_read(esp_blockdev_handle_t handle, uint8_t
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_err_t res = ESP_OK;
-    for (uint32_t page_id = start_page; page_id < start_page + page_count; page_id++) {
-        res = nand_read(dev_handle, page_id, 0, page_size, dst_buf);
-        if (res != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to read page %" PRIu32, page_id);
-            return res;
-        }
-        dst_buf += page_size;
+    // On success the worst correctable ECC class seen across the range is left in ecc_corrected_bits_status, so
+    // callers of a multi-page read can still decide whether the data needs refreshing.
+    esp_err_t res = nand_read_pages(dev_handle, start_page, page_count, dst_buf);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read pages %" PRIu32 "..%" PRIu32, start_page, start_page + page_count - 1);
+        return res;
     }
     ESP_LOGV(TAG, "read - src_addr=0x%.16" PRIx64 ", size=0x%08zx, result=0x%08x", src_addr, data_read_len, res);
     return res;
@@ -286,18 +284,8 @@ static esp_err_t nand_flash_blockdev_ioctl(esp_blockdev_handle_t handle, const u
 
 static esp_err_t nand_flash_blockdev_release(esp_blockdev_handle_t handle)
 {
-    esp_err_t res = ESP_OK;
     spi_nand_flash_device_t *dev_handle = (spi_nand_flash_device_t *)handle->ctx;
-#ifdef CONFIG_IDF_TARGET_LINUX
-    res = nand_emul_deinit(dev_handle);
-#endif
-    free(dev_handle->work_buffer);
-    free(dev_handle->read_buffer);
-    free(dev_handle->temp_buffer);
-    if (dev_handle->mutex) {
-        vSemaphoreDelete(dev_handle->mutex);
-    }
-    free(dev_handle);
+    esp_err_t res = nand_release_device(dev_handle);
     free(handle);
     return res;
 }
@@ -323,15 +311,17 @@ esp_err_t nand_flash_get_blockdev(spi_nand_flash_config_t *config, esp_blockdev_
         return ret;
     }
 
+    ret = nand_flash_blockdev_create(handle, out_bdl_handle_ptr);
+    if (ret != ESP_OK) {
+        nand_release_device(handle);
+    }
+    return ret;
+}
+
+esp_err_t nand_flash_blockdev_create(spi_nand_flash_device_t *handle, esp_blockdev_handle_t *out_bdl_handle_ptr)
+{
     esp_blockdev_t *blockdev = (esp_blockdev_t *) heap_caps_calloc(1, sizeof(esp_blockdev_t), MALLOC_CAP_DEFAULT);
     if (blockdev == NULL) {
-        free(handle->work_buffer);
-        free(handle->read_buffer);
-        free(handle->temp_buffer);
-        if (handle->mutex) {
-            vSemaphoreDelete(handle->mutex);
-        }
-        free(handle);
         return ESP_ERR_NO_MEM;
     }
     blockdev->ctx = (void *)handle;
@@ -9,13 +9,23 @@
 #include <string.h>
 #include "esp_check.h"
 #include "esp_err.h"
+#include "esp_memory_utils.h"
 #include "spi_nand_oper.h"
 #include "nand.h"
 #include "nand_flash_devices.h"
 #include "nand_device_types.h"
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE || CONFIG_NAND_FLASH_LATENCY_STATS
+#include "esp_timer.h"
+#endif
 
 #define ROM_WAIT_THRESHOLD_US 1000
 
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+#define NAND_WAIT_POLL_DIVIDER 16   // status poll interval as a fraction of the expected busy time
+#define NAND_WAIT_MIN_POLL_US  5
+#define NAND_WAIT_MAX_POLL_US  200
+#endif
+
 static const char *TAG = "nand_hal";
 
 static esp_err_t detect_chip(spi_nand_flash_device_t *dev)
@@ -77,6 +87,28 @@ static esp_err_t unprotect_chip(spi_nand_flash_device_t *dev)
     return ret;
 }
 
+static uint32_t nominal_op_time_us(spi_nand_flash_device_t *dev, nand_latency_op_t op)
+{
+    switch (op) {
+    case NAND_LATENCY_OP_READ:
+        return dev->chip.read_page_delay_us;
+    case NAND_LATENCY_OP_PROGRAM:
+        return dev->chip.program_page_delay_us;
+    default:
+        return dev->chip.erase_block_delay_us;
+    }
+}
+
+uint8_t *nand_alloc_page_buffer(const spi_nand_flash_device_t *handle)
+{
+    return heap_caps_aligned_alloc(spi_nand_get_dma_alignment(), handle->chip.page_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+}
+
+bool nand_buffer_dma_capable(const void *buf)
+{
+    return esp_ptr_dma_capable(buf) && ((uintptr_t)buf % spi_nand_get_dma_alignment()) == 0;
+}
+
 esp_err_t nand_init_device(spi_nand_flash_config_t *config, spi_nand_flash_device_t **handle)
 {
     esp_err_t ret = ESP_OK;
@@ -107,16 +139,30 @@ esp_err_t nand_init_device(spi_nand_flash_config_t *config, spi_nand_flash_devic
     (*handle)->chip.page_size = 1 << (*handle)->chip.log2_page_size;
     (*handle)->chip.block_size = (1 << (*handle)->chip.log2_ppb) * (*handle)->chip.page_size;
 
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+    for (int op = 0; op < NAND_LATENCY_OP_MAX; op++) {
+        (*handle)->wait_estimate_us[op] = nominal_op_time_us(*handle, (nand_latency_op_t)op);
+    }
+#endif
+
     size_t dma_alignment = spi_nand_get_dma_alignment();
-    (*handle)->work_buffer = heap_caps_aligned_alloc(dma_alignment, (*handle)->chip.page_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    (*handle)->work_buffer = nand_alloc_page_buffer(*handle);
     ESP_GOTO_ON_FALSE((*handle)->work_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
 
-    (*handle)->read_buffer = heap_caps_aligned_alloc(dma_alignment, (*handle)->chip.page_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    (*handle)->read_buffer = nand_alloc_page_buffer(*handle);
     ESP_GOTO_ON_FALSE((*handle)->read_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
 
     (*handle)->temp_buffer = heap_caps_aligned_alloc(dma_alignment, (*handle)->chip.page_size + dma_alignment, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
     ESP_GOTO_ON_FALSE((*handle)->temp_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
 
+#if CONFIG_NAND_FLASH_VERIFY_WRITE
+    (*handle)->verify_buffer = nand_alloc_page_buffer(*handle);
+    ESP_GOTO_ON_FALSE((*handle)->verify_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+#endif
+
+    (*handle)->bad_block_bitmap = heap_caps_calloc(NAND_BAD_BLOCK_BITMAP_WORDS((*handle)->chip.num_blocks), sizeof(uint32_t), MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE((*handle)->bad_block_bitmap != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+
     (*handle)->mutex = xSemaphoreCreateMutex();
     if (!(*handle)->mutex) {
         ret = ESP_ERR_NO_MEM;
@@ -128,6 +174,8 @@ fail:
     free((*handle)->work_buffer);
     free((*handle)->read_buffer);
     free((*handle)->temp_buffer);
+    free((*handle)->verify_buffer);
+    free((*handle)->bad_block_bitmap);
     if ((*handle)->mutex) {
         vSemaphoreDelete((*handle)->mutex);
     }
@@ -140,25 +188,90 @@ fail:
 #if CONFIG_NAND_FLASH_VERIFY_WRITE
 static esp_err_t s_verify_write(spi_nand_flash_device_t *handle, const uint8_t *expected_buffer, uint16_t offset, uint16_t length)
 {
-    uint8_t *temp_buf = NULL;
-    temp_buf = heap_caps_malloc(length, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
-    ESP_RETURN_ON_FALSE(temp_buf != NULL, ESP_ERR_NO_MEM, TAG, "nomem");
-    if (spi_nand_read(handle, temp_buf, offset, length)) {
+    // length is at most a page, the size of verify_buffer
+    if (spi_nand_read(handle, handle->verify_buffer, offset, length)) {
         ESP_LOGE(TAG, "%s: Failed to read nand flash to verify previous write", __func__);
-        free(temp_buf);
         return ESP_FAIL;
     }
 
-    if (memcmp(temp_buf, expected_buffer, length)) {
+    if (memcmp(handle->verify_buffer, expected_buffer, length)) {
         ESP_LOGE(TAG, "%s: Data mismatch detected. The previously written buffer does not match the read buffer.", __func__);
-        free(temp_buf);
         return ESP_FAIL;
     }
-    free(temp_buf);
     return ESP_OK;
 }
 #endif //CONFIG_NAND_FLASH_VERIFY_WRITE
 
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+/* Sleep for `us`, blocking the task for the whole-tick part of it when that is allowed by the strategy */
+static void wait_sleep_us(uint32_t us)
+{
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+#if CONFIG_NAND_FLASH_WAIT_YIELD_BUS
+    // Give the CPU and the bus away for anything from half a tick up, rounding to the nearest tick
+    if (us >= tick_us / 2) {
+        uint32_t ticks = (us + tick_us / 2) / tick_us;
+        vTaskDelay(ticks ? ticks : 1);
+        return;
+    }
+#else
+    if (us >= ROM_WAIT_THRESHOLD_US && us >= tick_us) {
+        vTaskDelay(us / tick_us);
+        us %= tick_us;
+    }
+#endif
+    if (us) {
+        esp_rom_delay_us(us);
+    }
+}
+
+/* Adaptive wait, also reporting how many status polls it took (1 means the chip was ready at the first one) */
+static esp_err_t wait_for_ready_adaptive(spi_nand_flash_device_t *dev, uint32_t expected_operation_time_us, uint8_t *status_out,
+        uint32_t *polls_out)
+{
+    // Sleep through most of the expected busy time, then poll at a fraction of it, so the completion is noticed
+    // within a few percent of the estimate instead of on the next tick
+    uint32_t poll_us = expected_operation_time_us / NAND_WAIT_POLL_DIVIDER;
+    if (poll_us < NAND_WAIT_MIN_POLL_US) {
+        poll_us = NAND_WAIT_MIN_POLL_US;
+    } else if (poll_us > NAND_WAIT_MAX_POLL_US) {
+        poll_us = NAND_WAIT_MAX_POLL_US;
+    }
+    wait_sleep_us(expected_operation_time_us - expected_operation_time_us / 8);
+
+    uint32_t polls = 0;
+    while (true) {
+        uint8_t status;
+        ESP_RETURN_ON_ERROR(spi_nand_read_register(dev, REG_STATUS, &status), TAG, "");
+        polls++;
+
+        if ((status & STAT_BUSY) == 0) {
+            if (status_out) {
+                *status_out = status;
+            }
+            break;
+        }
+
+        wait_sleep_us(poll_us);
+#if CONFIG_NAND_FLASH_WAIT_YIELD_BUS
+        // The estimate was too short: back off, so a slow chip does not keep the shared bus busy with status reads
+        if (poll_us < portTICK_PERIOD_MS * 1000) {
+            poll_us *= 2;
+        }
+#endif
+    }
+
+    if (polls_out) {
+        *polls_out = polls;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t wait_for_ready(spi_nand_flash_device_t *dev, uint32_t expected_operation_time_us, uint8_t *status_out)
+{
+    return wait_for_ready_adaptive(dev, expected_operation_time_us, status_out, NULL);
+}
+#else
 static esp_err_t wait_for_ready(spi_nand_flash_device_t *dev, uint32_t expected_operation_time_us, uint8_t *status_out)
 {
     if (expected_operation_time_us < ROM_WAIT_THRESHOLD_US) {
@@ -183,19 +296,57 @@ static esp_err_t wait_for_ready(spi_nand_flash_device_t *dev, uint32_t expected_
 
     return ESP_OK;
 }
+#endif //CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+
+/* Wait for a read, program or erase to finish, feeding its busy time to the adaptive estimate and the stats */
+static esp_err_t wait_for_op(spi_nand_flash_device_t *dev, nand_latency_op_t op, uint8_t *status_out)
+{
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE || CONFIG_NAND_FLASH_LATENCY_STATS
+    int64_t start_us = esp_timer_get_time();
+#endif
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+    uint32_t polls;
+    esp_err_t ret = wait_for_ready_adaptive(dev, dev->wait_estimate_us[op], status_out, &polls);
+#else
+    esp_err_t ret = wait_for_ready(dev, nominal_op_time_us(dev, op), status_out);
+#endif
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE || CONFIG_NAND_FLASH_LATENCY_STATS
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+#endif
+#if CONFIG_NAND_FLASH_WAIT_ADAPTIVE
+    uint32_t *estimate_us = &dev->wait_estimate_us[op];
+    if (polls == 1) {
+        // Ready at the first poll: the real busy time is somewhere below the elapsed time, probe a shorter wait
+        *estimate_us -= *estimate_us / 16;
+    } else {
+        // Completion was seen within one poll interval: move the estimate 1/8 of the way towards it
+        *estimate_us = (uint32_t)((int32_t)*estimate_us + ((int32_t)elapsed_us - (int32_t)*estimate_us) / 8);
+    }
+    if (*estimate_us == 0) {
+        *estimate_us = 1;
+    }
+#endif
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+    nand_latency_record(&dev->latency_stats[op], elapsed_us);
+#endif
+    return ret;
+}
 
 static esp_err_t read_page_and_wait(spi_nand_flash_device_t *dev, uint32_t page, uint8_t *status_out)
 {
-    ESP_RETURN_ON_ERROR(spi_nand_read_page(dev, page), TAG, "");
+    ESP_RETURN_ON_ERROR(spi_nand_read_page(dev, nand_chip_page(dev, page)), TAG, "");
 
-    return wait_for_ready(dev, dev->chip.read_page_delay_us, status_out);
+    return wait_for_op(dev, NAND_LATENCY_OP_READ, status_out);
 }
 
 static esp_err_t program_execute_and_wait(spi_nand_flash_device_t *dev, uint32_t page, uint8_t *status_out)
 {
-    ESP_RETURN_ON_ERROR(spi_nand_program_execute(dev, page), TAG, "");
+    ESP_RETURN_ON_ERROR(spi_nand_program_execute(dev, nand_chip_page(dev, page)), TAG, "");
 
-    return wait_for_ready(dev, dev->chip.program_page_delay_us, status_out);
+    return wait_for_op(dev, NAND_LATENCY_OP_PROGRAM, status_out);
 }
 
 static uint16_t get_column_address(spi_nand_flash_device_t *handle, uint32_t block, uint32_t offset)
@@ -207,7 +358,7 @@ static uint16_t get_column_address(spi_nand_flash_device_t *handle, uint32_t blo
             ESP_LOGE(TAG, "Invalid number of planes (0)");
             return column_addr;  // Return offset without plane selection
         }
-        uint32_t plane = block % handle->chip.num_planes;
+        uint32_t plane = (handle->first_block + block) % handle->chip.num_planes;
         // The plane index is the bit following the most significant bit (MSB) of the address.
         // For a 2048-byte page (2^11), the plane select bit is the 12th bit, and
         // for a 4096-byte page (2^12), it is the 13th bit.
@@ -216,7 +367,7 @@ static uint16_t get_column_address(spi_nand_flash_device_t *handle, uint32_t blo
     return column_addr;
 }
 
-esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
+static esp_err_t read_bad_block_marker(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
 {
     uint32_t first_block_page = block * (1 << handle->chip.log2_ppb);
     // Markers layout: [bad_block_marker (bytes 0-1)][page_used_marker (bytes 2-3)]
@@ -241,6 +392,16 @@ fail:
     return ret;
 }
 
+esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
+{
+    if (nand_bad_block_lookup(handle, block, is_bad_status)) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(read_bad_block_marker(handle, block, is_bad_status), TAG, "");
+    nand_bad_block_record(handle, block, *is_bad_status);
+    return ESP_OK;
+}
+
 esp_err_t nand_mark_bad(spi_nand_flash_device_t *handle, uint32_t block)
 {
     esp_err_t ret = ESP_OK;
@@ -250,13 +411,14 @@ esp_err_t nand_mark_bad(spi_nand_flash_device_t *handle, uint32_t block)
     const uint8_t markers[4] = { 0x00, 0x00, 0xFF, 0xFF }; //// 0x0000 (bad block), 0xFFFF (free)
     uint8_t status;
     ESP_LOGD(TAG, "mark_bad, block=%"PRIu32", page=%"PRIu32"", block, first_block_page);
+    // Whether or not the marker can be written, the block must not be used anymore
+    nand_bad_block_record(handle, block, true);
 
     ESP_GOTO_ON_ERROR(read_page_and_wait(handle, first_block_page, NULL), fail, TAG, "");
     ESP_GOTO_ON_ERROR(spi_nand_write_enable(handle), fail, TAG, "");
-    ESP_GOTO_ON_ERROR(spi_nand_erase_block(handle, first_block_page),
-                      fail, TAG, "");
-    ESP_GOTO_ON_ERROR(wait_for_ready(handle, handle->chip.erase_block_delay_us, &status),
+    ESP_GOTO_ON_ERROR(spi_nand_erase_block(handle, nand_chip_page(handle, first_block_page)),
                       fail, TAG, "");
+    ESP_GOTO_ON_ERROR(wait_for_op(handle, NAND_LATENCY_OP_ERASE, &status), fail, TAG, "");
     if ((status & STAT_ERASE_FAILED) != 0) {
         ret = ESP_ERR_NOT_FINISHED;
         goto fail;
@@ -292,11 +454,9 @@ esp_err_t nand_erase_block(spi_nand_flash_device_t *handle, uint32_t block)
     uint32_t first_block_page = block * (1 << handle->chip.log2_ppb);
 
     ESP_GOTO_ON_ERROR(spi_nand_write_enable(handle), fail, TAG, "");
-    ESP_GOTO_ON_ERROR(spi_nand_erase_block(handle, first_block_page),
-                      fail, TAG, "");
-    ESP_GOTO_ON_ERROR(wait_for_ready(handle,
-                                     handle->chip.erase_block_delay_us, &status),
+    ESP_GOTO_ON_ERROR(spi_nand_erase_block(handle, nand_chip_page(handle, first_block_page)),
                       fail, TAG, "");
+    ESP_GOTO_ON_ERROR(wait_for_op(handle, NAND_LATENCY_OP_ERASE, &status), fail, TAG, "");
 
     if ((status & STAT_ERASE_FAILED) != 0) {
         ret = ESP_ERR_NOT_FINISHED;
@@ -353,9 +513,10 @@ esp_err_t nand_prog(spi_nand_flash_device_t *handle, uint32_t page, const uint8_
     uint32_t block = page >> handle->chip.log2_ppb;
     uint16_t column_addr = get_column_address(handle, block, 0);
 
-    ESP_GOTO_ON_ERROR(read_page_and_wait(handle, page, NULL), fail, TAG, "");
+    // PROGRAM LOAD resets the whole cache register to 0xFF, so the OOB bytes not written below stay erased without
+    // first reading the (erased) target page into the cache
     ESP_GOTO_ON_ERROR(spi_nand_write_enable(handle), fail, TAG, "");
-    ESP_GOTO_ON_ERROR(spi_nand_program_load(handle, data, column_addr, handle->chip.page_size),
+    ESP_GOTO_ON_ERROR(spi_nand_program_load_reset(handle, data, column_addr, handle->chip.page_size),
                       fail, TAG, "");
     // Write 4 bytes: bad block marker (0xFFFF - good block) + page used marker (0x0000 - used)
     ESP_GOTO_ON_ERROR(spi_nand_program_load(handle, (uint8_t *)&markers,
@@ -409,8 +570,9 @@ fail:
     return ret;
 }
 
-#define PACK_2BITS_STATUS(status, bit1, bit0)         ((((status) & (bit1)) << 1) | ((status) & (bit0)))
-#define PACK_3BITS_STATUS(status, bit2, bit1, bit0)   ((((status) & (bit2)) << 2) | (((status) & (bit1)) << 1) | ((status) & (bit0)))
+// Gather the ECC status bits of the status register into a nand_ecc_status_t value
+#define PACK_2BITS_STATUS(status, bit1, bit0)         ((((status) & (bit1)) ? 2 : 0) | (((status) & (bit0)) ? 1 : 0))
+#define PACK_3BITS_STATUS(status, bit2, bit1, bit0)   ((((status) & (bit2)) ? 4 : 0) | PACK_2BITS_STATUS(status, bit1, bit0))
 
 static bool is_ecc_error(spi_nand_flash_device_t *dev, uint8_t status)
 {
@@ -460,13 +622,100 @@ fail:
     return ret;
 }
 
+static void update_worst_ecc(spi_nand_flash_device_t *handle, nand_ecc_status_t *worst_ecc)
+{
+    if (nand_ecc_min_bits_corrected(handle->chip.ecc_data.ecc_corrected_bits_status) > nand_ecc_min_bits_corrected(*worst_ecc)) {
+        *worst_ecc = handle->chip.ecc_data.ecc_corrected_bits_status;
+    }
+}
+
+#if CONFIG_NAND_FLASH_SEQUENTIAL_READ
+/* Read `count` consecutive pages of a single block using PAGE READ CACHE SEQUENTIAL (31h): while page N is
+ * clocked out of the cache register, the array is already loading page N+1, hiding most of tRD. The sequence
+ * is closed with PAGE READ CACHE LAST (3Fh), which also has to be issued if a page fails ECC midway. */
+static esp_err_t read_pages_cache_seq(spi_nand_flash_device_t *handle, uint32_t page, uint32_t count, uint8_t *data,
+                                      nand_ecc_status_t *worst_ecc)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t status;
+    uint16_t column_addr = get_column_address(handle, page >> handle->chip.log2_ppb, 0);
+
+    ESP_GOTO_ON_ERROR(read_page_and_wait(handle, page, NULL), fail, TAG, "");
+
+    for (uint32_t i = 0; i < count; i++) {
+        bool last = (i == count - 1);
+        if (last) {
+            ESP_GOTO_ON_ERROR(spi_nand_read_page_cache_last(handle), fail, TAG, "");
+        } else {
+            ESP_GOTO_ON_ERROR(spi_nand_read_page_cache_seq(handle), fail, TAG, "");
+        }
+        // Only the cache transfer is waited for here, the array read of the next page overlaps the data-out below
+        ESP_GOTO_ON_ERROR(wait_for_ready(handle, 0, &status), fail, TAG, "");
+
+        if (is_ecc_error(handle, status)) {
+            ESP_LOGD(TAG, "read ecc error, page=%"PRIu32"", page + i);
+            if (!last) {
+                ESP_GOTO_ON_ERROR(spi_nand_read_page_cache_last(handle), fail, TAG, "");
+                ESP_GOTO_ON_ERROR(wait_for_ready(handle, 0, NULL), fail, TAG, "");
+                handle->chip.ecc_data.ecc_corrected_bits_status = NAND_ECC_NOT_CORRECTED;
+            }
+            return ESP_FAIL;
+        }
+        update_worst_ecc(handle, worst_ecc);
+
+        ESP_GOTO_ON_ERROR(spi_nand_read(handle, data + ((size_t)i << handle->chip.log2_page_size), column_addr,
+                                        handle->chip.page_size), fail, TAG, "");
+    }
+    return ret;
+fail:
+    ESP_LOGE(TAG, "Error in read_pages_cache_seq %d", ret);
+    return ret;
+}
+#endif //CONFIG_NAND_FLASH_SEQUENTIAL_READ
+
+esp_err_t nand_read_pages(spi_nand_flash_device_t *handle, uint32_t page, uint32_t count, uint8_t *data)
+{
+    ESP_LOGV(TAG, "read_pages, page=%"PRIu32", count=%"PRIu32"", page, count);
+    assert(page + count <= handle->chip.num_blocks * (1 << handle->chip.log2_ppb));
+    const uint32_t pages_per_block = 1 << handle->chip.log2_ppb;
+    nand_ecc_status_t worst_ecc = NAND_ECC_OK;
+    esp_err_t ret = ESP_OK;
+
+    while (count > 0) {
+        // A cache read sequence must not leave the block (and with it, the plane) it was started in
+        uint32_t run = pages_per_block - (page & (pages_per_block - 1));
+        if (run > count) {
+            run = count;
+        }
+#if CONFIG_NAND_FLASH_SEQUENTIAL_READ
+        if (run > 1 && (handle->chip.flags & NAND_FLAG_HAS_CACHE_READ_SEQ)) {
+            ret = read_pages_cache_seq(handle, page, run, data, &worst_ecc);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        } else
+#endif //CONFIG_NAND_FLASH_SEQUENTIAL_READ
+        {
+            for (uint32_t i = 0; i < run; i++) {
+                ret = nand_read(handle, page + i, 0, handle->chip.page_size, data + ((size_t)i << handle->chip.log2_page_size));
+                if (ret != ESP_OK) {
+                    return ret;
+                }
+                update_worst_ecc(handle, &worst_ecc);
+            }
+        }
+        page += run;
+        count -= run;
+        data += (size_t)run << handle->chip.log2_page_size;
+    }
+    handle->chip.ecc_data.ecc_corrected_bits_status = worst_ecc;
+    return ret;
+}
+
 esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
 {
     ESP_LOGD(TAG, "copy, src=%"PRIu32", dst=%"PRIu32"", src, dst);
     esp_err_t ret = ESP_OK;
-#if CONFIG_NAND_FLASH_VERIFY_WRITE
-    uint8_t *temp_buf = NULL;
-#endif //CONFIG_NAND_FLASH_VERIFY_WRITE
 
     uint8_t status;
     ESP_GOTO_ON_ERROR(read_page_and_wait(handle, src, &status), fail, TAG, "");
@@ -484,27 +733,17 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
 
     if (src_column_addr != dst_column_addr) {
         // In a 2 plane structure of the flash, if the pages are not on the same plane, the data must be copied through RAM.
-        uint8_t *copy_buf = heap_caps_malloc(handle->chip.page_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
-        ESP_GOTO_ON_FALSE(copy_buf, ESP_ERR_NO_MEM, fail, TAG, "Failed to allocate copy buffer");
-
-        ESP_GOTO_ON_ERROR(spi_nand_read(handle, copy_buf, src_column_addr, handle->chip.page_size), fail, TAG, "");
+        ESP_GOTO_ON_ERROR(spi_nand_read(handle, handle->read_buffer, src_column_addr, handle->chip.page_size), fail, TAG, "");
 
         ESP_GOTO_ON_ERROR(spi_nand_write_enable(handle), fail, TAG, "");
 
-        ESP_GOTO_ON_ERROR(spi_nand_program_load(handle, copy_buf, dst_column_addr, handle->chip.page_size),
+        ESP_GOTO_ON_ERROR(spi_nand_program_load(handle, handle->read_buffer, dst_column_addr, handle->chip.page_size),
                           fail, TAG, "");
 
         // Write 4 bytes: bad block marker (0xFFFF - good block) + page used marker (0x0000 - used)
         uint8_t markers[4] = { 0xFF, 0xFF, 0x00, 0x00 };
         ESP_GOTO_ON_ERROR(spi_nand_program_load(handle, (uint8_t *)&markers,
                                                 dst_column_addr + handle->chip.page_size, 4), fail, TAG, "");
-        ESP_GOTO_ON_ERROR(program_execute_and_wait(handle, dst, &status), fail, TAG, "");
-
-        if ((status & STAT_PROGRAM_FAILED) != 0) {
-            ESP_LOGD(TAG, "copy, prog failed");
-            return ESP_ERR_NOT_FINISHED;
-        }
-        free(copy_buf);
     }
 
     ESP_GOTO_ON_ERROR(program_execute_and_wait(handle, dst, &status), fail, TAG, "");
@@ -514,21 +753,10 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
     }
 
 #if CONFIG_NAND_FLASH_VERIFY_WRITE
-    // First read src page data from cache to temp_buf
-    if (src_column_addr != dst_column_addr) {
-        // Then read src page data from nand memory array and load it in cache
-        ESP_GOTO_ON_ERROR(read_page_and_wait(handle, src, &status), fail, TAG, "");
-        if (is_ecc_error(handle, status)) {
-            ESP_LOGE(TAG, "%s: dst_page=%"PRIu32" read, ecc error", __func__, dst);
-            goto fail;
-        }
-    }
-
-    temp_buf = heap_caps_malloc(handle->chip.page_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
-    ESP_RETURN_ON_FALSE(temp_buf != NULL, ESP_ERR_NO_MEM, TAG, "nomem");
-    if (spi_nand_read(handle, temp_buf, src_column_addr, handle->chip.page_size)) {
-        ESP_LOGE(TAG, "%s: Failed to read src_page=%"PRIu32"", __func__, src);
-        goto fail;
+    // Copied through RAM, read_buffer already holds the src page data. Otherwise it is still in the cache.
+    if (src_column_addr == dst_column_addr) {
+        ESP_GOTO_ON_ERROR(spi_nand_read(handle, handle->read_buffer, src_column_addr, handle->chip.page_size),
+                          fail, TAG, "Failed to read src_page=%"PRIu32"", src);
     }
     // Then read dst page data from nand memory array and load it in cache
     ESP_GOTO_ON_ERROR(read_page_and_wait(handle, dst, &status), fail, TAG, "");
@@ -537,19 +765,14 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
         goto fail;
     }
     // Check if the data in the src page matches the dst page
-    ret = s_verify_write(handle, temp_buf, dst_column_addr, handle->chip.page_size);
+    ret = s_verify_write(handle, handle->read_buffer, dst_column_addr, handle->chip.page_size);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "%s: dst_page=%"PRIu32" write verification failed", __func__, dst);
     }
-
-    free(temp_buf);
 #endif //CONFIG_NAND_FLASH_VERIFY_WRITE
     return ret;
 
 fail:
-#if CONFIG_NAND_FLASH_VERIFY_WRITE
-    free(temp_buf);
-#endif //CONFIG_NAND_FLASH_VERIFY_WRITE
     ESP_LOGE(TAG, "Error in nand_copy %d", ret);
     return ret;
 }
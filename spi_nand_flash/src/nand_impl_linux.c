@@ -11,17 +11,31 @@
 #include "esp_err.h"
 #include "spi_nand_flash.h"
 #include "nand.h"
+#include "nand_impl.h"
 #include "nand_linux_mmap_emul.h"
 
 static const char *TAG = "nand_linux";
 
 /* OOB marker layout at page data offset `page_size` (matches nand_impl.c HW path):
  * bytes 0-1: bad-block marker (0xFFFF = good / erased, 0x0000 = bad)
- * bytes 2-3: page-used marker (0xFFFF = free, 0x0000 = used after program) */
+ * bytes 2-3: page-used marker (0xFFFF = free, 0x0000 = used after program)
+ * The last OOB byte is kept by the emulator to mark pages left half written by an injected power cut. */
 static const uint8_t s_oob_used_page_markers[4] = { 0xFF, 0xFF, 0x00, 0x00 };
 static const uint8_t s_oob_mark_bad_markers[4] = { 0x00, 0x00, 0xFF, 0xFF };
 
-/* Start of erase block `block` in the mmap file: ppb slots of (data + OOB) per page. */
+/* Fault injection point of the emulator before a program or erase. Returns true if the operation must not be done,
+ * with the result to report in *ret: ESP_OK once the power is cut, ESP_ERR_NOT_FINISHED for an injected failure. */
+static bool fault_injected(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t offset, esp_err_t *ret)
+{
+    *ret = nand_emul_fault_point(handle, op, offset);
+    if (*ret == ESP_ERR_INVALID_STATE) {
+        *ret = ESP_OK;
+        return true;
+    }
+    return *ret != ESP_OK;
+}
+
+/* Start of erase block `block` of the handle in the mmap file: ppb slots of (data + OOB) per page. */
 static esp_err_t linux_mmap_block_file_offset(const spi_nand_flash_device_t *handle, uint32_t block, size_t *out_offset)
 {
     ESP_RETURN_ON_FALSE(out_offset != NULL, ESP_ERR_INVALID_ARG, TAG, "out_offset is NULL");
@@ -30,7 +44,7 @@ static esp_err_t linux_mmap_block_file_offset(const spi_nand_flash_device_t *han
 
     const uint64_t ppb = 1ull << handle->chip.log2_ppb;
     const uint64_t bytes_per_block = ppb * (uint64_t)handle->chip.emulated_page_size;
-    const uint64_t off = (uint64_t)block * bytes_per_block;
+    const uint64_t off = (uint64_t)(handle->first_block + block) * bytes_per_block;
 
     ESP_RETURN_ON_FALSE(off <= (uint64_t)SIZE_MAX, ESP_ERR_INVALID_SIZE, TAG, "mmap block offset overflow");
     *out_offset = (size_t)off;
@@ -89,6 +103,17 @@ fail:
     return ret;
 }
 
+uint8_t *nand_alloc_page_buffer(const spi_nand_flash_device_t *handle)
+{
+    return heap_caps_malloc(handle->chip.page_size, MALLOC_CAP_DEFAULT);
+}
+
+bool nand_buffer_dma_capable(const void *buf)
+{
+    (void)buf;
+    return true;
+}
+
 esp_err_t nand_init_device(spi_nand_flash_config_t *config, spi_nand_flash_device_t **handle)
 {
     esp_err_t ret = ESP_OK;
@@ -112,12 +137,15 @@ esp_err_t nand_init_device(spi_nand_flash_config_t *config, spi_nand_flash_devic
 
     ESP_GOTO_ON_ERROR(detect_chip(*handle), fail, TAG, "Failed to detect nand chip");
 
-    (*handle)->work_buffer = heap_caps_malloc((*handle)->chip.page_size, MALLOC_CAP_DEFAULT);
+    (*handle)->work_buffer = nand_alloc_page_buffer(*handle);
     ESP_GOTO_ON_FALSE((*handle)->work_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
 
-    (*handle)->read_buffer = heap_caps_malloc((*handle)->chip.page_size, MALLOC_CAP_DEFAULT);
+    (*handle)->read_buffer = nand_alloc_page_buffer(*handle);
     ESP_GOTO_ON_FALSE((*handle)->read_buffer != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
 
+    (*handle)->bad_block_bitmap = heap_caps_calloc(NAND_BAD_BLOCK_BITMAP_WORDS((*handle)->chip.num_blocks), sizeof(uint32_t), MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE((*handle)->bad_block_bitmap != NULL, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+
     (*handle)->mutex = xSemaphoreCreateMutex();
     if (!(*handle)->mutex) {
         ret = ESP_ERR_NO_MEM;
@@ -128,6 +156,7 @@ esp_err_t nand_init_device(spi_nand_flash_config_t *config, spi_nand_flash_devic
 fail:
     free((*handle)->work_buffer);
     free((*handle)->read_buffer);
+    free((*handle)->bad_block_bitmap);
     if ((*handle)->mutex) {
         vSemaphoreDelete((*handle)->mutex);
     }
@@ -136,7 +165,7 @@ fail:
     return ret;
 }
 
-esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
+static esp_err_t read_bad_block_marker(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
 {
     uint8_t markers[4];
     size_t block_offset = 0;
@@ -145,24 +174,43 @@ esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t block, bool *is_
 
     ESP_RETURN_ON_ERROR(nand_emul_read(handle, block_offset + handle->chip.page_size, markers, sizeof(markers)),
                         TAG, "Error in nand_is_bad");
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_READ, sizeof(markers));
 
     ESP_LOGD(TAG, "is_bad, block=%"PRIu32", file_off=%zu,indicator = %02x,%02x", block, block_offset, markers[0], markers[1]);
     *is_bad_status = (markers[0] != 0xFF || markers[1] != 0xFF);
     return ESP_OK;
 }
 
+esp_err_t nand_is_bad(spi_nand_flash_device_t *handle, uint32_t block, bool *is_bad_status)
+{
+    if (nand_bad_block_lookup(handle, block, is_bad_status)) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(read_bad_block_marker(handle, block, is_bad_status), TAG, "");
+    nand_bad_block_record(handle, block, *is_bad_status);
+    return ESP_OK;
+}
+
 esp_err_t nand_mark_bad(spi_nand_flash_device_t *handle, uint32_t block)
 {
+    esp_err_t ret = ESP_OK;
     size_t block_base = 0;
 
     uint64_t first_block_page = (uint64_t)block * (1ull << handle->chip.log2_ppb);
     ESP_LOGD(TAG, "mark_bad, block=%"PRIu32", first_page=%"PRIu64"", block, first_block_page);
+    // Whether or not the marker can be written, the block must not be used anymore
+    nand_bad_block_record(handle, block, true);
 
     ESP_RETURN_ON_ERROR(linux_mmap_block_file_offset(handle, block, &block_base), TAG, "nand_mark_bad: mmap block offset failed");
+    if (fault_injected(handle, NAND_EMUL_OP_ERASE, block_base, &ret)) {
+        return ret;
+    }
     ESP_RETURN_ON_ERROR(nand_emul_erase_block(handle, block_base), TAG, "nand_mark_bad: erase failed");
 
     ESP_RETURN_ON_ERROR(nand_emul_write(handle, block_base + handle->chip.page_size,
                                         s_oob_mark_bad_markers, sizeof(s_oob_mark_bad_markers)), TAG, "nand_mark_bad: OOB marker write failed");
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_ERASE, 0);
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_PROGRAM, sizeof(s_oob_mark_bad_markers));
 
     return ESP_OK;
 }
@@ -174,8 +222,12 @@ esp_err_t nand_erase_block(spi_nand_flash_device_t *handle, uint32_t block)
     size_t address = 0;
 
     ESP_RETURN_ON_ERROR(linux_mmap_block_file_offset(handle, block, &address), TAG, "nand_erase_block: mmap block offset failed");
+    if (fault_injected(handle, NAND_EMUL_OP_ERASE, address, &ret)) {
+        return ret;
+    }
 
     ESP_RETURN_ON_ERROR(nand_emul_erase_block(handle, address), TAG, "Error in nand_erase %x", ret);
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_ERASE, 0);
     return ESP_OK;
 }
 
@@ -216,11 +268,16 @@ esp_err_t nand_prog(spi_nand_flash_device_t *handle, uint32_t page, const uint8_
 {
     ESP_LOGV(TAG, "prog, page=%"PRIu32",", page);
     esp_err_t ret = ESP_OK;
-    uint32_t data_offset = page * handle->chip.emulated_page_size;
+    uint32_t data_offset = nand_chip_page(handle, page) * handle->chip.emulated_page_size;
 
+    if (fault_injected(handle, NAND_EMUL_OP_PROGRAM, data_offset, &ret)) {
+        return ret;
+    }
     ESP_RETURN_ON_ERROR(nand_emul_write(handle, data_offset, data, handle->chip.page_size), TAG, "Error in nand_prog %d", ret);
     ESP_RETURN_ON_ERROR(nand_emul_write(handle, data_offset + handle->chip.page_size,
                                         s_oob_used_page_markers, sizeof(s_oob_used_page_markers)), TAG, "Error in nand_prog %d", ret);
+    // Data and markers go in the same PROGRAM LOAD on the chip
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_PROGRAM, handle->chip.page_size + sizeof(s_oob_used_page_markers));
 
     return ret;
 }
@@ -230,9 +287,10 @@ esp_err_t nand_is_free(spi_nand_flash_device_t *handle, uint32_t page, bool *is_
     esp_err_t ret = ESP_OK;
     uint8_t markers[4];
 
-    ESP_RETURN_ON_ERROR(nand_emul_read(handle, page * handle->chip.emulated_page_size + handle->chip.page_size,
+    ESP_RETURN_ON_ERROR(nand_emul_read(handle, nand_chip_page(handle, page) * handle->chip.emulated_page_size + handle->chip.page_size,
                                        markers, sizeof(markers)),
                         TAG, "Error in nand_is_free %d", ret);
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_READ, sizeof(markers));
 
     ESP_LOGD(TAG, "is free, page=%"PRIu32", used_marker=%02x%02x,", page, markers[2], markers[3]);
     *is_free_status = (markers[2] == 0xFF && markers[3] == 0xFF);
@@ -245,9 +303,36 @@ esp_err_t nand_read(spi_nand_flash_device_t *handle, uint32_t page, size_t offse
     assert(page < handle->chip.num_blocks * (1 << handle->chip.log2_ppb));
     esp_err_t ret = ESP_OK;
 
-    ESP_RETURN_ON_ERROR(nand_emul_read(handle, page * handle->chip.emulated_page_size + offset, data, length),
+    handle->chip.ecc_data.ecc_corrected_bits_status = nand_emul_get_ecc_status(handle, page);
+    if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_NOT_CORRECTED) {
+        ESP_LOGD(TAG, "read ecc error, page=%"PRIu32"", page);
+        return ESP_FAIL;
+    }
+
+    ESP_RETURN_ON_ERROR(nand_emul_read(handle, nand_chip_page(handle, page) * handle->chip.emulated_page_size + offset, data, length),
                         TAG, "Error in nand_read %d", ret);
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_READ, length);
+
+    return ret;
+}
 
+esp_err_t nand_read_pages(spi_nand_flash_device_t *handle, uint32_t page, uint32_t count, uint8_t *data)
+{
+    ESP_LOGV(TAG, "read_pages, page=%"PRIu32", count=%"PRIu32"", page, count);
+    nand_ecc_status_t worst_ecc = NAND_ECC_OK;
+    esp_err_t ret = ESP_OK;
+
+    // The emulator has no cache register to pipeline, so a run of pages is just read one after another
+    for (uint32_t i = 0; i < count; i++) {
+        ret = nand_read(handle, page + i, 0, handle->chip.page_size, data + ((size_t)i << handle->chip.log2_page_size));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (nand_ecc_min_bits_corrected(handle->chip.ecc_data.ecc_corrected_bits_status) > nand_ecc_min_bits_corrected(worst_ecc)) {
+            worst_ecc = handle->chip.ecc_data.ecc_corrected_bits_status;
+        }
+    }
+    handle->chip.ecc_data.ecc_corrected_bits_status = worst_ecc;
     return ret;
 }
 
@@ -255,8 +340,17 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
 {
     ESP_LOGD(TAG, "copy, src=%"PRIu32", dst=%"PRIu32"", src, dst);
     esp_err_t ret = ESP_OK;
-    uint32_t dst_offset = dst * handle->chip.emulated_page_size;
-    uint32_t src_offset = src * handle->chip.emulated_page_size;
+    uint32_t dst_offset = nand_chip_page(handle, dst) * handle->chip.emulated_page_size;
+    uint32_t src_offset = nand_chip_page(handle, src) * handle->chip.emulated_page_size;
+
+    handle->chip.ecc_data.ecc_corrected_bits_status = nand_emul_get_ecc_status(handle, src);
+    if (handle->chip.ecc_data.ecc_corrected_bits_status == NAND_ECC_NOT_CORRECTED) {
+        ESP_LOGD(TAG, "copy, ecc error");
+        return ESP_FAIL;
+    }
+    if (fault_injected(handle, NAND_EMUL_OP_COPY, dst_offset, &ret)) {
+        return ret;
+    }
 
     ESP_RETURN_ON_ERROR(nand_emul_read(handle, (size_t)src_offset, (void *)handle->read_buffer, handle->chip.page_size),
                         TAG, "Error in nand_copy %d", ret);
@@ -264,6 +358,7 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
                         TAG, "Error in nand_copy %d", ret);
     ESP_RETURN_ON_ERROR(nand_emul_write(handle, (size_t)dst_offset + handle->chip.page_size,
                                         s_oob_used_page_markers, sizeof(s_oob_used_page_markers)), TAG, "Error in nand_copy %d", ret);
+    nand_emul_simulate_op(handle, NAND_EMUL_OP_COPY, 0);
 
     return ret;
 }
@@ -271,5 +366,6 @@ esp_err_t nand_copy(spi_nand_flash_device_t *handle, uint32_t src, uint32_t dst)
 esp_err_t nand_get_ecc_status(spi_nand_flash_device_t *handle, uint32_t page)
 {
     esp_err_t ret = ESP_OK;
+    handle->chip.ecc_data.ecc_corrected_bits_status = nand_emul_get_ecc_status(handle, page);
     return ret;
 }
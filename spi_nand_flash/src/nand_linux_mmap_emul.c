@@ -42,6 +42,11 @@ static esp_err_t nand_emul_mmap_init(nand_mmap_emul_handle_t *emul_handle)
         return ESP_ERR_NOT_FOUND;
     }
 
+    // A file that already has the right size holds a previous image: keep its contents so it can be mounted again
+    struct stat st;
+    bool reuse_image = fstat(emul_handle->mem_file_fd, &st) == 0 &&
+                       (size_t)st.st_size == emul_handle->file_mmap_ctrl.flash_file_size;
+
     // Set file size
     if (ftruncate(emul_handle->mem_file_fd, emul_handle->file_mmap_ctrl.flash_file_size) != 0) {
         ESP_LOGE(TAG, "Failed to set NAND file size: %s", strerror(errno));
@@ -60,7 +65,9 @@ static esp_err_t nand_emul_mmap_init(nand_mmap_emul_handle_t *emul_handle)
     }
 
     // Initialize with 0xFF (erased state)
-    memset(emul_handle->mem_file_buf, 0xFF, emul_handle->file_mmap_ctrl.flash_file_size);
+    if (!reuse_image) {
+        memset(emul_handle->mem_file_buf, 0xFF, emul_handle->file_mmap_ctrl.flash_file_size);
+    }
 
     ESP_LOGI(TAG, "NAND flash emulation initialized: %s (size: %zu bytes)",
              emul_handle->file_mmap_ctrl.flash_file_name,
@@ -146,6 +153,7 @@ esp_err_t nand_emul_init(spi_nand_flash_device_t *handle, nand_file_mmap_emul_co
     }
     emul_handle->file_mmap_ctrl.flash_file_size = cfg->flash_file_size ? cfg->flash_file_size : EMULATED_NAND_SIZE;
     emul_handle->file_mmap_ctrl.keep_dump = cfg->keep_dump;
+    emul_handle->file_mmap_ctrl.spi_clock_hz = cfg->spi_clock_hz ? cfg->spi_clock_hz : NAND_EMUL_DEFAULT_SPI_CLOCK_HZ;
 
     esp_err_t err = nand_emul_mmap_init(emul_handle);
     if (err != ESP_OK) {
@@ -161,6 +169,10 @@ esp_err_t nand_emul_deinit(spi_nand_flash_device_t *handle)
         return ESP_OK;
     }
     esp_err_t ret = nand_emul_mmap_deinit(handle->emul_handle);
+#ifdef CONFIG_NAND_ENABLE_STATS
+    free(handle->emul_handle->erase_counts);
+    free(handle->emul_handle->ecc_status);
+#endif
     free(handle->emul_handle);
     handle->emul_handle = NULL;
     return ret;
@@ -222,6 +234,10 @@ esp_err_t nand_emul_write(spi_nand_flash_device_t *handle, size_t addr, const vo
 #ifdef CONFIG_NAND_ENABLE_STATS
     emul_handle->stats.write_ops++;
     emul_handle->stats.write_bytes += size;
+    // Freshly programmed cells read back clean
+    if (addr / handle->chip.emulated_page_size < emul_handle->ecc_status_len) {
+        emul_handle->ecc_status[addr / handle->chip.emulated_page_size] = NAND_ECC_OK;
+    }
 #endif
 
     return ESP_OK;
@@ -252,12 +268,39 @@ esp_err_t nand_emul_erase_block(spi_nand_flash_device_t *handle, size_t offset)
 
 #ifdef CONFIG_NAND_ENABLE_STATS
     emul_handle->stats.erase_ops++;
+    if (emul_handle->erase_counts == NULL) {
+        emul_handle->erase_counts = calloc(limit / nbytes, sizeof(uint32_t));
+        emul_handle->erase_counts_len = emul_handle->erase_counts ? limit / nbytes : 0;
+    }
+    if (offset / nbytes < emul_handle->erase_counts_len) {
+        emul_handle->erase_counts[offset / nbytes]++;
+    }
+    for (uint32_t i = 0; i < (1u << handle->chip.log2_ppb); i++) {
+        size_t page = offset / handle->chip.emulated_page_size + i;
+        if (page < emul_handle->ecc_status_len) {
+            emul_handle->ecc_status[page] = NAND_ECC_OK;
+        }
+    }
 #endif
 
     return ESP_OK;
 }
 
 #ifdef CONFIG_NAND_ENABLE_STATS
+void nand_emul_get_stats(spi_nand_flash_device_t *handle, size_t *read_ops, size_t *write_ops, size_t *erase_ops,
+                         size_t *read_bytes, size_t *write_bytes)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (emul_handle == NULL) {
+        return;
+    }
+    *read_ops = emul_handle->stats.read_ops;
+    *write_ops = emul_handle->stats.write_ops;
+    *erase_ops = emul_handle->stats.erase_ops;
+    *read_bytes = emul_handle->stats.read_bytes;
+    *write_bytes = emul_handle->stats.write_bytes;
+}
+
 // Clear statistics
 void nand_emul_clear_stats(spi_nand_flash_device_t *handle)
 {
@@ -270,5 +313,270 @@ void nand_emul_clear_stats(spi_nand_flash_device_t *handle)
     emul_handle->stats.erase_ops = 0;
     emul_handle->stats.read_bytes = 0;
     emul_handle->stats.write_bytes = 0;
+    memset(&emul_handle->perf, 0, sizeof(emul_handle->perf));
+    emul_handle->elapsed_ns = 0;
+    emul_handle->bus_ns = 0;
+    if (emul_handle->erase_counts) {
+        memset(emul_handle->erase_counts, 0, emul_handle->erase_counts_len * sizeof(uint32_t));
+    }
+}
+
+/* Timing model. Transfers are counted in SPI clock cycles following spi_nand_oper.c: the command byte always goes
+ * over one line, the column address and dummy cycles of reads over the data lines in DIO/QIO, and data over 2 lines
+ * (dual reads), 4 lines (quad reads and quad program loads) or 1. Every array operation is followed by one
+ * GET FEATURE poll of the status register. */
+#define SIM_CYCLES_ROW_CMD      32  // PAGE READ / PROGRAM EXECUTE / BLOCK ERASE: command + 24-bit row address
+#define SIM_CYCLES_STATUS_POLL  24  // GET FEATURE: command + register address + status byte
+#define SIM_CYCLES_WRITE_ENABLE 8
+#define SIM_CYCLES_PROGRAM_LOAD 24  // command + 16-bit column address, before the data
+
+static uint32_t sim_read_cache_cycles(spi_nand_flash_io_mode_t io_mode, size_t bytes)
+{
+    switch (io_mode) {
+    case SPI_NAND_IO_MODE_DOUT:
+        return 8 + 16 + 8 + bytes * 4;
+    case SPI_NAND_IO_MODE_DIO:
+        return 8 + 8 + 4 + bytes * 4;
+    case SPI_NAND_IO_MODE_QOUT:
+        return 8 + 16 + 8 + bytes * 2;
+    case SPI_NAND_IO_MODE_QIO:
+        return 8 + 4 + 4 + bytes * 2;
+    default:
+        return 8 + 16 + 8 + bytes * 8;
+    }
+}
+
+static uint32_t sim_program_load_cycles(spi_nand_flash_io_mode_t io_mode, size_t bytes)
+{
+    if (io_mode == SPI_NAND_IO_MODE_QOUT || io_mode == SPI_NAND_IO_MODE_QIO) {
+        return SIM_CYCLES_PROGRAM_LOAD + bytes * 2;
+    }
+    return SIM_CYCLES_PROGRAM_LOAD + bytes * 8;
+}
+
+void nand_emul_simulate_op(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t bytes)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (emul_handle == NULL) {
+        return;
+    }
+    spi_nand_flash_io_mode_t io_mode = handle->config.io_mode;
+    uint64_t cycles = 0;
+    uint64_t busy_us = 0;
+
+    switch (op) {
+    case NAND_EMUL_OP_READ:
+        cycles = SIM_CYCLES_ROW_CMD + SIM_CYCLES_STATUS_POLL + sim_read_cache_cycles(io_mode, bytes);
+        busy_us = handle->chip.read_page_delay_us;
+        emul_handle->perf.page_reads++;
+        break;
+    case NAND_EMUL_OP_PROGRAM:
+        cycles = SIM_CYCLES_WRITE_ENABLE + sim_program_load_cycles(io_mode, bytes) + SIM_CYCLES_ROW_CMD +
+                 SIM_CYCLES_STATUS_POLL;
+        busy_us = handle->chip.program_page_delay_us;
+        emul_handle->perf.page_programs++;
+        break;
+    case NAND_EMUL_OP_COPY:
+        cycles = SIM_CYCLES_ROW_CMD + SIM_CYCLES_STATUS_POLL + SIM_CYCLES_WRITE_ENABLE + SIM_CYCLES_ROW_CMD +
+                 SIM_CYCLES_STATUS_POLL;
+        busy_us = (uint64_t)handle->chip.read_page_delay_us + handle->chip.program_page_delay_us;
+        emul_handle->perf.page_reads++;
+        emul_handle->perf.page_programs++;
+        break;
+    case NAND_EMUL_OP_ERASE:
+        cycles = SIM_CYCLES_WRITE_ENABLE + SIM_CYCLES_ROW_CMD + SIM_CYCLES_STATUS_POLL;
+        busy_us = handle->chip.erase_block_delay_us;
+        emul_handle->perf.block_erases++;
+        break;
+    }
+
+    uint64_t bus_ns = cycles * 1000000000ULL / emul_handle->file_mmap_ctrl.spi_clock_hz;
+    emul_handle->bus_ns += bus_ns;
+    emul_handle->elapsed_ns += bus_ns + busy_us * 1000;
+}
+
+void nand_emul_record_host_writes(spi_nand_flash_device_t *handle, uint32_t count)
+{
+    if (handle->emul_handle != NULL) {
+        handle->emul_handle->perf.host_page_writes += count;
+    }
+}
+
+esp_err_t nand_emul_get_perf_stats(spi_nand_flash_device_t *handle, nand_emul_perf_stats_t *stats)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (emul_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *stats = emul_handle->perf;
+    stats->elapsed_us = emul_handle->elapsed_ns / 1000;
+    stats->bus_us = emul_handle->bus_ns / 1000;
+    return ESP_OK;
+}
+
+float nand_emul_write_amplification(const nand_emul_perf_stats_t *stats)
+{
+    if (stats == NULL || stats->host_page_writes == 0) {
+        return 0.0f;
+    }
+    return (float)stats->page_programs / (float)stats->host_page_writes;
+}
+
+esp_err_t nand_emul_get_erase_counts(spi_nand_flash_device_t *handle, uint32_t *counts, uint32_t num_blocks)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (counts == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (emul_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        counts[i] = i < emul_handle->erase_counts_len ? emul_handle->erase_counts[i] : 0;
+    }
+    return ESP_OK;
+}
+
+/* Operations interrupted by a power cut leave their pages uncorrectable. That is recorded in the image itself, in the
+ * last OOB byte of the page (not used by the driver), so that it lasts across remounts until the block is erased. */
+static inline uint8_t *torn_marker(const spi_nand_flash_device_t *handle, size_t page_offset)
+{
+    return (uint8_t *)handle->emul_handle->mem_file_buf + page_offset + handle->chip.emulated_page_size - 1;
+}
+
+esp_err_t nand_emul_inject_ecc_status(spi_nand_flash_device_t *handle, uint32_t page, nand_ecc_status_t status)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (emul_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // The statuses are kept for every page of the chip, whichever partition they are injected through
+    const uint32_t num_pages = emul_handle->file_mmap_ctrl.flash_file_size / handle->chip.emulated_page_size;
+    if (page >= handle->chip.num_blocks << handle->chip.log2_ppb || status >= NAND_ECC_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    page = nand_chip_page(handle, page);
+    if (emul_handle->ecc_status == NULL) {
+        emul_handle->ecc_status = calloc(num_pages, sizeof(uint8_t));
+        if (emul_handle->ecc_status == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        emul_handle->ecc_status_len = num_pages;
+    }
+    emul_handle->ecc_status[page] = (uint8_t)status;
+    return ESP_OK;
+}
+
+nand_ecc_status_t nand_emul_get_ecc_status(spi_nand_flash_device_t *handle, uint32_t page)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    page = nand_chip_page(handle, page);
+    if (emul_handle == NULL) {
+        return NAND_ECC_OK;
+    }
+    if (*torn_marker(handle, (size_t)page * handle->chip.emulated_page_size) != 0xFF) {
+        return NAND_ECC_NOT_CORRECTED;
+    }
+    if (page >= emul_handle->ecc_status_len) {
+        return NAND_ECC_OK;
+    }
+    return (nand_ecc_status_t)emul_handle->ecc_status[page];
+}
+
+esp_err_t nand_emul_inject_fault(spi_nand_flash_device_t *handle, const nand_emul_fault_config_t *fault)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (emul_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (fault != NULL && (unsigned)fault->type > NAND_EMUL_FAULT_PROGRAM_FAIL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&emul_handle->fault, 0, sizeof(emul_handle->fault));
+    if (fault != NULL) {
+        emul_handle->fault = *fault;
+    }
+    // xorshift32 must not start from 0
+    emul_handle->fault_rng = emul_handle->fault.seed ? emul_handle->fault.seed : 0x2545F491;
+    emul_handle->fault_hit = false;
+    return ESP_OK;
+}
+
+bool nand_emul_fault_hit(spi_nand_flash_device_t *handle)
+{
+    return handle->emul_handle != NULL && handle->emul_handle->fault_hit;
+}
+
+static uint32_t fault_random(nand_mmap_emul_handle_t *emul_handle)
+{
+    uint32_t x = emul_handle->fault_rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emul_handle->fault_rng = x;
+    return x;
+}
+
+// Leave a program interrupted half-way: some of the cells of the page programmed, the used marker among them
+static void tear_program(spi_nand_flash_device_t *handle, size_t offset)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    uint8_t *page = (uint8_t *)emul_handle->mem_file_buf + offset;
+
+    for (uint32_t i = 0; i < handle->chip.page_size; i++) {
+        page[i] &= (uint8_t)(fault_random(emul_handle) | fault_random(emul_handle));
+    }
+    // Byte 2-3 of the OOB: used page marker, see nand_impl_linux.c
+    page[handle->chip.page_size + 2] = 0;
+    page[handle->chip.page_size + 3] = 0;
+    *torn_marker(handle, offset) = 0;
+}
+
+// Leave an erase interrupted half-way: the first pages of the block erased, the others unreadable
+static void tear_erase(spi_nand_flash_device_t *handle, size_t offset)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    const uint32_t ppb = 1u << handle->chip.log2_ppb;
+    const uint32_t erased = fault_random(emul_handle) % ppb;
+
+    memset((uint8_t *)emul_handle->mem_file_buf + offset, 0xFF, (size_t)erased * handle->chip.emulated_page_size);
+    for (uint32_t i = erased; i < ppb; i++) {
+        *torn_marker(handle, offset + (size_t)i * handle->chip.emulated_page_size) = 0;
+    }
+}
+
+esp_err_t nand_emul_fault_point(spi_nand_flash_device_t *handle, nand_emul_op_t op, size_t offset)
+{
+    nand_mmap_emul_handle_t *emul_handle = handle->emul_handle;
+    if (emul_handle == NULL || emul_handle->fault.type == NAND_EMUL_FAULT_NONE) {
+        return ESP_OK;
+    }
+    if (emul_handle->fault_hit) {
+        // A program failure hits once, a power cut lasts
+        return emul_handle->fault.type == NAND_EMUL_FAULT_POWER_CUT ? ESP_ERR_INVALID_STATE : ESP_OK;
+    }
+    if (emul_handle->fault.after_ops > 0) {
+        emul_handle->fault.after_ops--;
+        return ESP_OK;
+    }
+
+    emul_handle->fault_hit = true;
+    if (emul_handle->fault.type == NAND_EMUL_FAULT_PROGRAM_FAIL) {
+        ESP_LOGD(TAG, "injected %s failure at offset %zu", op == NAND_EMUL_OP_ERASE ? "erase" : "program", offset);
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    ESP_LOGD(TAG, "power cut at offset %zu", offset);
+    if (emul_handle->fault.torn) {
+        if (op == NAND_EMUL_OP_ERASE) {
+            tear_erase(handle, offset);
+        } else {
+            tear_program(handle, offset);
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
 }
 #endif
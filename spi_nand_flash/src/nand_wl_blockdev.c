@@ -11,6 +11,7 @@
 #include "esp_blockdev.h"
 #include "esp_nand_blockdev.h"
 #include "nand_device_types.h"
+#include "nand_diag_api.h"
 
 static const char *TAG = "nand_wl_blockdev";
 
@@ -47,14 +48,10 @@ static esp_err_t spi_nand_flash_wl_blockdev_read(esp_blockdev_handle_t handle, u
     uint32_t start_page_id = (uint32_t)(src_addr >> dev_handle->chip.log2_page_size);
     uint32_t page_count = (uint32_t)(data_read_len >> dev_handle->chip.log2_page_size);
 
-    esp_err_t ret = ESP_OK;
-    for (uint32_t page_id = start_page_id; page_id < (start_page_id + page_count); page_id++) {
-        ret = spi_nand_flash_read_page(dev_handle, dst_buf, page_id);
-        if (ret) {
-            ESP_LOGE(TAG, "%s, Failed to read the page, result=0x%08x", __func__, ret);
-            return ret;
-        }
-        dst_buf += page_size;
+    esp_err_t ret = spi_nand_flash_read_pages(dev_handle, dst_buf, start_page_id, page_count);
+    if (ret) {
+        ESP_LOGE(TAG, "%s, Failed to read the pages, result=0x%08x", __func__, ret);
+        return ret;
     }
     ESP_LOGV(TAG, "read - src_addr=0x%.16" PRIx64 ", size=0x%08" PRIx32 ", result=0x%08x", src_addr, (uint32_t)data_read_len, ret);
     return ret;
@@ -85,14 +82,10 @@ static esp_err_t spi_nand_flash_wl_blockdev_write(esp_blockdev_handle_t handle,
     spi_nand_flash_device_t *dev_handle = (spi_nand_flash_device_t *)((esp_blockdev_handle_t)handle->ctx)->ctx;
     uint32_t start_page_id = (uint32_t)(dst_addr >> dev_handle->chip.log2_page_size);
     uint32_t page_count = (uint32_t)(data_write_len >> dev_handle->chip.log2_page_size);
-    esp_err_t ret = ESP_OK;
-    for (uint32_t page_id = start_page_id; page_id < (start_page_id + page_count); page_id++) {
-        ret = spi_nand_flash_write_page(dev_handle, src_buf, page_id);
-        if (ret) {
-            ESP_LOGE(TAG, "%s, Failed to write the page", __func__);
-            return ret;
-        }
-        src_buf += page_size;
+    esp_err_t ret = spi_nand_flash_write_pages(dev_handle, src_buf, start_page_id, page_count);
+    if (ret) {
+        ESP_LOGE(TAG, "%s, Failed to write the pages", __func__);
+        return ret;
     }
     ESP_LOGV(TAG, "write - dst_addr=0x%.16" PRIx64 ", size=0x%08" PRIx32 ", result=0x%08x", dst_addr, (uint32_t)data_write_len, ret);
     return ret;
@@ -121,13 +114,10 @@ static esp_err_t spi_nand_flash_wl_blockdev_erase(esp_blockdev_handle_t handle,
     spi_nand_flash_device_t *dev_handle = (spi_nand_flash_device_t *)((esp_blockdev_handle_t)handle->ctx)->ctx;
     uint32_t page_count = (uint32_t)(erase_len >> dev_handle->chip.log2_page_size);
     uint32_t start_page_id = (uint32_t)(start_addr >> dev_handle->chip.log2_page_size);
-    esp_err_t ret = ESP_OK;
-    for (uint32_t page_id = start_page_id; page_id < (start_page_id + page_count); page_id++) {
-        ret = spi_nand_flash_trim(dev_handle, page_id);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "%s, Failed to trim the page", __func__);
-            return ret;
-        }
+    esp_err_t ret = spi_nand_flash_trim_range(dev_handle, start_page_id, page_count);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "%s, Failed to trim the pages", __func__);
+        return ret;
     }
     ret = spi_nand_flash_gc(dev_handle);
     ESP_LOGV(TAG, "erase - start_addr=0x%.16" PRIx64 ", size=0x%zx, result=0x%08x", start_addr, erase_len, ret);
@@ -172,12 +162,10 @@ static esp_err_t spi_nand_flash_wl_blockdev_ioctl(esp_blockdev_handle_t handle,
                      start_page_id, page_count, total_pages);
             return ESP_ERR_INVALID_ARG;
         }
-        for (uint32_t page_id = start_page_id; page_id < (start_page_id + page_count); page_id++) {
-            ret = spi_nand_flash_trim(dev_handle, page_id);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to trim page %"PRIu32"", page_id);
-                return ret;
-            }
+        ret = spi_nand_flash_trim_range(dev_handle, start_page_id, page_count);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to trim pages %"PRIu32"-%"PRIu32"", start_page_id, start_page_id + page_count - 1);
+            return ret;
         }
     }
     break;
@@ -189,6 +177,11 @@ static esp_err_t spi_nand_flash_wl_blockdev_ioctl(esp_blockdev_handle_t handle,
     }
     break;
 
+    case ESP_BLOCKDEV_CMD_GET_WEAR_STATS: {
+        ret = nand_get_wear_stats(dev_handle, (esp_blockdev_cmd_arg_wear_stats_t *)args);
+    }
+    break;
+
     default:
         return ESP_ERR_NOT_SUPPORTED;
     }
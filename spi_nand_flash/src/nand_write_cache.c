@@ -0,0 +1,298 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nand.h"
+#include "nand_write_cache.h"
+
+static const char *TAG = "nand_wcache";
+
+typedef struct {
+    uint32_t page_id;
+    uint32_t last_use;      // Value of the cache use counter at the last access, the smallest one is evicted first
+    bool valid;
+    bool dirty;
+} nand_write_cache_entry_t;
+
+struct nand_write_cache {
+    spi_nand_flash_device_t *handle;
+    uint32_t num_entries;
+    uint32_t num_pages;      // Capacity of the wear-levelling layer, writes past it are left to it to reject
+    uint32_t use_counter;
+    uint32_t dirty_count;
+    TickType_t dirty_since;  // When the cache went from clean to dirty
+    TaskHandle_t flush_task;
+    SemaphoreHandle_t flush_task_done;
+    volatile bool flush_task_stop;
+    nand_write_cache_stats_t stats;
+    nand_write_cache_entry_t *entries;
+    uint8_t *data;           // num_entries pages, entry i at data + i * page_size
+};
+
+static inline uint8_t *entry_data(nand_write_cache_t *cache, uint32_t index)
+{
+    return cache->data + ((size_t)index << cache->handle->chip.log2_page_size);
+}
+
+static int find_entry(nand_write_cache_t *cache, uint32_t page_id)
+{
+    for (uint32_t i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].valid && cache->entries[i].page_id == page_id) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static esp_err_t write_back(nand_write_cache_t *cache, uint32_t index)
+{
+    nand_write_cache_entry_t *entry = &cache->entries[index];
+    if (!entry->valid || !entry->dirty) {
+        return ESP_OK;
+    }
+    spi_nand_flash_device_t *handle = cache->handle;
+    esp_err_t ret = handle->ops->write(handle, entry_data(cache, index), entry->page_id);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    entry->dirty = false;
+    cache->dirty_count--;
+    cache->stats.writebacks++;
+    return ESP_OK;
+}
+
+static void flush_task(void *arg)
+{
+    nand_write_cache_t *cache = (nand_write_cache_t *)arg;
+    spi_nand_flash_device_t *handle = cache->handle;
+    TickType_t flush_ticks = pdMS_TO_TICKS(CONFIG_NAND_FLASH_WRITE_CACHE_FLUSH_MS);
+    if (flush_ticks == 0) {
+        flush_ticks = 1;
+    }
+    TickType_t wait_ticks = portMAX_DELAY;
+
+    while (true) {
+        // Woken up by nand_write_cache_write() when the cache gets its first dirty page
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+        if (cache->flush_task_stop) {
+            break;
+        }
+
+        xSemaphoreTake(handle->mutex, portMAX_DELAY);
+        wait_ticks = portMAX_DELAY;
+        if (cache->dirty_count > 0) {
+            TickType_t age = xTaskGetTickCount() - cache->dirty_since;
+            if (age < flush_ticks) {
+                wait_ticks = flush_ticks - age;
+            } else if (nand_write_cache_flush(handle) != ESP_OK ||
+                       (handle->ops->sync && handle->ops->sync(handle) != ESP_OK)) {
+                // Synchronised like spi_nand_flash_sync(), so that the flushed pages survive a power loss
+                ESP_LOGW(TAG, "timed flush failed, retrying later");
+                wait_ticks = flush_ticks;
+            }
+        }
+        xSemaphoreGive(handle->mutex);
+    }
+
+    xSemaphoreGive(cache->flush_task_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t nand_write_cache_create(spi_nand_flash_device_t *handle)
+{
+    esp_err_t ret = ESP_OK;
+    nand_write_cache_t *cache = heap_caps_calloc(1, sizeof(nand_write_cache_t), MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(cache, ESP_ERR_NO_MEM, TAG, "nomem");
+    cache->handle = handle;
+    cache->num_entries = CONFIG_NAND_FLASH_WRITE_CACHE_PAGES;
+    ESP_GOTO_ON_ERROR(handle->ops->get_capacity(handle, &cache->num_pages), fail, TAG, "");
+
+    cache->entries = heap_caps_calloc(cache->num_entries, sizeof(nand_write_cache_entry_t), MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE(cache->entries, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+    cache->data = heap_caps_malloc((size_t)cache->num_entries * handle->chip.page_size, MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE(cache->data, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+
+    cache->flush_task_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(cache->flush_task_done, ESP_ERR_NO_MEM, fail, TAG, "nomem");
+    ESP_GOTO_ON_FALSE(xTaskCreate(flush_task, "nand_wcache", CONFIG_NAND_FLASH_WRITE_CACHE_TASK_STACK_SIZE, cache,
+                                  CONFIG_NAND_FLASH_WRITE_CACHE_TASK_PRIORITY, &cache->flush_task) == pdPASS,
+                      ESP_ERR_NO_MEM, fail, TAG, "Failed to create write cache flush task");
+
+    handle->write_cache = cache;
+    return ESP_OK;
+
+fail:
+    if (cache->flush_task_done) {
+        vSemaphoreDelete(cache->flush_task_done);
+    }
+    free(cache->data);
+    free(cache->entries);
+    free(cache);
+    return ret;
+}
+
+esp_err_t nand_write_cache_destroy(spi_nand_flash_device_t *handle)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return ESP_OK;
+    }
+
+    cache->flush_task_stop = true;
+    xTaskNotifyGive(cache->flush_task);
+    xSemaphoreTake(cache->flush_task_done, portMAX_DELAY);
+    vSemaphoreDelete(cache->flush_task_done);
+
+    esp_err_t ret = nand_write_cache_flush(handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to flush %"PRIu32" cached pages", cache->dirty_count);
+    }
+    handle->write_cache = NULL;
+    free(cache->data);
+    free(cache->entries);
+    free(cache);
+    return ret;
+}
+
+bool nand_write_cache_read(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t page_id)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return false;
+    }
+    int index = find_entry(cache, page_id);
+    if (index < 0) {
+        return false;
+    }
+    memcpy(buffer, entry_data(cache, index), handle->chip.page_size);
+    cache->entries[index].last_use = ++cache->use_counter;
+    cache->stats.read_hits++;
+    return true;
+}
+
+void nand_write_cache_overlay(spi_nand_flash_device_t *handle, uint8_t *buffer, uint32_t start_page, uint32_t count)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->num_entries; i++) {
+        nand_write_cache_entry_t *entry = &cache->entries[i];
+        if (entry->valid && entry->page_id - start_page < count) {
+            memcpy(buffer + ((size_t)(entry->page_id - start_page) << handle->chip.log2_page_size),
+                   entry_data(cache, i), handle->chip.page_size);
+            cache->stats.read_hits++;
+        }
+    }
+}
+
+esp_err_t nand_write_cache_write(spi_nand_flash_device_t *handle, const uint8_t *buffer, uint32_t page_id)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    int index = find_entry(cache, page_id);
+
+    if (index >= 0) {
+        cache->stats.write_hits++;
+    } else {
+        // Take a free entry, or else the least recently used one
+        uint32_t victim = 0;
+        for (uint32_t i = 0; i < cache->num_entries; i++) {
+            if (!cache->entries[i].valid) {
+                victim = i;
+                break;
+            }
+            if (cache->entries[i].last_use - cache->entries[victim].last_use > UINT32_MAX / 2) {
+                victim = i;
+            }
+        }
+        ESP_RETURN_ON_ERROR(write_back(cache, victim), TAG, "Failed to write back page %"PRIu32,
+                            cache->entries[victim].page_id);
+        cache->entries[victim].valid = true;
+        cache->entries[victim].page_id = page_id;
+        index = (int)victim;
+        cache->stats.write_misses++;
+    }
+
+    memcpy(entry_data(cache, index), buffer, handle->chip.page_size);
+    cache->entries[index].last_use = ++cache->use_counter;
+    if (!cache->entries[index].dirty) {
+        cache->entries[index].dirty = true;
+        if (cache->dirty_count++ == 0) {
+            cache->dirty_since = xTaskGetTickCount();
+            xTaskNotifyGive(cache->flush_task);
+        }
+    }
+    return ESP_OK;
+}
+
+void nand_write_cache_discard(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->num_entries; i++) {
+        nand_write_cache_entry_t *entry = &cache->entries[i];
+        if (entry->valid && entry->page_id - start_page < count) {
+            if (entry->dirty) {
+                cache->dirty_count--;
+            }
+            entry->valid = false;
+            entry->dirty = false;
+        }
+    }
+}
+
+void nand_write_cache_invalidate(spi_nand_flash_device_t *handle)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return;
+    }
+    memset(cache->entries, 0, cache->num_entries * sizeof(nand_write_cache_entry_t));
+    cache->dirty_count = 0;
+}
+
+esp_err_t nand_write_cache_flush_page(spi_nand_flash_device_t *handle, uint32_t page_id)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return ESP_OK;
+    }
+    int index = find_entry(cache, page_id);
+    return index < 0 ? ESP_OK : write_back(cache, index);
+}
+
+esp_err_t nand_write_cache_flush(spi_nand_flash_device_t *handle)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    if (cache == NULL) {
+        return ESP_OK;
+    }
+    for (uint32_t i = 0; i < cache->num_entries && cache->dirty_count > 0; i++) {
+        ESP_RETURN_ON_ERROR(write_back(cache, i), TAG, "Failed to write back page %"PRIu32, cache->entries[i].page_id);
+    }
+    return ESP_OK;
+}
+
+bool nand_write_cache_bypass(spi_nand_flash_device_t *handle, uint32_t start_page, uint32_t count)
+{
+    nand_write_cache_t *cache = handle->write_cache;
+    return cache == NULL || count > cache->num_entries / 2 || (uint64_t)start_page + count > cache->num_pages;
+}
+
+esp_err_t nand_write_cache_get_stats(spi_nand_flash_device_t *handle, nand_write_cache_stats_t *stats)
+{
+    if (handle->write_cache == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    *stats = handle->write_cache->stats;
+    return ESP_OK;
+}
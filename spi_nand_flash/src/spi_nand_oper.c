@@ -133,6 +133,24 @@ esp_err_t spi_nand_read_page(spi_nand_flash_device_t *handle, uint32_t page)
     return spi_nand_execute_transaction(handle, &t);
 }
 
+esp_err_t spi_nand_read_page_cache_seq(spi_nand_flash_device_t *handle)
+{
+    spi_nand_transaction_t t = {
+        .command = CMD_PAGE_READ_CACHE_SEQ
+    };
+
+    return spi_nand_execute_transaction(handle, &t);
+}
+
+esp_err_t spi_nand_read_page_cache_last(spi_nand_flash_device_t *handle)
+{
+    spi_nand_transaction_t t = {
+        .command = CMD_PAGE_READ_CACHE_LAST
+    };
+
+    return spi_nand_execute_transaction(handle, &t);
+}
+
 size_t spi_nand_get_dma_alignment(void)
 {
     size_t alignment;
@@ -388,12 +406,12 @@ esp_err_t spi_nand_program_execute(spi_nand_flash_device_t *handle, uint32_t pag
     return spi_nand_execute_transaction(handle, &t);
 }
 
-esp_err_t spi_nand_program_load(spi_nand_flash_device_t *handle, const uint8_t *data, uint16_t column, uint16_t length)
+static esp_err_t program_load(spi_nand_flash_device_t *handle, uint8_t cmd, uint8_t cmd_x4, const uint8_t *data,
+                              uint16_t column, uint16_t length)
 {
-    uint8_t cmd = CMD_PROGRAM_LOAD;
     uint32_t spi_flags = 0;
     if (handle->config.io_mode == SPI_NAND_IO_MODE_QOUT || handle->config.io_mode == SPI_NAND_IO_MODE_QIO) {
-        cmd = CMD_PROGRAM_LOAD_X4;
+        cmd = cmd_x4;
         spi_flags = SPI_TRANS_MODE_QIO;
     }
 
@@ -418,6 +436,16 @@ esp_err_t spi_nand_program_load(spi_nand_flash_device_t *handle, const uint8_t *
     return spi_nand_execute_transaction(handle, &t);
 }
 
+esp_err_t spi_nand_program_load(spi_nand_flash_device_t *handle, const uint8_t *data, uint16_t column, uint16_t length)
+{
+    return program_load(handle, CMD_PROGRAM_LOAD, CMD_PROGRAM_LOAD_X4, data, column, length);
+}
+
+esp_err_t spi_nand_program_load_reset(spi_nand_flash_device_t *handle, const uint8_t *data, uint16_t column, uint16_t length)
+{
+    return program_load(handle, CMD_PROGRAM_LOAD_RESET, CMD_PROGRAM_LOAD_RESET_X4, data, column, length);
+}
+
 esp_err_t spi_nand_erase_block(spi_nand_flash_device_t *handle, uint32_t page)
 {
     spi_nand_transaction_t  t = {
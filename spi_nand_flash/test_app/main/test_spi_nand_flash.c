@@ -19,6 +19,7 @@
 #include "driver/spi_master.h"
 #include "spi_nand_flash.h"
 #include "nand_private/nand_impl_wrap.h"
+#include "nand_diag_api.h"
 #include "unity.h"
 #include "soc/spi_pins.h"
 #include "sdkconfig.h"
@@ -342,6 +343,55 @@ TEST_CASE("verify nand_prog, nand_read, nand_copy, nand_is_free works (bypassing
 }
 */
 
+#if CONFIG_NAND_FLASH_LATENCY_STATS
+TEST_CASE("nand operation latency statistics", "[spi_nand_flash]")
+{
+    spi_nand_flash_device_t *nand_flash_device_handle;
+    spi_device_handle_t spi;
+    uint32_t page_size, block_size;
+
+    setup_nand_flash(&nand_flash_device_handle, &spi, SPI_NAND_IO_MODE_SIO, SPI_DEVICE_HALFDUPLEX);
+    TEST_ESP_OK(spi_nand_flash_get_page_size(nand_flash_device_handle, &page_size));
+    TEST_ESP_OK(spi_nand_flash_get_block_size(nand_flash_device_handle, &block_size));
+
+    uint8_t *pattern_buf = (uint8_t *)heap_caps_malloc(page_size, MALLOC_CAP_DMA);
+    TEST_ASSERT_NOT_NULL(pattern_buf);
+    uint8_t *temp_buf = (uint8_t *)heap_caps_malloc(page_size, MALLOC_CAP_DMA);
+    TEST_ASSERT_NOT_NULL(temp_buf);
+    spi_nand_flash_fill_buffer(pattern_buf, page_size / sizeof(uint32_t));
+
+    const uint32_t test_block = 22;
+    const uint32_t first_page = test_block * (block_size / page_size);
+    const uint32_t num_test_pages = 8;
+    TEST_ESP_OK(nand_reset_latency_stats(nand_flash_device_handle));
+    TEST_ESP_OK(nand_wrap_erase_block(nand_flash_device_handle, test_block));
+    for (uint32_t page = first_page; page < first_page + num_test_pages; page++) {
+        TEST_ESP_OK(nand_wrap_prog(nand_flash_device_handle, page, pattern_buf));
+        TEST_ESP_OK(nand_wrap_read(nand_flash_device_handle, page, 0, page_size, temp_buf));
+        TEST_ASSERT_EQUAL(0, spi_nand_flash_check_buffer(temp_buf, page_size / sizeof(uint32_t)));
+    }
+
+    for (int op = 0; op < NAND_LATENCY_OP_MAX; op++) {
+        nand_latency_stats_t stats;
+        TEST_ESP_OK(nand_get_latency_stats(nand_flash_device_handle, (nand_latency_op_t)op, &stats));
+        TEST_ASSERT_TRUE(stats.count > 0);
+        TEST_ASSERT_TRUE(stats.min_us <= stats.max_us);
+        uint32_t hist_total = 0;
+        for (int i = 0; i < NAND_LATENCY_HIST_BUCKETS; i++) {
+            hist_total += stats.hist[i];
+        }
+        TEST_ASSERT_EQUAL_UINT32(stats.count, hist_total);
+        printf("op %d: count=%" PRIu32 " min=%" PRIu32 "us max=%" PRIu32 "us avg=%" PRIu32 "us\n", op, stats.count,
+               stats.min_us, stats.max_us, (uint32_t)(stats.total_us / stats.count));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, nand_get_latency_stats(nand_flash_device_handle, NAND_LATENCY_OP_MAX, NULL));
+
+    free(pattern_buf);
+    free(temp_buf);
+    deinit_nand_flash(nand_flash_device_handle, spi);
+}
+#endif //CONFIG_NAND_FLASH_LATENCY_STATS
+
 TEST_CASE("Fail safe test if chip is not detected", "[spi_nand_flash]")
 {
     spi_device_handle_t spi;
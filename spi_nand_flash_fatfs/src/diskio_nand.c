@@ -32,16 +32,11 @@ DRESULT ff_nand_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
     ESP_LOGV(TAG, "ff_nand_read - pdrv=%i, sector=%lu, count=%u", (unsigned int) pdrv, (unsigned long) sector,
              (unsigned int) count);
     esp_err_t ret;
-    uint32_t page_size;
     spi_nand_flash_device_t *dev = ff_nand_handles[pdrv];
     assert(dev);
 
-    ESP_GOTO_ON_ERROR(spi_nand_flash_get_page_size(dev, &page_size), fail, TAG, "");
-
-    for (uint32_t i = 0; i < count; i++) {
-        ESP_GOTO_ON_ERROR(spi_nand_flash_read_page(dev, buff + i * page_size, sector + i),
-                          fail, TAG, "spi_nand_flash_read_page failed");
-    }
+    ESP_GOTO_ON_ERROR(spi_nand_flash_read_pages(dev, buff, sector, count),
+                      fail, TAG, "spi_nand_flash_read_pages failed");
 
     return RES_OK;
 
@@ -55,16 +50,11 @@ DRESULT ff_nand_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
     ESP_LOGV(TAG, "ff_nand_write - pdrv=%i, sector=%lu, count=%u", (unsigned int) pdrv, (unsigned long) sector,
              (unsigned int) count);
     esp_err_t ret;
-    uint32_t page_size;
     spi_nand_flash_device_t *dev = ff_nand_handles[pdrv];
     assert(dev);
 
-    ESP_GOTO_ON_ERROR(spi_nand_flash_get_page_size(dev, &page_size), fail, TAG, "");
-
-    for (uint32_t i = 0; i < count; i++) {
-        ESP_GOTO_ON_ERROR(spi_nand_flash_write_page(dev, buff + i * page_size, sector + i),
-                          fail, TAG, "spi_nand_flash_write_page failed");
-    }
+    ESP_GOTO_ON_ERROR(spi_nand_flash_write_pages(dev, buff, sector, count),
+                      fail, TAG, "spi_nand_flash_write_pages failed");
     return RES_OK;
 
 fail:
@@ -87,10 +77,8 @@ DRESULT ff_nand_trim(BYTE pdrv, DWORD start_sector, DWORD sector_count)
         return RES_PARERR;
     }
 
-    for (uint32_t i = 0; i < sector_count; i++) {
-        ESP_GOTO_ON_ERROR(spi_nand_flash_trim(dev, start_sector + i),
-                          fail, TAG, "spi_nand_flash_trim failed");
-    }
+    ESP_GOTO_ON_ERROR(spi_nand_flash_trim_range(dev, start_sector, sector_count),
+                      fail, TAG, "spi_nand_flash_trim_range failed");
     return RES_OK;
 
 fail: